@@ -0,0 +1,189 @@
+#!/usr/bin/env bash
+#
+# bench.sh - end-to-end fillfs benchmark against tmpfs and loop-device filesystems
+#
+# Copyright (c) 2025 Robert Heffernan
+# Licensed under the MIT License (see LICENSE).
+#
+# Builds scratch filesystems (tmpfs plus ext4/XFS/btrfs on loop devices), runs
+# fillfs across a matrix of engines, block sizes and data modes, and appends one
+# tab-separated row per run to a results file named after the current commit.
+# Rows are written in a fixed matrix order, so the results of two commits can
+# be compared side by side with diff(1). A run that fails keeps its row, with
+# every metric NA and the error column set to exit-<status>.
+#
+# Everything is configurable through the environment:
+#
+#   FILLFS        fillfs binary to benchmark           (default: bin/fillfs)
+#   TARGETS       filesystems to test                  (default: "tmpfs ext4 xfs btrfs")
+#   ENGINES       I/O engines ("default" = no flag)    (default: "sync uring")
+#   BLOCK_SIZES   block sizes passed to --block-size   (default: "128K 1M 32M")
+#   MODES         data modes: zero, random             (default: "zero random")
+#   FILL_SIZE     bytes written per run                (default: 256M)
+#   IMAGE_SIZE    size of each scratch filesystem      (default: 1G)
+#   THREADS       writer threads per run               (default: 1)
+#   IODEPTH       writes in flight for async engines   (default: engine default)
+#   REPS          repetitions of every combination     (default: 3)
+#   RESULTS       results file                         (default: bench/results/<commit>.tsv)
+#   WORKDIR       scratch directory for images/mounts  (default: mktemp -d)
+#
+# Loop-device targets need root plus losetup and the matching mkfs tool; any
+# target that cannot be set up is skipped with a note. Without root, the tmpfs
+# target falls back to /dev/shm.
+
+set -euo pipefail
+
+here="$(cd "$(dirname "$0")" && pwd)"
+top="$(cd "$here/.." && pwd)"
+
+FILLFS="${FILLFS:-$top/bin/fillfs}"
+TARGETS="${TARGETS:-tmpfs ext4 xfs btrfs}"
+ENGINES="${ENGINES:-sync uring}"
+BLOCK_SIZES="${BLOCK_SIZES:-128K 1M 32M}"
+MODES="${MODES:-zero random}"
+FILL_SIZE="${FILL_SIZE:-256M}"
+IMAGE_SIZE="${IMAGE_SIZE:-1G}"
+THREADS="${THREADS:-1}"
+IODEPTH="${IODEPTH:-}"
+REPS="${REPS:-3}"
+
+commit="$(git -C "$top" rev-parse --short HEAD 2>/dev/null || echo unknown)"
+if ! git -C "$top" diff --quiet HEAD -- 2>/dev/null; then
+    commit="$commit-dirty"
+fi
+RESULTS="${RESULTS:-$top/bench/results/$commit.tsv}"
+
+if [ ! -x "$FILLFS" ]; then
+    echo "bench: $FILLFS not found; run 'make' first" >&2
+    exit 1
+fi
+
+own_workdir=0
+if [ -z "${WORKDIR:-}" ]; then
+    WORKDIR="$(mktemp -d "${TMPDIR:-/tmp}/fillfs-bench.XXXXXX")"
+    own_workdir=1
+fi
+
+mounts=()
+loops=()
+
+cleanup() {
+    local m l
+    for m in "${mounts[@]}"; do
+        umount "$m" 2>/dev/null || true
+    done
+    for l in "${loops[@]}"; do
+        losetup -d "$l" 2>/dev/null || true
+    done
+    if [ "$own_workdir" = 1 ]; then
+        rm -rf "$WORKDIR"
+    fi
+}
+trap cleanup EXIT
+trap 'exit 130' INT TERM
+
+note() {
+    echo "bench: $*" >&2
+}
+
+# Extract a numeric or string field from fillfs' flat one-line --json output.
+json_field() {
+    local json="$1" key="$2"
+    printf '%s\n' "$json" | sed -n "s/.*\"$key\":\"\\{0,1\\}\\([^,\"}]*\\).*/\\1/p"
+}
+
+# Prepare a mounted scratch filesystem for target $1 and store its mount point
+# in $target_mnt. Runs in the current shell so cleanup() sees the mounts.
+setup_target() {
+    local fs="$1" mnt="$WORKDIR/mnt-$1" img dev
+
+    mkdir -p "$mnt"
+    if [ "$(id -u)" != 0 ]; then
+        if [ "$fs" = tmpfs ] && [ -w /dev/shm ]; then
+            note "not root; using /dev/shm for tmpfs"
+            target_mnt=/dev/shm
+            return 0
+        fi
+        note "skipping $fs (needs root)"
+        return 1
+    fi
+
+    if [ "$fs" = tmpfs ]; then
+        mount -t tmpfs -o "size=$IMAGE_SIZE" fillfs-bench "$mnt" || return 1
+        mounts+=("$mnt")
+        target_mnt="$mnt"
+        return 0
+    fi
+
+    if ! command -v "mkfs.$fs" >/dev/null 2>&1; then
+        note "skipping $fs (mkfs.$fs not installed)"
+        return 1
+    fi
+
+    img="$WORKDIR/$fs.img"
+    truncate -s "$IMAGE_SIZE" "$img"
+    if ! dev="$(losetup -f --show "$img" 2>/dev/null)"; then
+        note "skipping $fs (no loop device available)"
+        return 1
+    fi
+    loops+=("$dev")
+
+    case "$fs" in
+        ext4)  mkfs.ext4 -F -q "$dev" >/dev/null ;;
+        xfs)   mkfs.xfs -f -q "$dev" >/dev/null ;;
+        btrfs) mkfs.btrfs -f -q "$dev" >/dev/null ;;
+        *)     mkfs."$fs" "$dev" >/dev/null ;;
+    esac || { note "skipping $fs (mkfs failed)"; return 1; }
+
+    mount "$dev" "$mnt" || { note "skipping $fs (mount failed)"; return 1; }
+    mounts+=("$mnt")
+    target_mnt="$mnt"
+}
+
+mkdir -p "$(dirname "$RESULTS")"
+if [ ! -s "$RESULTS" ]; then
+    printf 'target\tengine\tblock_size\tmode\trep\tbytes\telapsed_s\tthroughput_mb_s\tcpu_user_s\tcpu_sys_s\tlat_p50_us\tlat_p90_us\tlat_p99_us\tlat_max_us\terror\n' > "$RESULTS"
+fi
+
+note "results -> $RESULTS"
+
+for target in $TARGETS; do
+    if ! setup_target "$target"; then
+        continue
+    fi
+    mnt="$target_mnt"
+
+    for engine in $ENGINES; do
+        for bs in $BLOCK_SIZES; do
+            for mode in $MODES; do
+                for rep in $(seq 1 "$REPS"); do
+                    opts=(--json --block-size="$bs" --threads="$THREADS")
+                    [ -n "$IODEPTH" ] && opts+=(--iodepth="$IODEPTH")
+                    [ "$engine" != default ] && opts+=(--engine="$engine")
+                    [ "$mode" = random ] && opts+=(--random)
+                    [ "$mode" = zero ] && opts+=(--zero)
+
+                    sync
+                    status=0
+                    out="$("$FILLFS" "${opts[@]}" "$mnt" "$FILL_SIZE" | tail -n 1)" || status=$?
+
+                    row="$target	$engine	$bs	$mode	$rep"
+                    if [ "$status" != 0 ] || [ -z "$(json_field "$out" bytes)" ]; then
+                        # Keep the matrix aligned, but with no numbers that could pass for a result
+                        note "fillfs failed (exit $status): $target $engine $bs $mode rep $rep"
+                        row="$row	NA	NA	NA	NA	NA	NA	NA	NA	NA	exit-$status"
+                        out=""
+                    else
+                        for key in bytes elapsed_s throughput_mb_s cpu_user_s cpu_sys_s \
+                                   lat_p50_us lat_p90_us lat_p99_us lat_max_us error; do
+                            row="$row	$(json_field "$out" "$key")"
+                        done
+                    fi
+                    printf '%s\n' "$row" >> "$RESULTS"
+                    printf '%-6s %-8s %-5s %-6s #%s  %s MB/s\n' "$target" "$engine" "$bs" "$mode" \
+                        "$rep" "$(json_field "$out" throughput_mb_s | grep . || echo NA)" >&2
+                done
+            done
+        done
+    done
+done
@@ -0,0 +1,277 @@
+#!/usr/bin/env python3
+#
+# perf-check.py - fillfs performance regression gate
+#
+# Copyright (c) 2025 Robert Heffernan
+# Licensed under the MIT License (see LICENSE).
+#
+# Runs a fixed, short benchmark set through bench/bench.sh (tmpfs and an ext4
+# loop device when available), then compares every configuration against the
+# baseline in bench/baseline.json, recorded earlier on the same host:
+#
+#   - throughput (MB/s) may not drop, and
+#   - CPU seconds per GB written may not rise,
+#
+# by more than the tolerance. A metric fails when a one-sided Mann-Whitney U
+# test says the current runs are worse than the baseline runs shifted by the
+# tolerance (p < 0.05), so run-to-run noise does not fail the gate but a
+# consistent slowdown does. A baseline configuration that could not be
+# measured (e.g. no root for the ext4 loop device) fails too, unless
+# --allow-skip is given.
+#
+# Usage:
+#   perf-check.py            compare against the baseline, exit 1 on regression
+#   perf-check.py --update   re-measure and rewrite the baseline
+#   perf-check.py --compare NAME=BINARY...
+#                            measure several builds and report the change of
+#                            each against the first (see 'make compare-builds')
+#
+# The baseline is host specific and is not committed: record it with
+# 'make perf-baseline' on the machine that runs the gate. A baseline from a
+# different host (CPU, CPU count, kernel or machine id) is refused unless
+# --allow-other-host is given.
+
+import argparse
+import hashlib
+import itertools
+import json
+import math
+import os
+import platform
+import statistics
+import subprocess
+import sys
+import tempfile
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+TOP = os.path.dirname(HERE)
+
+# The fixed benchmark set. Keep it short: it runs on every perf-check.
+CHECK_ENV = {
+    "TARGETS": "tmpfs ext4",
+    "ENGINES": "default",
+    "BLOCK_SIZES": "1M 32M",
+    "MODES": "zero random",
+    "FILL_SIZE": "256M",
+    "IMAGE_SIZE": "512M",
+    "REPS": "7",
+}
+
+
+def cpu_model():
+    try:
+        with open("/proc/cpuinfo") as f:
+            for line in f:
+                if line.startswith("model name"):
+                    return line.split(":", 1)[1].strip()
+    except OSError:
+        pass
+    return platform.machine()
+
+
+def host_id():
+    """What must match for two measurements to be comparable."""
+    machine = ""
+    try:
+        with open("/etc/machine-id") as f:
+            machine = hashlib.sha256(f.read().strip().encode()).hexdigest()[:16]
+    except OSError:
+        pass
+    return {"cpu": cpu_model(), "cpus": os.cpu_count(), "kernel": platform.release(), "machine": machine}
+
+
+def mann_whitney_p(x, y):
+    """One-sided p-value of a Mann-Whitney U test that values in x tend to be smaller than in y.
+
+    Exact (enumerating every split of the pooled ranks) for small samples, normal
+    approximation with tie correction otherwise.
+    """
+    pooled = sorted([(v, 0) for v in x] + [(v, 1) for v in y])
+    ranks = [0.0] * len(pooled)
+    i = 0
+    while i < len(pooled):
+        j = i
+        while j + 1 < len(pooled) and pooled[j + 1][0] == pooled[i][0]:
+            j += 1
+        for k in range(i, j + 1):
+            ranks[k] = (i + j) / 2.0 + 1.0
+        i = j + 1
+    n1, n2 = len(x), len(y)
+    rx = sum(r for r, (_, g) in zip(ranks, pooled) if g == 0)
+
+    if n1 + n2 <= 20:
+        total = hits = 0
+        for combo in itertools.combinations(ranks, n1):
+            total += 1
+            hits += sum(combo) <= rx + 1e-9
+        return hits / total
+
+    u = rx - n1 * (n1 + 1) / 2.0
+    n = n1 + n2
+    ties = {}
+    for v, _ in pooled:
+        ties[v] = ties.get(v, 0) + 1
+    tie_term = sum(t ** 3 - t for t in ties.values()) / (n * (n - 1))
+    sigma = math.sqrt(n1 * n2 / 12.0 * ((n + 1) - tie_term))
+    if sigma == 0:
+        return 1.0
+    z = (u - n1 * n2 / 2.0 + 0.5) / sigma
+    return 0.5 * (1.0 + math.erf(z / math.sqrt(2.0)))
+
+
+def worse(current, reference, higher_is_better, tolerance, alpha=0.05):
+    """True if current is significantly worse than reference by more than tolerance."""
+    if higher_is_better:
+        return mann_whitney_p(current, [v * (1.0 - tolerance) for v in reference]) < alpha
+    return mann_whitney_p([v * (1.0 + tolerance) for v in reference], current) < alpha
+
+
+def run_bench(fillfs):
+    env = dict(os.environ)
+    env.update(CHECK_ENV)
+    env["FILLFS"] = fillfs
+    with tempfile.NamedTemporaryFile(prefix="fillfs-perf-", suffix=".tsv", delete=False) as tmp:
+        results = tmp.name
+    env["RESULTS"] = results
+    try:
+        subprocess.run([os.path.join(HERE, "bench.sh")], env=env, check=True)
+        with open(results) as f:
+            rows = f.read().splitlines()
+    finally:
+        os.unlink(results)
+
+    header = rows[0].split("\t")
+    runs = {}
+    for line in rows[1:]:
+        row = dict(zip(header, line.split("\t")))
+        if row.get("error") != "0" or not row.get("bytes"):
+            sys.exit("perf-check: run failed: %s" % line)
+        key = "%s/%s/%s/%s" % (row["target"], row["engine"], row["block_size"], row["mode"])
+        gb = float(row["bytes"]) / 1e9
+        cpu = float(row["cpu_user_s"]) + float(row["cpu_sys_s"])
+        runs.setdefault(key, {"throughput_mb_s": [], "cpu_s_per_gb": []})
+        runs[key]["throughput_mb_s"].append(float(row["throughput_mb_s"]))
+        runs[key]["cpu_s_per_gb"].append(cpu / gb if gb > 0 else 0.0)
+
+    summary = {}
+    for key, metrics in sorted(runs.items()):
+        summary[key] = {}
+        for name, values in metrics.items():
+            summary[key][name] = {"median": statistics.median(values), "values": sorted(values)}
+    return summary
+
+
+def compare(current, baseline, tolerance, allow_skip):
+    failures = 0
+    print("%-32s %-16s %12s %12s %8s  %s" % ("config", "metric", "baseline", "current", "change", "verdict"))
+    for key, base in sorted(baseline["configs"].items()):
+        if key not in current:
+            verdict = "skipped (not measured)" if allow_skip else "FAILED (not measured)"
+            failures += not allow_skip
+            print("%-32s %-16s %12s %12s %8s  %s" % (key, "-", "-", "-", "-", verdict))
+            continue
+        for name, higher_is_better in (("throughput_mb_s", True), ("cpu_s_per_gb", False)):
+            b = base[name]["median"]
+            cur = current[key][name]
+            change = (cur["median"] - b) / b if b else 0.0
+            regressed = worse(cur["values"], base[name]["values"], higher_is_better, tolerance)
+            verdict = "REGRESSION" if regressed else "ok"
+            failures += regressed
+            print("%-32s %-16s %12.3f %12.3f %+7.1f%%  %s" % (key, name, b, cur["median"], change * 100.0, verdict))
+    return failures
+
+
+def compare_builds(builds):
+    """Run the benchmark set once per build and print each build's change against the first."""
+    results = []
+    for spec in builds:
+        name, sep, path = spec.partition("=")
+        if not sep:
+            name, path = os.path.basename(spec), spec
+        print("perf-check: measuring %s (%s)" % (name, path), file=sys.stderr)
+        results.append((name, run_bench(os.path.abspath(path))))
+
+    ref_name, ref = results[0]
+    print("%-32s %-16s %-10s %12s %12s %8s  %s" % ("config", "metric", "build", ref_name, "build", "change", "significant"))
+    totals = {}
+    for key in sorted(ref):
+        for name, higher_is_better in (("throughput_mb_s", True), ("cpu_s_per_gb", False)):
+            b = ref[key][name]
+            for build, current in results[1:]:
+                if key not in current:
+                    continue
+                cur = current[key][name]
+                change = (cur["median"] - b["median"]) / b["median"] if b["median"] else 0.0
+                if worse(cur["values"], b["values"], higher_is_better, 0.0):
+                    verdict = "worse"
+                elif worse(b["values"], cur["values"], higher_is_better, 0.0):
+                    verdict = "better"
+                else:
+                    verdict = "-"
+                totals.setdefault((build, name), []).append(change)
+                print("%-32s %-16s %-10s %12.3f %12.3f %+7.1f%%  %s"
+                      % (key, name, build, b["median"], cur["median"], change * 100.0, verdict))
+
+    print()
+    print("Median change against %s:" % ref_name)
+    for build, _ in results[1:]:
+        tput = totals.get((build, "throughput_mb_s"), [0.0])
+        cpu = totals.get((build, "cpu_s_per_gb"), [0.0])
+        print("  %-10s throughput %+6.1f%%   CPU per GB %+6.1f%%"
+              % (build, statistics.median(tput) * 100.0, statistics.median(cpu) * 100.0))
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description="fillfs performance regression gate")
+    parser.add_argument("--update", action="store_true", help="rewrite the baseline from a fresh run")
+    parser.add_argument("--baseline", default=os.path.join(HERE, "baseline.json"))
+    parser.add_argument("--fillfs", default=os.environ.get("FILLFS", os.path.join(TOP, "bin", "fillfs")))
+    parser.add_argument("--tolerance", type=float, default=float(os.environ.get("PERF_TOLERANCE", "0.10")),
+                        help="allowed relative change before failing (default 0.10)")
+    parser.add_argument("--allow-skip", action="store_true",
+                        help="do not fail when a baseline configuration cannot be measured")
+    parser.add_argument("--allow-other-host", action="store_true",
+                        help="compare against a baseline recorded on a different host")
+    parser.add_argument("--compare", nargs="+", metavar="NAME=BINARY",
+                        help="measure these builds and compare them with the first")
+    args = parser.parse_args()
+
+    if args.compare:
+        return compare_builds(args.compare)
+
+    if args.update:
+        current = run_bench(args.fillfs)
+        with open(args.baseline, "w") as f:
+            json.dump({"host": host_id(), "env": CHECK_ENV, "configs": current}, f, indent=2, sort_keys=True)
+            f.write("\n")
+        print("perf-check: baseline written to %s" % args.baseline)
+        return 0
+
+    try:
+        with open(args.baseline) as f:
+            baseline = json.load(f)
+    except OSError:
+        sys.exit("perf-check: no baseline at %s; run 'make perf-baseline' first" % args.baseline)
+
+    if baseline.get("host") != host_id():
+        msg = ("perf-check: baseline was recorded on another host (%s), this is %s"
+               % (json.dumps(baseline.get("host")), json.dumps(host_id())))
+        if not args.allow_other_host:
+            sys.exit(msg + "; run 'make perf-baseline' here or pass --allow-other-host")
+        print(msg, file=sys.stderr)
+    if any("values" not in m for c in baseline["configs"].values() for m in c.values()):
+        sys.exit("perf-check: baseline has no per-run values; run 'make perf-baseline' again")
+
+    current = run_bench(args.fillfs)
+    failures = compare(current, baseline, args.tolerance, args.allow_skip)
+    if failures:
+        print("perf-check: %d failure(s): regressions beyond %.0f%% tolerance or configurations not measured"
+              % (failures, args.tolerance * 100.0))
+        return 1
+    print("perf-check: no significant regressions")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
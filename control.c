@@ -0,0 +1,509 @@
+/*
+ * control.c
+ *
+ * Copyright (c) 2025 Robert Heffernan
+ *
+ * Author: Robert Heffernan <robert@heffernantech.au>
+ *
+ * This file is part of the fillfs utility. It is licensed under the MIT License:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify,
+ * merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Control socket (see control.h).
+ */
+
+#define _GNU_SOURCE
+#define _POSIX_C_SOURCE 200809L
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "control.h"
+#include "util.h"
+
+#define CONTROL_MAX_CLIENTS 8
+#define CONTROL_LINE_MAX    256
+#define CONTROL_REPLY_MAX   4096
+
+/**
+ * @brief One connected client and its partial command line.
+ */
+typedef struct {
+    int     fd;
+    size_t  len;
+    char    line[CONTROL_LINE_MAX];
+} control_client_t;
+
+static struct {
+    pthread_t       tid;
+    pthread_mutex_t lock;       ///< Protects job and target
+    int             running;
+    int             listen_fd;
+    int             wake[2];    ///< Written by control_stop() to end the thread
+    char            path[sizeof(((struct sockaddr_un*)0)->sun_path)];
+    control_stop_fn on_stop;    ///< Extra action for "stop" and stop signals
+    double          shutdown_timeout_s; ///< Exit anyway this long after a stop signal (0 = never)
+    int             stop_signal; ///< Stop signal received, 0 if none
+    uint64_t        stop_ns;    ///< When it was received
+    int             pausing;    ///< SIGUSR1 received; "Paused" not yet reported
+
+    fillfs_job_t   *job;        ///< Current job, or NULL
+    char            target[1024];
+
+    control_client_t clients[CONTROL_MAX_CLIENTS];
+    unsigned        n_clients;
+} g_ctl = { .lock = PTHREAD_MUTEX_INITIALIZER, .listen_fd = -1, .wake = { -1, -1 } };
+
+static const char control_help[] =
+    "commands: stats | rate SIZE | pause | resume | threads N | stop | help";
+
+static const char *control_state_name(fillfs_state_t state) {
+    switch (state) {
+        case FILLFS_STATE_CREATED: return "created";
+        case FILLFS_STATE_RUNNING: return "running";
+        case FILLFS_STATE_IDLE:    return "idle";
+        case FILLFS_STATE_PAUSED:  return "paused";
+        case FILLFS_STATE_DONE:    return "done";
+    }
+    return "unknown";
+}
+
+/**
+ * @brief Format the stats reply: the job's progress as one JSON object.
+ */
+static void control_stats(char *reply, size_t size) {
+    fillfs_progress_t progress;
+    fillfs_job_progress(g_ctl.job, &progress);
+
+    // Escape the target for JSON; the other fields are numbers or fixed names
+    char target[2 * sizeof(g_ctl.target)];
+    size_t n = 0;
+    for (const unsigned char *p = (const unsigned char*)g_ctl.target; *p && n + 2 < sizeof(target); ++p) {
+        if (*p == '"' || *p == '\\') {
+            target[n++] = '\\';
+        }
+        target[n++] = (*p < 0x20) ? '?' : (char)*p;
+    }
+    target[n] = '\0';
+
+    snprintf(reply, size,
+             "{\"target\":\"%s\",\"state\":\"%s\",\"bytes_written\":%llu,\"target_bytes\":%llu,"
+             "\"elapsed_s\":%.3f,\"rate_limit\":%llu,\"threads\":%u,\"disk_full\":%d,\"error\":%d}",
+             target, control_state_name(progress.state),
+             (unsigned long long)progress.bytes_written,
+             (unsigned long long)progress.target_bytes, progress.elapsed_s,
+             (unsigned long long)progress.rate_limit, progress.threads,
+             progress.disk_full, progress.error);
+}
+
+/**
+ * @brief Cancel the current job cooperatively. Called with the lock held.
+ */
+static void control_cancel_locked(void) {
+    if (g_ctl.job) {
+        // Resume as well, so the pause ends and its time is accounted
+        fillfs_job_cancel(g_ctl.job);
+        fillfs_job_resume(g_ctl.job);
+    }
+}
+
+/**
+ * @brief Run one command line and format its reply.
+ *
+ * @return int 1 if the command was "stop".
+ */
+static int control_command(char *line, char *reply, size_t size) {
+    char *save = NULL;
+    char *cmd  = strtok_r(line, " \t\r", &save);
+    char *arg  = strtok_r(NULL, " \t\r", &save);
+    int stop = 0;
+
+    snprintf(reply, size, "ok");
+    if (!cmd) {
+        reply[0] = '\0';
+        return 0;
+    }
+    if (strcmp(cmd, "help") == 0) {
+        snprintf(reply, size, "%s", control_help);
+        return 0;
+    }
+
+    pthread_mutex_lock(&g_ctl.lock);
+    if (!g_ctl.job) {
+        snprintf(reply, size, "error: no job running");
+    } else if (strcmp(cmd, "stats") == 0) {
+        control_stats(reply, size);
+    } else if (strcmp(cmd, "rate") == 0) {
+        uint64_t rate = 0;
+        if (!arg || (strcmp(arg, "off") != 0 && parse_bytes(arg, PARSE_RATE, &rate) != PARSE_OK)) {
+            snprintf(reply, size, "error: usage: rate SIZE (e.g. 200M, 0 or off for unlimited)");
+        } else {
+            fillfs_job_set_rate(g_ctl.job, rate);
+        }
+    } else if (strcmp(cmd, "pause") == 0) {
+        fillfs_job_pause(g_ctl.job);
+    } else if (strcmp(cmd, "resume") == 0) {
+        fillfs_job_resume(g_ctl.job);
+        g_ctl.pausing = 0;
+    } else if (strcmp(cmd, "threads") == 0) {
+        char *end = NULL;
+        unsigned long v = arg ? strtoul(arg, &end, 10) : 0;
+        if (!arg || *end != '\0' || v == 0 || v > CONTROL_MAX_THREADS) {
+            snprintf(reply, size, "error: usage: threads N (1-%u)", CONTROL_MAX_THREADS);
+        } else if (fillfs_job_set_threads(g_ctl.job, (unsigned)v) != 0) {
+            snprintf(reply, size, "error: cannot change threads now");
+        }
+    } else if (strcmp(cmd, "stop") == 0) {
+        control_cancel_locked();
+        stop = 1;
+    } else {
+        snprintf(reply, size, "error: unknown command '%s'; %s", cmd, control_help);
+    }
+    pthread_mutex_unlock(&g_ctl.lock);
+    return stop;
+}
+
+static void control_drop(unsigned i) {
+    close(g_ctl.clients[i].fd);
+    g_ctl.clients[i] = g_ctl.clients[--g_ctl.n_clients];
+}
+
+/**
+ * @brief Read what a client sent and answer every complete line.
+ *
+ * @return int 0 to keep the client, -1 to drop it.
+ */
+static int control_serve(control_client_t *cl) {
+    ssize_t got = read(cl->fd, cl->line + cl->len, sizeof(cl->line) - 1 - cl->len);
+    if (got <= 0) {
+        return (got == -1 && errno == EINTR) ? 0 : -1;
+    }
+    cl->len += (size_t)got;
+
+    char reply[CONTROL_REPLY_MAX];
+    char *nl;
+    while ((nl = memchr(cl->line, '\n', cl->len)) != NULL) {
+        *nl = '\0';
+        int stop = control_command(cl->line, reply, sizeof(reply) - 1);
+        size_t used = (size_t)(nl + 1 - cl->line);
+        memmove(cl->line, nl + 1, cl->len - used);
+        cl->len -= used;
+
+        if (reply[0]) {
+            strcat(reply, "\n");
+            if (send(cl->fd, reply, strlen(reply), MSG_NOSIGNAL) == -1) {
+                return -1;
+            }
+        }
+        if (stop && g_ctl.on_stop) {
+            g_ctl.on_stop();
+        }
+    }
+    if (cl->len == sizeof(cl->line) - 1) {
+        static const char too_long[] = "error: line too long\n";
+        send(cl->fd, too_long, sizeof(too_long) - 1, MSG_NOSIGNAL);
+        return -1;
+    }
+    return 0;
+}
+
+static void *control_thread(void *arg) {
+    (void)arg;
+    struct pollfd fds[2 + CONTROL_MAX_CLIENTS];
+
+    for (;;) {
+        fds[0] = (struct pollfd){ .fd = g_ctl.wake[0], .events = POLLIN };
+        fds[1] = (struct pollfd){ .fd = g_ctl.listen_fd, .events = POLLIN };
+        for (unsigned i = 0; i < g_ctl.n_clients; ++i) {
+            fds[2 + i] = (struct pollfd){ .fd = g_ctl.clients[i].fd, .events = POLLIN };
+        }
+        unsigned n_fds = 2 + g_ctl.n_clients;
+        if (poll(fds, n_fds, -1) == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("poll");
+            break;
+        }
+        if (fds[0].revents) {
+            break;
+        }
+
+        // Serve clients from the back so dropping one doesn't skip another
+        for (unsigned i = n_fds - 2; i-- > 0; ) {
+            if (fds[2 + i].revents && control_serve(&g_ctl.clients[i]) != 0) {
+                control_drop(i);
+            }
+        }
+
+        if (fds[1].revents & POLLIN) {
+            int fd = accept4(g_ctl.listen_fd, NULL, NULL, SOCK_CLOEXEC);
+            if (fd == -1) {
+                continue;
+            }
+            if (g_ctl.n_clients == CONTROL_MAX_CLIENTS) {
+                static const char busy[] = "error: too many connections\n";
+                send(fd, busy, sizeof(busy) - 1, MSG_NOSIGNAL);
+                close(fd);
+                continue;
+            }
+            g_ctl.clients[g_ctl.n_clients++] = (control_client_t){ .fd = fd };
+        }
+    }
+
+    while (g_ctl.n_clients > 0) {
+        control_drop(g_ctl.n_clients - 1);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Remove a socket file at PATH if no process is listening on it any more.
+ */
+static int control_remove_stale(const struct sockaddr_un *addr) {
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        return -1;
+    }
+    int rc = connect(fd, (const struct sockaddr*)addr, sizeof(*addr));
+    int err = errno;
+    close(fd);
+    if (rc == 0) {
+        fprintf(stderr, "Error: Control socket '%s' is in use by another process.\n", addr->sun_path);
+        return -1;
+    }
+    if (err == ECONNREFUSED) {
+        unlink(addr->sun_path);
+    }
+    return 0;
+}
+
+int control_start(const char *path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Error: Control socket path '%s' is too long.\n", path);
+        return -1;
+    }
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+    if (control_remove_stale(&addr) != 0) {
+        return -1;
+    }
+
+    g_ctl.listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (g_ctl.listen_fd == -1 ||
+        bind(g_ctl.listen_fd, (struct sockaddr*)&addr, sizeof(addr)) == -1 ||
+        listen(g_ctl.listen_fd, CONTROL_MAX_CLIENTS) == -1 ||
+        pipe2(g_ctl.wake, O_CLOEXEC) == -1) {
+        perror(path);
+        control_stop();
+        return -1;
+    }
+    snprintf(g_ctl.path, sizeof(g_ctl.path), "%s", path);
+
+    int rc = pthread_create(&g_ctl.tid, NULL, control_thread, NULL);
+    if (rc != 0) {
+        errno = rc;
+        perror("pthread_create");
+        control_stop();
+        return -1;
+    }
+    g_ctl.running = 1;
+    return 0;
+}
+
+/**
+ * @brief Signal thread: pause on SIGUSR1, resume on SIGUSR2, and stop on
+ *        SIGINT/SIGTERM/SIGHUP.
+ *
+ * A stop cancels the writers cooperatively; the main thread then drains
+ * them, reports partial statistics and cleans up. A second stop signal, or
+ * the shutdown timeout, exits at once (atexit handlers still remove fill
+ * files).
+ */
+/**
+ * @brief Report a SIGUSR1 pause once the writers have drained, or forget it
+ *        if the job ended or was resumed first.
+ */
+static void control_check_paused(void) {
+    pthread_mutex_lock(&g_ctl.lock);
+    if (g_ctl.pausing) {
+        fillfs_progress_t progress;
+        if (g_ctl.job) {
+            fillfs_job_progress(g_ctl.job, &progress);
+        }
+        if (!g_ctl.job || progress.state != FILLFS_STATE_RUNNING) {
+            if (g_ctl.job && progress.state == FILLFS_STATE_PAUSED) {
+                fprintf(stderr, "\nPaused: writes in flight drained; send SIGUSR2 to resume.\n");
+            }
+            g_ctl.pausing = 0;
+        }
+    }
+    pthread_mutex_unlock(&g_ctl.lock);
+}
+
+static void *control_signal_thread(void *arg) {
+    const sigset_t *set = arg;
+    for (;;) {
+        int sig;
+        if (g_ctl.stop_ns && g_ctl.shutdown_timeout_s > 0.0) {
+            uint64_t deadline = g_ctl.stop_ns + (uint64_t)(g_ctl.shutdown_timeout_s * 1e9);
+            uint64_t now = now_ns();
+            uint64_t wait = (deadline > now) ? deadline - now : 0;
+            struct timespec ts = { (time_t)(wait / 1000000000ULL), (long)(wait % 1000000000ULL) };
+            sig = sigtimedwait(set, NULL, &ts);
+            if (sig == -1 && errno == EAGAIN) {
+                fprintf(stderr, "Shutdown did not finish within %.1f s; exiting.\n",
+                        g_ctl.shutdown_timeout_s);
+                exit(EXIT_FAILURE);
+            }
+        } else if (g_ctl.pausing) {
+            // Poll for the end of the drain without missing a signal
+            struct timespec ts = { 0, 20000000L };
+            sig = sigtimedwait(set, NULL, &ts);
+            control_check_paused();
+        } else if (sigwait(set, &sig) != 0) {
+            sig = -1;
+        }
+        if (sig == -1) {
+            continue;
+        }
+
+        if (sig == SIGUSR1 || sig == SIGUSR2) {
+            pthread_mutex_lock(&g_ctl.lock);
+            if (g_ctl.job && sig == SIGUSR1) {
+                fillfs_job_pause(g_ctl.job);
+                g_ctl.pausing = 1;
+                fprintf(stderr, "\nPausing (SIGUSR1): finishing writes in flight...\n");
+            } else if (g_ctl.job) {
+                fillfs_job_resume(g_ctl.job);
+                g_ctl.pausing = 0;
+                fprintf(stderr, "\nResumed (SIGUSR2).\n");
+            }
+            pthread_mutex_unlock(&g_ctl.lock);
+            if (g_ctl.pausing) {
+                control_check_paused();  // Already drained, e.g. between phases
+            }
+            continue;
+        }
+
+        if (g_ctl.stop_ns) {
+            fprintf(stderr, "Caught signal %d again; exiting without waiting for the writers.\n", sig);
+            exit(EXIT_FAILURE);
+        }
+        fprintf(stderr, "\nCaught signal %d. Stopping: finishing writes in flight, then cleaning up "
+                        "(signal again to exit at once)...\n", sig);
+        pthread_mutex_lock(&g_ctl.lock);
+        g_ctl.stop_signal = sig;
+        g_ctl.stop_ns     = now_ns();
+        control_cancel_locked();
+        pthread_mutex_unlock(&g_ctl.lock);
+        if (g_ctl.on_stop) {
+            g_ctl.on_stop();
+        }
+    }
+    return NULL;
+}
+
+int control_signals_start(double shutdown_timeout_s, control_stop_fn on_stop) {
+    static sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGUSR1);
+    sigaddset(&set, SIGUSR2);
+    sigaddset(&set, SIGINT);
+    sigaddset(&set, SIGTERM);
+#ifdef SIGHUP
+    sigaddset(&set, SIGHUP);
+#endif
+    g_ctl.shutdown_timeout_s = shutdown_timeout_s;
+    g_ctl.on_stop            = on_stop;
+
+    int rc = pthread_sigmask(SIG_BLOCK, &set, NULL);
+    pthread_t tid;
+    if (rc == 0) {
+        rc = pthread_create(&tid, NULL, control_signal_thread, &set);
+    }
+    if (rc != 0) {
+        errno = rc;
+        perror("control signals");
+        return -1;
+    }
+    pthread_detach(tid);
+    return 0;
+}
+
+int control_stop_signal(uint64_t *when_ns) {
+    pthread_mutex_lock(&g_ctl.lock);
+    int sig = g_ctl.stop_signal;
+    if (when_ns) {
+        *when_ns = g_ctl.stop_ns;
+    }
+    pthread_mutex_unlock(&g_ctl.lock);
+    return sig;
+}
+
+void control_set_source(fillfs_job_t *job, const char *target) {
+    pthread_mutex_lock(&g_ctl.lock);
+    g_ctl.job     = job;
+    g_ctl.pausing = 0;
+    if (g_ctl.stop_ns) {
+        control_cancel_locked();  // A stop signal arrived before the job started
+    }
+    snprintf(g_ctl.target, sizeof(g_ctl.target), "%s", target ? target : "");
+    pthread_mutex_unlock(&g_ctl.lock);
+}
+
+void control_stop(void) {
+    if (g_ctl.running) {
+        char c = 0;
+        if (write(g_ctl.wake[1], &c, 1) == -1) {
+            perror("write");
+        }
+        pthread_join(g_ctl.tid, NULL);
+        g_ctl.running = 0;
+    }
+    if (g_ctl.listen_fd != -1) {
+        close(g_ctl.listen_fd);
+        g_ctl.listen_fd = -1;
+    }
+    for (int i = 0; i < 2; ++i) {
+        if (g_ctl.wake[i] != -1) {
+            close(g_ctl.wake[i]);
+            g_ctl.wake[i] = -1;
+        }
+    }
+    if (g_ctl.path[0]) {
+        unlink(g_ctl.path);
+        g_ctl.path[0] = '\0';
+    }
+}
@@ -0,0 +1,106 @@
+/*
+ * control.h
+ *
+ * Copyright (c) 2025 Robert Heffernan
+ *
+ * Author: Robert Heffernan <robert@heffernantech.au>
+ *
+ * This file is part of the fillfs utility. It is licensed under the MIT License:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify,
+ * merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Control socket (--control=PATH). A Unix domain stream socket that accepts
+ * one text command per line and answers each with one line, so a running
+ * fill can be inspected and reconfigured with e.g. socat or nc -U:
+ *
+ *     stats            JSON snapshot of the current job
+ *     rate SIZE        Set the aggregate rate limit (0 = unlimited)
+ *     pause / resume   Drain the writes in flight and hold / carry on
+ *     threads N        Change the number of writer threads
+ *     stop             Stop writing, clean up and exit normally
+ *     help             List the commands
+ *
+ * Replies are "ok", "error: <reason>" or the JSON object for stats.
+ *
+ * Signals are taken on a dedicated thread with sigwait() rather than in
+ * handlers, so the job is never touched from signal context: SIGUSR1 and
+ * SIGUSR2 pause and resume the current job, and SIGINT, SIGTERM and SIGHUP
+ * stop it like the "stop" command.
+ */
+
+#ifndef FILLFS_CONTROL_H
+#define FILLFS_CONTROL_H
+
+#include <stdint.h>
+
+#include "fillfs.h"
+
+/** Writer threads a job may be raised to through the control socket. */
+#define CONTROL_MAX_THREADS 256
+
+/**
+ * @brief Called (on the control or signal thread) after "stop" or a stop
+ *        signal has cancelled the current job.
+ */
+typedef void (*control_stop_fn)(void);
+
+/**
+ * @brief Create the socket at PATH and start serving it.
+ *
+ * A stale socket left by a process that is gone is replaced; one that still
+ * accepts connections is not.
+ *
+ * @param path Socket path.
+ * @return int 0 on success, -1 on error (already reported).
+ */
+int control_start(const char *path);
+
+/**
+ * @brief Take SIGUSR1/SIGUSR2 (pause/resume) and SIGINT/SIGTERM/SIGHUP (stop)
+ *        on a dedicated thread. Call before any other thread is started so
+ *        that every thread inherits the blocked signals.
+ *
+ * @param shutdown_timeout_s Exit anyway if the process is still running this
+ *                           long after a stop signal (0 = wait indefinitely).
+ * @param on_stop            Extra action for "stop" and stop signals, or NULL.
+ * @return int 0 on success, -1 on error (already reported).
+ */
+int control_signals_start(double shutdown_timeout_s, control_stop_fn on_stop);
+
+/**
+ * @brief The stop signal received so far, if any.
+ *
+ * @param when_ns If not NULL, set to the CLOCK_MONOTONIC time it arrived.
+ * @return int The signal number, or 0.
+ */
+int control_stop_signal(uint64_t *when_ns);
+
+/**
+ * @brief Point the control socket and pause/resume signals at a job (NULL
+ *        for none). Call with NULL before destroying the job.
+ */
+void control_set_source(fillfs_job_t *job, const char *target);
+
+/**
+ * @brief Close every connection, stop the thread and remove the socket.
+ */
+void control_stop(void);
+
+#endif /* FILLFS_CONTROL_H */
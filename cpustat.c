@@ -0,0 +1,162 @@
+/*
+ * cpustat.c
+ *
+ * Copyright (c) 2025 Robert Heffernan
+ *
+ * Author: Robert Heffernan <robert@heffernantech.au>
+ *
+ * This file is part of the fillfs utility. It is licensed under the MIT License:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify,
+ * merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Per-thread CPU cost accounting (see cpustat.h).
+ */
+
+#define _GNU_SOURCE
+#define _POSIX_C_SOURCE 200809L
+
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "cpustat.h"
+
+static uint64_t timeval_ns(const struct timeval *tv) {
+    return (uint64_t)tv->tv_sec * 1000000000ULL + (uint64_t)tv->tv_usec * 1000ULL;
+}
+
+#ifdef __linux__
+/**
+ * @brief Open one hardware counter for the calling thread, in group GROUP_FD.
+ *
+ * Kernel time is counted where allowed, since most of a fill's cycles are
+ * spent in write(2); under a strict perf_event_paranoid only user time is.
+ */
+static int perf_open(uint64_t config, int group_fd) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size        = sizeof(attr);
+    attr.type        = PERF_TYPE_HARDWARE;
+    attr.config      = config;
+    attr.read_format = PERF_FORMAT_GROUP;
+    attr.disabled    = (group_fd == -1);
+    attr.exclude_hv  = 1;
+
+    int fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+    if (fd == -1) {
+        attr.exclude_kernel = 1;
+        fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+    }
+    return fd;
+}
+#endif
+
+int hw_counters_open(hw_counters_t *hc) {
+    for (int i = 0; i < HW_COUNTERS; ++i) {
+        hc->fd[i] = -1;
+    }
+#ifdef __linux__
+    static const uint64_t configs[HW_COUNTERS] = {
+        [HW_CYCLES]       = PERF_COUNT_HW_CPU_CYCLES,
+        [HW_INSTRUCTIONS] = PERF_COUNT_HW_INSTRUCTIONS,
+        [HW_CACHE_MISSES] = PERF_COUNT_HW_CACHE_MISSES,
+    };
+
+    for (int i = 0; i < HW_COUNTERS; ++i) {
+        hc->fd[i] = perf_open(configs[i], hc->fd[HW_CYCLES]);
+        if (hc->fd[i] == -1) {
+            hw_counters_close(hc);
+            return -1;
+        }
+    }
+    ioctl(hc->fd[HW_CYCLES], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(hc->fd[HW_CYCLES], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+void hw_counters_close(hw_counters_t *hc) {
+    for (int i = HW_COUNTERS - 1; i >= 0; --i) {
+        if (hc->fd[i] != -1) {
+            close(hc->fd[i]);
+            hc->fd[i] = -1;
+        }
+    }
+}
+
+void cpu_sample(cpu_sample_t *s, const hw_counters_t *hc) {
+    memset(s, 0, sizeof(*s));
+
+#ifdef RUSAGE_THREAD
+    struct rusage ru;
+    if (getrusage(RUSAGE_THREAD, &ru) == 0) {
+        s->user_ns         = timeval_ns(&ru.ru_utime);
+        s->sys_ns          = timeval_ns(&ru.ru_stime);
+        s->ctx_voluntary   = (uint64_t)ru.ru_nvcsw;
+        s->ctx_involuntary = (uint64_t)ru.ru_nivcsw;
+    }
+#endif
+
+    if (hc && hc->fd[HW_CYCLES] != -1) {
+        // PERF_FORMAT_GROUP: { nr, values[nr] }
+        uint64_t buf[1 + HW_COUNTERS];
+        if (read(hc->fd[HW_CYCLES], buf, sizeof(buf)) == (ssize_t)sizeof(buf) &&
+            buf[0] == HW_COUNTERS) {
+            memcpy(s->hw, buf + 1, sizeof(s->hw));
+            s->hw_valid = 1;
+        }
+    }
+}
+
+void cpu_cost_add_delta(cpu_cost_t *cost, const cpu_sample_t *from, const cpu_sample_t *to) {
+    cost->user_ns         += to->user_ns - from->user_ns;
+    cost->sys_ns          += to->sys_ns - from->sys_ns;
+    cost->ctx_voluntary   += to->ctx_voluntary - from->ctx_voluntary;
+    cost->ctx_involuntary += to->ctx_involuntary - from->ctx_involuntary;
+    if (from->hw_valid && to->hw_valid) {
+        for (int i = 0; i < HW_COUNTERS; ++i) {
+            cost->hw[i] += to->hw[i] - from->hw[i];
+        }
+        cost->hw_valid = 1;
+    }
+}
+
+void cpu_cost_merge(cpu_cost_t *dst, const cpu_cost_t *src) {
+    dst->user_ns         += src->user_ns;
+    dst->sys_ns          += src->sys_ns;
+    dst->ctx_voluntary   += src->ctx_voluntary;
+    dst->ctx_involuntary += src->ctx_involuntary;
+    dst->syscalls        += src->syscalls;
+    if (src->hw_valid) {
+        for (int i = 0; i < HW_COUNTERS; ++i) {
+            dst->hw[i] += src->hw[i];
+        }
+        dst->hw_valid = 1;
+    }
+}
@@ -0,0 +1,105 @@
+/*
+ * cpustat.h
+ *
+ * Copyright (c) 2025 Robert Heffernan
+ *
+ * Author: Robert Heffernan <robert@heffernantech.au>
+ *
+ * This file is part of the fillfs utility. It is licensed under the MIT License:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify,
+ * merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef FILLFS_CPUSTAT_H
+#define FILLFS_CPUSTAT_H
+
+#include <stdint.h>
+
+/*
+ * Per-thread CPU cost accounting for the writers: user/system time and
+ * context switches from getrusage(RUSAGE_THREAD), plus optional hardware
+ * counters from perf_event_open(2). Samples are taken around a stretch of
+ * work and the differences accumulated into a cpu_cost_t.
+ */
+
+/** Hardware counters read per thread, in this order. */
+enum {
+    HW_CYCLES = 0,
+    HW_INSTRUCTIONS,
+    HW_CACHE_MISSES,
+    HW_COUNTERS
+};
+
+/**
+ * @brief Accumulated CPU cost of some stretch of work.
+ */
+typedef struct {
+    uint64_t user_ns;           ///< User CPU time
+    uint64_t sys_ns;            ///< System CPU time
+    uint64_t ctx_voluntary;     ///< Voluntary context switches (blocking)
+    uint64_t ctx_involuntary;   ///< Involuntary context switches (preemption)
+    uint64_t syscalls;          ///< I/O system calls, counted by the engines
+    uint64_t hw[HW_COUNTERS];   ///< Hardware counters (valid if hw_valid)
+    int      hw_valid;          ///< Hardware counters were measured
+} cpu_cost_t;
+
+/**
+ * @brief Hardware counter group of the calling thread.
+ */
+typedef struct {
+    int fd[HW_COUNTERS];        ///< perf event fds, fd[HW_CYCLES] leads the group; -1 if unused
+} hw_counters_t;
+
+/**
+ * @brief A point-in-time sample of the calling thread.
+ */
+typedef struct {
+    uint64_t user_ns;
+    uint64_t sys_ns;
+    uint64_t ctx_voluntary;
+    uint64_t ctx_involuntary;
+    uint64_t hw[HW_COUNTERS];
+    int      hw_valid;
+} cpu_sample_t;
+
+/**
+ * @brief Open cycle, instruction and cache-miss counters for the calling thread.
+ *
+ * @return int 0 on success, -1 if the counters are unavailable (all fds -1).
+ */
+int hw_counters_open(hw_counters_t *hc);
+
+/** Close counters opened with hw_counters_open(). */
+void hw_counters_close(hw_counters_t *hc);
+
+/**
+ * @brief Sample the calling thread. HC may be NULL (no hardware counters).
+ */
+void cpu_sample(cpu_sample_t *s, const hw_counters_t *hc);
+
+/**
+ * @brief Add the difference between two samples of the same thread to COST.
+ */
+void cpu_cost_add_delta(cpu_cost_t *cost, const cpu_sample_t *from, const cpu_sample_t *to);
+
+/**
+ * @brief Add every field of SRC into DST.
+ */
+void cpu_cost_merge(cpu_cost_t *dst, const cpu_cost_t *src);
+
+#endif /* FILLFS_CPUSTAT_H */
@@ -0,0 +1,67 @@
+/*
+ * datagen.c
+ *
+ * Copyright (c) 2025 Robert Heffernan
+ *
+ * Author: Robert Heffernan <robert@heffernantech.au>
+ *
+ * This file is part of the fillfs utility. It is licensed under the MIT License:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify,
+ * merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Content generators used to prepare write buffers. They live outside fillfs.c
+ * so the microbenchmark (fillfs-microbench.c) can measure exactly the code the
+ * writer runs, without touching a disk.
+ */
+
+#include <string.h>
+
+#include "datagen.h"
+#include "kernels.h"
+
+/**
+ * @brief Zeroed data.
+ */
+static void gen_zero(void *buf, size_t len, uint64_t seed) {
+    (void)seed;
+    memset(buf, 0, len);
+}
+
+/**
+ * @brief Seeded pseudo-random bytes from the kernel selected for this CPU.
+ */
+static void gen_random(void *buf, size_t len, uint64_t seed) {
+    kernels()->random_fill(buf, len, seed);
+}
+
+const datagen_t datagen_table[] = {
+    { "zero",   gen_zero,   1 },
+    { "random", gen_random, 0 },
+    { NULL,     NULL,       0 }
+};
+
+const datagen_t *datagen_find(const char *name) {
+    for (const datagen_t *g = datagen_table; g->name; ++g) {
+        if (strcmp(g->name, name) == 0) {
+            return g;
+        }
+    }
+    return NULL;
+}
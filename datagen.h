@@ -0,0 +1,64 @@
+/*
+ * datagen.h
+ *
+ * Copyright (c) 2025 Robert Heffernan
+ *
+ * Author: Robert Heffernan <robert@heffernantech.au>
+ *
+ * This file is part of the fillfs utility. It is licensed under the MIT License:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify,
+ * merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef FILLFS_DATAGEN_H
+#define FILLFS_DATAGEN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Fill a buffer with generated content.
+ *
+ * @param buf  Buffer to fill.
+ * @param len  Number of bytes to fill.
+ * @param seed Seed for generators that use one (ignored otherwise).
+ */
+typedef void (*datagen_fn)(void *buf, size_t len, uint64_t seed);
+
+/**
+ * @brief A named content generator (one per data mode / implementation).
+ */
+typedef struct {
+    const char *name;   ///< Data mode name, e.g. "zero" or "random"
+    datagen_fn  fill;   ///< Generator function
+    int         zero;   ///< Output is all zero bytes, so untouched anonymous memory serves
+} datagen_t;
+
+/**
+ * @brief All generators, terminated by an entry with a NULL name.
+ */
+extern const datagen_t datagen_table[];
+
+/**
+ * @brief Look up a generator by name.
+ *
+ * @return const datagen_t* The generator, or NULL if the name is unknown.
+ */
+const datagen_t *datagen_find(const char *name);
+
+#endif /* FILLFS_DATAGEN_H */
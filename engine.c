@@ -0,0 +1,164 @@
+/*
+ * engine.c
+ *
+ * Copyright (c) 2025 Robert Heffernan
+ *
+ * Author: Robert Heffernan <robert@heffernantech.au>
+ *
+ * This file is part of the fillfs utility. It is licensed under the MIT License:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify,
+ * merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Engine registry and the default engine: synchronous pwrite(2) against a
+ * real file.
+ */
+
+#define _GNU_SOURCE
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "engine.h"
+
+static const io_engine_t *const g_engines[] = {
+    &sync_engine,
+    &uring_engine,
+    &fake_engine,
+    NULL
+};
+
+const io_engine_t *engine_find(const char *name) {
+    for (const io_engine_t *const *e = g_engines; *e; ++e) {
+        if (strcmp((*e)->name, name) == 0) {
+            return *e;
+        }
+    }
+    return NULL;
+}
+
+void engine_list(FILE *out) {
+    fprintf(out, "Available engines:\n");
+    for (const io_engine_t *const *e = g_engines; *e; ++e) {
+        fprintf(out, "  %-8s %-6s %-8s %s\n",
+                (*e)->name,
+                ((*e)->caps & IO_CAP_ASYNC) ? "async" : "sync",
+                ((*e)->caps & IO_CAP_DISCARD) ? "discard" : "",
+                (*e)->description);
+    }
+}
+
+int doneq_init(io_doneq_t *q, unsigned cap) {
+    q->reqs  = calloc(cap ? cap : 1, sizeof(*q->reqs));
+    q->count = 0;
+    q->cap   = cap ? cap : 1;
+    return q->reqs ? 0 : -1;
+}
+
+void doneq_free(io_doneq_t *q) {
+    free(q->reqs);
+    q->reqs = NULL;
+    q->count = q->cap = 0;
+}
+
+int doneq_push(io_doneq_t *q, io_req_t *req) {
+    if (q->count == q->cap) {
+        errno = EAGAIN;
+        return -1;
+    }
+    q->reqs[q->count++] = req;
+    return 0;
+}
+
+int doneq_reap(io_doneq_t *q, io_req_t **done, unsigned max) {
+    unsigned n = (q->count < max) ? q->count : max;
+    memcpy(done, q->reqs, n * sizeof(*done));
+    memmove(q->reqs, q->reqs + n, (q->count - n) * sizeof(*q->reqs));
+    q->count -= n;
+    return (int)n;
+}
+
+static int sync_open(io_file_t *f, const char *path, int flags, mode_t mode) {
+    io_doneq_t *q = malloc(sizeof(*q));
+    if (!q || doneq_init(q, f->depth) == -1) {
+        free(q);
+        return -1;
+    }
+    f->fd = open(path, flags, mode);
+    if (f->fd == -1) {
+        int saved = errno;
+        doneq_free(q);
+        free(q);
+        errno = saved;
+        return -1;
+    }
+    f->priv = q;
+    return 0;
+}
+
+static int sync_submit(io_file_t *f, io_req_t **reqs, unsigned n) {
+    io_doneq_t *q = (io_doneq_t*)f->priv;
+    unsigned i;
+
+    for (i = 0; i < n && q->count < q->cap; ++i) {
+        ssize_t rc = pwrite(f->fd, reqs[i]->buf, reqs[i]->len, reqs[i]->offset);
+        f->syscalls++;
+        reqs[i]->result = (rc == -1) ? -errno : rc;
+        doneq_push(q, reqs[i]);
+    }
+    if (i == 0) {
+        errno = EAGAIN;
+        return -1;
+    }
+    return (int)i;
+}
+
+static int sync_reap(io_file_t *f, io_req_t **done, unsigned min, unsigned max) {
+    (void)min;  // Everything submitted has already completed
+    return doneq_reap((io_doneq_t*)f->priv, done, max);
+}
+
+static int sync_sync(io_file_t *f) {
+    f->syscalls++;
+    return fsync(f->fd);
+}
+
+static int sync_close(io_file_t *f) {
+    int rc = close(f->fd);
+    f->fd = -1;
+    doneq_free((io_doneq_t*)f->priv);
+    free(f->priv);
+    f->priv = NULL;
+    return rc;
+}
+
+const io_engine_t sync_engine = {
+    .name        = "sync",
+    .description = "pwrite(2) from the writer thread (default)",
+    .caps        = 0,
+    .open        = sync_open,
+    .submit      = sync_submit,
+    .reap        = sync_reap,
+    .sync        = sync_sync,
+    .close       = sync_close,
+};
@@ -0,0 +1,152 @@
+/*
+ * engine.h
+ *
+ * Copyright (c) 2025 Robert Heffernan
+ *
+ * Author: Robert Heffernan <robert@heffernantech.au>
+ *
+ * This file is part of the fillfs utility. It is licensed under the MIT License:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify,
+ * merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef FILLFS_ENGINE_H
+#define FILLFS_ENGINE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+/*
+ * I/O engine layer. Every open/write/sync/close issued by the writers goes
+ * through an io_engine_t, so the same scheduling and statistics code drives
+ * plain system calls, io_uring or the fault-injecting fake alike.
+ *
+ * Writes are submitted in batches as io_req_t and completed by reap(); a
+ * synchronous engine simply completes each request inside submit(). Setup
+ * and teardown operations (open, sync, close) follow system call conventions
+ * and return -1 with errno set on failure.
+ */
+
+/** Engine can keep more than one request in flight per file. */
+#define IO_CAP_ASYNC        (1U << 0)
+/** Engine does not store data (nothing reaches a disk). */
+#define IO_CAP_DISCARD      (1U << 1)
+
+struct io_engine;
+
+/**
+ * @brief One write request.
+ */
+typedef struct {
+    const void *buf;        ///< Data to write
+    size_t      len;        ///< Number of bytes to write
+    off_t       offset;     ///< File offset to write at
+    ssize_t     result;     ///< On completion: bytes written, or -errno
+    uint64_t    submit_ns;  ///< Set by the caller when the request is submitted
+    void       *user;       ///< Caller cookie, untouched by the engine
+} io_req_t;
+
+/**
+ * @brief An open target as seen by an engine.
+ */
+typedef struct {
+    const struct io_engine *engine;  ///< Engine that opened this file
+    int                     fd;      ///< Underlying descriptor (-1 if none)
+    unsigned                depth;   ///< Maximum requests in flight
+    void                   *priv;    ///< Engine private state
+    uint64_t                syscalls; ///< I/O system calls issued on this file (accounting)
+} io_file_t;
+
+/**
+ * @brief Operations implemented by an I/O engine.
+ */
+typedef struct io_engine {
+    const char *name;           ///< Name used with --engine=
+    const char *description;    ///< One line for --engine=help
+    unsigned    caps;           ///< IO_CAP_* flags
+
+    /** Open PATH. The caller sets f->depth (requests kept in flight) beforehand. */
+    int (*open)(io_file_t *f, const char *path, int flags, mode_t mode);
+    /** Queue N requests. Returns the number accepted (>= 1), or -1 with errno set. */
+    int (*submit)(io_file_t *f, io_req_t **reqs, unsigned n);
+    /** Wait for at least MIN (and at most MAX) completions, storing them in DONE. Returns the count, or -1. */
+    int (*reap)(io_file_t *f, io_req_t **done, unsigned min, unsigned max);
+    /** Flush written data to stable storage. All requests must have been reaped. */
+    int (*sync)(io_file_t *f);
+    /** Release the file. All requests must have been reaped. */
+    int (*close)(io_file_t *f);
+} io_engine_t;
+
+/** Plain pwrite(2) engine, one request at a time. */
+extern const io_engine_t sync_engine;
+
+/** io_uring engine (Linux 5.6+), up to the file's depth in flight. */
+extern const io_engine_t uring_engine;
+
+/** In-process fake that discards data and injects faults (see fake_engine_configure). */
+extern const io_engine_t fake_engine;
+
+/**
+ * @brief Look up an engine by name.
+ *
+ * @return const io_engine_t* The engine, or NULL if the name is unknown.
+ */
+const io_engine_t *engine_find(const char *name);
+
+/**
+ * @brief Print the available engines and their capabilities.
+ */
+void engine_list(FILE *out);
+
+/*
+ * Helpers for engines that complete requests inside submit(): completed
+ * requests are parked in a queue of the file's depth until reaped.
+ */
+typedef struct {
+    io_req_t **reqs;        ///< Completed, not yet reaped
+    unsigned   count;       ///< Entries in reqs
+    unsigned   cap;         ///< Capacity (the file's depth)
+} io_doneq_t;
+
+int  doneq_init(io_doneq_t *q, unsigned cap);
+void doneq_free(io_doneq_t *q);
+/** Park a completed request. Returns 0, or -1 with errno = EAGAIN if full. */
+int  doneq_push(io_doneq_t *q, io_req_t *req);
+/** Move up to MAX parked requests into DONE. Returns the count (never blocks). */
+int  doneq_reap(io_doneq_t *q, io_req_t **done, unsigned max);
+
+/**
+ * @brief Configure the fake engine's fault schedule.
+ *
+ * SPEC is a comma separated list of key=value pairs:
+ *   seed=N           seed for the fault schedule (default 1)
+ *   enospc=SIZE      fail with ENOSPC at this offset (writes crossing it are short)
+ *   eio=P            probability of EIO per write
+ *   eio-at=SIZE      fail the write covering this offset with EIO
+ *   short=P          probability of a short write
+ *   latency-us=N     base latency added to every write
+ *   spike=P          probability of a latency spike per write
+ *   spike-us=N       length of a latency spike (default 100000)
+ *
+ * @return int 0 on success, -1 if SPEC is malformed (a message is printed).
+ */
+int fake_engine_configure(const char *spec);
+
+#endif /* FILLFS_ENGINE_H */
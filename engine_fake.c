@@ -0,0 +1,271 @@
+/*
+ * engine_fake.c
+ *
+ * Copyright (c) 2025 Robert Heffernan
+ *
+ * Author: Robert Heffernan <robert@heffernantech.au>
+ *
+ * This file is part of the fillfs utility. It is licensed under the MIT License:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify,
+ * merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Fault-injecting fake engine.
+ *
+ * Nothing reaches a disk: writes are accepted into a virtual file and faults
+ * are drawn from a PRNG keyed by the seed and the write's offset and length,
+ * so the same --fault spec fails the same writes with ENOSPC, EIO, short
+ * writes and latency spikes on every run, on any machine and with any number
+ * of writer threads, whichever thread happens to issue a given write.
+ */
+
+#define _GNU_SOURCE
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "engine.h"
+#include "util.h"
+
+/**
+ * @brief Fault schedule shared by every file opened through the fake engine.
+ */
+static struct {
+    uint64_t seed;
+    off_t    enospc_at;     ///< -1 = never
+    off_t    eio_at;        ///< -1 = never
+    double   eio_prob;
+    double   short_prob;
+    double   spike_prob;
+    long     latency_us;
+    long     spike_us;
+} g_fault = { 1, -1, -1, 0.0, 0.0, 0.0, 0, 100000 };
+
+/**
+ * @brief Per-file fake state.
+ */
+typedef struct {
+    off_t      size;        ///< Virtual file size
+    io_doneq_t done;        ///< Completed requests awaiting reap
+} fake_file_t;
+
+static uint64_t splitmix64(uint64_t *state) {
+    return mix64(*state += 0x9E3779B97F4A7C15ULL);
+}
+
+/**
+ * @brief Uniform double in [0, 1) from a write's schedule.
+ */
+static double fake_uniform(uint64_t *rng) {
+    return (double)(splitmix64(rng) >> 11) / 9007199254740992.0;
+}
+
+static void sleep_us(long us) {
+    if (us <= 0) {
+        return;
+    }
+    struct timespec ts = { us / 1000000, (us % 1000000) * 1000 };
+    while (nanosleep(&ts, &ts) == -1 && errno == EINTR) {
+    }
+}
+
+static int parse_prob(const char *key, const char *val, double *out) {
+    char *end = NULL;
+    double p = strtod(val, &end);
+    if (end == val || *end != '\0' || isnan(p) || p < 0.0 || p > 1.0) {
+        fprintf(stderr, "Error: --fault %s must be a probability between 0 and 1.\n", key);
+        return -1;
+    }
+    *out = p;
+    return 0;
+}
+
+static int parse_number(const char *key, const char *val, long long min, long long *out) {
+    char *end = NULL;
+    errno = 0;
+    long long v = strtoll(val, &end, 0);
+    if (end == val || *end != '\0' || errno == ERANGE || v < min) {
+        fprintf(stderr, "Error: --fault %s must be an integer of at least %lld.\n", key, min);
+        return -1;
+    }
+    *out = v;
+    return 0;
+}
+
+static int parse_offset(const char *key, const char *val, off_t *out) {
+    uint64_t v;
+    if (parse_bytes(val, 0, &v) != PARSE_OK || v > (uint64_t)INT64_MAX) {
+        fprintf(stderr, "Error: --fault %s must be a size, e.g. 10G.\n", key);
+        return -1;
+    }
+    *out = (off_t)v;
+    return 0;
+}
+
+int fake_engine_configure(const char *spec) {
+    char *copy = strdup(spec);
+    char *save = NULL;
+    int rc = 0;
+
+    for (char *tok = strtok_r(copy, ",", &save); tok && rc == 0; tok = strtok_r(NULL, ",", &save)) {
+        char *val = strchr(tok, '=');
+        if (!val) {
+            fprintf(stderr, "Error: --fault entry '%s' is not key=value.\n", tok);
+            rc = -1;
+            break;
+        }
+        *val++ = '\0';
+
+        long long n = 0;
+        if (strcmp(tok, "seed") == 0) {
+            rc = parse_number(tok, val, 0, &n);
+            g_fault.seed = (uint64_t)n;
+        } else if (strcmp(tok, "enospc") == 0) {
+            rc = parse_offset(tok, val, &g_fault.enospc_at);
+        } else if (strcmp(tok, "eio-at") == 0) {
+            rc = parse_offset(tok, val, &g_fault.eio_at);
+        } else if (strcmp(tok, "eio") == 0) {
+            rc = parse_prob(tok, val, &g_fault.eio_prob);
+        } else if (strcmp(tok, "short") == 0) {
+            rc = parse_prob(tok, val, &g_fault.short_prob);
+        } else if (strcmp(tok, "spike") == 0) {
+            rc = parse_prob(tok, val, &g_fault.spike_prob);
+        } else if (strcmp(tok, "latency-us") == 0) {
+            rc = parse_number(tok, val, 0, &n);
+            g_fault.latency_us = (long)n;
+        } else if (strcmp(tok, "spike-us") == 0) {
+            rc = parse_number(tok, val, 0, &n);
+            g_fault.spike_us = (long)n;
+        } else {
+            fprintf(stderr, "Error: Unknown --fault key '%s'.\n", tok);
+            rc = -1;
+        }
+    }
+
+    free(copy);
+    return rc;
+}
+
+static int fake_open(io_file_t *f, const char *path, int flags, mode_t mode) {
+    (void)path;
+    (void)flags;
+    (void)mode;
+
+    fake_file_t *ff = calloc(1, sizeof(*ff));
+    if (!ff || doneq_init(&ff->done, f->depth) == -1) {
+        free(ff);
+        return -1;
+    }
+    f->fd   = -1;
+    f->priv = ff;
+    return 0;
+}
+
+/**
+ * @brief Complete one write against the virtual file.
+ *
+ * @return ssize_t Bytes "written", or -errno.
+ */
+static ssize_t fake_write(fake_file_t *ff, size_t len, off_t offset) {
+    // Key the draws by the write itself, not by a per-file sequence, so the
+    // outcome does not depend on which thread gets which block. Draw every
+    // number up front so it does not depend on which faults are enabled.
+    uint64_t key = (uint64_t)offset ^ ((uint64_t)len << 48);
+    uint64_t rng = splitmix64(&key) ^ g_fault.seed;
+    double r_eio   = fake_uniform(&rng);
+    double r_short = fake_uniform(&rng);
+    double r_spike = fake_uniform(&rng);
+    uint64_t r_len = splitmix64(&rng);
+
+    sleep_us(g_fault.latency_us + ((r_spike < g_fault.spike_prob) ? g_fault.spike_us : 0));
+
+    if (len == 0) {
+        return 0;
+    }
+    if (r_eio < g_fault.eio_prob ||
+        (g_fault.eio_at >= 0 && offset <= g_fault.eio_at && g_fault.eio_at < offset + (off_t)len)) {
+        return -EIO;
+    }
+    if (g_fault.enospc_at >= 0) {
+        if (offset >= g_fault.enospc_at) {
+            return -ENOSPC;
+        }
+        if (offset + (off_t)len > g_fault.enospc_at) {
+            len = (size_t)(g_fault.enospc_at - offset);
+        }
+    }
+    if (len > 1 && r_short < g_fault.short_prob) {
+        len = 1 + (size_t)(r_len % (len - 1));
+    }
+
+    if (offset + (off_t)len > ff->size) {
+        ff->size = offset + (off_t)len;
+    }
+    return (ssize_t)len;
+}
+
+static int fake_submit(io_file_t *f, io_req_t **reqs, unsigned n) {
+    fake_file_t *ff = (fake_file_t*)f->priv;
+    unsigned i;
+
+    for (i = 0; i < n && ff->done.count < ff->done.cap; ++i) {
+        reqs[i]->result = fake_write(ff, reqs[i]->len, reqs[i]->offset);
+        doneq_push(&ff->done, reqs[i]);
+    }
+    if (i == 0) {
+        errno = EAGAIN;
+        return -1;
+    }
+    return (int)i;
+}
+
+static int fake_reap(io_file_t *f, io_req_t **done, unsigned min, unsigned max) {
+    (void)min;
+    return doneq_reap(&((fake_file_t*)f->priv)->done, done, max);
+}
+
+static int fake_sync(io_file_t *f) {
+    (void)f;
+    sleep_us(g_fault.latency_us);
+    return 0;
+}
+
+static int fake_close(io_file_t *f) {
+    doneq_free(&((fake_file_t*)f->priv)->done);
+    free(f->priv);
+    f->priv = NULL;
+    return 0;
+}
+
+const io_engine_t fake_engine = {
+    .name        = "fake",
+    .description = "in-process fake, discards data, injects faults (--fault=)",
+    .caps        = IO_CAP_DISCARD,
+    .open        = fake_open,
+    .submit      = fake_submit,
+    .reap        = fake_reap,
+    .sync        = fake_sync,
+    .close       = fake_close,
+};
@@ -0,0 +1,328 @@
+/*
+ * engine_uring.c
+ *
+ * Copyright (c) 2025 Robert Heffernan
+ *
+ * Author: Robert Heffernan <robert@heffernantech.au>
+ *
+ * This file is part of the fillfs utility. It is licensed under the MIT License:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify,
+ * merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * io_uring engine.
+ *
+ * Talks to the kernel through the raw io_uring_setup/io_uring_enter system
+ * calls so fillfs keeps building without liburing. One ring per open file,
+ * sized to the file's depth; writes use IORING_OP_WRITE (Linux 5.6+).
+ */
+
+#define _GNU_SOURCE
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "engine.h"
+
+/// Longest write per SQE, as for pwrite(2); a longer block completes short and
+/// the writer resubmits the rest (sqe->len is 32 bits)
+#define URING_MAX_LEN 0x7ffff000u
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+/**
+ * @brief Mapped submission and completion rings for one file.
+ */
+typedef struct {
+    int                  ring_fd;
+    unsigned             in_flight;     ///< Published to the SQ ring and not reaped
+    unsigned             sq_pending;    ///< Of those, not yet consumed by io_uring_enter
+    unsigned            *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned            *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void                *sq_ring;
+    void                *cq_ring;
+    size_t               sq_ring_len;
+    size_t               cq_ring_len;
+    size_t               sqes_len;
+} uring_t;
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params *p) {
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static void uring_unmap(uring_t *r) {
+    if (r->sqes && r->sqes != MAP_FAILED) {
+        munmap(r->sqes, r->sqes_len);
+    }
+    if (r->cq_ring && r->cq_ring != MAP_FAILED && r->cq_ring != r->sq_ring) {
+        munmap(r->cq_ring, r->cq_ring_len);
+    }
+    if (r->sq_ring && r->sq_ring != MAP_FAILED) {
+        munmap(r->sq_ring, r->sq_ring_len);
+    }
+    if (r->ring_fd >= 0) {
+        close(r->ring_fd);
+    }
+}
+
+static int uring_setup(uring_t *r, unsigned depth) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+
+    r->ring_fd = sys_io_uring_setup(depth, &p);
+    if (r->ring_fd < 0) {
+        return -1;
+    }
+
+    r->sq_ring_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cq_ring_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (r->cq_ring_len > r->sq_ring_len) {
+            r->sq_ring_len = r->cq_ring_len;
+        }
+        r->cq_ring_len = r->sq_ring_len;
+    }
+
+    r->sq_ring = mmap(NULL, r->sq_ring_len, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, r->ring_fd, IORING_OFF_SQ_RING);
+    if (r->sq_ring == MAP_FAILED) {
+        return -1;
+    }
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        r->cq_ring = r->sq_ring;
+    } else {
+        r->cq_ring = mmap(NULL, r->cq_ring_len, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, r->ring_fd, IORING_OFF_CQ_RING);
+        if (r->cq_ring == MAP_FAILED) {
+            return -1;
+        }
+    }
+
+    r->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+    r->sqes = mmap(NULL, r->sqes_len, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, r->ring_fd, IORING_OFF_SQES);
+    if (r->sqes == MAP_FAILED) {
+        return -1;
+    }
+
+    r->sq_head  = (unsigned*)((char*)r->sq_ring + p.sq_off.head);
+    r->sq_tail  = (unsigned*)((char*)r->sq_ring + p.sq_off.tail);
+    r->sq_mask  = (unsigned*)((char*)r->sq_ring + p.sq_off.ring_mask);
+    r->sq_array = (unsigned*)((char*)r->sq_ring + p.sq_off.array);
+    r->cq_head  = (unsigned*)((char*)r->cq_ring + p.cq_off.head);
+    r->cq_tail  = (unsigned*)((char*)r->cq_ring + p.cq_off.tail);
+    r->cq_mask  = (unsigned*)((char*)r->cq_ring + p.cq_off.ring_mask);
+    r->cqes     = (struct io_uring_cqe*)((char*)r->cq_ring + p.cq_off.cqes);
+    return 0;
+}
+
+static int uring_open(io_file_t *f, const char *path, int flags, mode_t mode) {
+    uring_t *r = calloc(1, sizeof(*r));
+    if (!r) {
+        return -1;
+    }
+    r->ring_fd = -1;
+
+    if (uring_setup(r, f->depth ? f->depth : 1) == -1) {
+        int saved = errno;
+        uring_unmap(r);
+        free(r);
+        errno = saved;
+        return -1;
+    }
+
+    f->fd = open(path, flags, mode);
+    if (f->fd == -1) {
+        int saved = errno;
+        uring_unmap(r);
+        free(r);
+        errno = saved;
+        return -1;
+    }
+    f->priv = r;
+    return 0;
+}
+
+static int uring_submit(io_file_t *f, io_req_t **reqs, unsigned n) {
+    uring_t *r = (uring_t*)f->priv;
+    unsigned tail = *r->sq_tail;
+    unsigned queued = 0;
+
+    if (n > f->depth - r->in_flight) {
+        n = f->depth - r->in_flight;
+    }
+    for (; queued < n; ++queued) {
+        unsigned idx = tail & *r->sq_mask;
+        struct io_uring_sqe *sqe = &r->sqes[idx];
+
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode    = IORING_OP_WRITE;
+        sqe->fd        = f->fd;
+        sqe->addr      = (uint64_t)(uintptr_t)reqs[queued]->buf;
+        sqe->len       = (reqs[queued]->len > URING_MAX_LEN) ? URING_MAX_LEN
+                                                             : (unsigned)reqs[queued]->len;
+        sqe->off       = (uint64_t)reqs[queued]->offset;
+        sqe->user_data = (uint64_t)(uintptr_t)reqs[queued];
+        r->sq_array[idx] = idx;
+        ++tail;
+    }
+    if (queued == 0) {
+        errno = EAGAIN;
+        return -1;
+    }
+    __atomic_store_n(r->sq_tail, tail, __ATOMIC_RELEASE);
+    r->sq_pending += queued;
+
+    // Once published, an entry belongs to the kernel as soon as enter consumes
+    // it. Entries are consumed in order, so if enter fails before reaching the
+    // new ones they can be taken back; otherwise all of them count as in flight
+    // and the rest are handed over by the next enter (in uring_reap()).
+    while (r->sq_pending > 0) {
+        int rc = sys_io_uring_enter(r->ring_fd, r->sq_pending, 0, 0);
+        f->syscalls++;
+        if (rc < 0 && errno == EINTR) {
+            continue;
+        }
+        if (rc <= 0) {
+            if (rc == 0) {
+                errno = EAGAIN;
+            }
+            if (r->sq_pending >= queued) {
+                int saved = errno;
+                r->sq_pending -= queued;
+                __atomic_store_n(r->sq_tail, tail - queued, __ATOMIC_RELEASE);
+                errno = saved;
+                return -1;
+            }
+            break;
+        }
+        r->sq_pending -= (unsigned)rc;
+    }
+    r->in_flight += queued;
+    return (int)queued;
+}
+
+static int uring_reap(io_file_t *f, io_req_t **done, unsigned min, unsigned max) {
+    uring_t *r = (uring_t*)f->priv;
+    unsigned got = 0;
+
+    if (min > r->in_flight) {
+        min = r->in_flight;
+    }
+    for (;;) {
+        unsigned head = *r->cq_head;
+        unsigned tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+
+        while (head != tail && got < max) {
+            struct io_uring_cqe *cqe = &r->cqes[head & *r->cq_mask];
+            io_req_t *req = (io_req_t*)(uintptr_t)cqe->user_data;
+            req->result = cqe->res;
+            done[got++] = req;
+            ++head;
+        }
+        __atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+
+        if (got >= min || got == max) {
+            break;
+        }
+        f->syscalls++;
+        int rc = sys_io_uring_enter(r->ring_fd, r->sq_pending, min - got, IORING_ENTER_GETEVENTS);
+        if (rc > 0) {
+            r->sq_pending -= (unsigned)rc;  // Entries left over by uring_submit()
+        }
+        if (rc < 0 && errno != EINTR) {
+            r->in_flight -= got;
+            return got ? (int)got : -1;
+        }
+    }
+    r->in_flight -= got;
+    return (int)got;
+}
+
+static int uring_sync(io_file_t *f) {
+    f->syscalls++;
+    return fsync(f->fd);
+}
+
+static int uring_close(io_file_t *f) {
+    uring_t *r = (uring_t*)f->priv;
+    int rc = close(f->fd);
+    f->fd = -1;
+    uring_unmap(r);
+    free(r);
+    f->priv = NULL;
+    return rc;
+}
+
+#else /* no io_uring */
+
+static int uring_open(io_file_t *f, const char *path, int flags, mode_t mode) {
+    (void)f; (void)path; (void)flags; (void)mode;
+    errno = ENOSYS;
+    return -1;
+}
+
+static int uring_submit(io_file_t *f, io_req_t **reqs, unsigned n) {
+    (void)f; (void)reqs; (void)n;
+    errno = ENOSYS;
+    return -1;
+}
+
+static int uring_reap(io_file_t *f, io_req_t **done, unsigned min, unsigned max) {
+    (void)f; (void)done; (void)min; (void)max;
+    errno = ENOSYS;
+    return -1;
+}
+
+static int uring_sync(io_file_t *f) {
+    (void)f;
+    errno = ENOSYS;
+    return -1;
+}
+
+static int uring_close(io_file_t *f) {
+    (void)f;
+    return 0;
+}
+
+#endif
+
+const io_engine_t uring_engine = {
+    .name        = "uring",
+    .description = "io_uring, --iodepth writes in flight per thread",
+    .caps        = IO_CAP_ASYNC,
+    .open        = uring_open,
+    .submit      = uring_submit,
+    .reap        = uring_reap,
+    .sync        = uring_sync,
+    .close       = uring_close,
+};
@@ -0,0 +1,618 @@
+/*
+ * fillfs-microbench.c
+ *
+ * Copyright (c) 2025 Robert Heffernan
+ *
+ * Author: Robert Heffernan <robert@heffernantech.au>
+ *
+ * This file is part of the fillfs utility. It is licensed under the MIT License:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify,
+ * merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * In-memory microbenchmark for the fillfs data generators.
+ *
+ * Measures bytes/second of every entry in datagen_table, and of the random fill
+ * and verify compare of every kernel_table implementation the CPU supports
+ * ("fill.avx2", "diff.avx2", ...), across a set of buffer sizes and thread
+ * counts. Nothing is written to disk, so regressions in the buffer preparation
+ * code show up without the noise of a real device.
+ *
+ * Before measuring, every supported kernel implementation is checked against
+ * the scalar one: random fills must be byte-identical and compare counts equal,
+ * at odd lengths and alignments and with and without non-temporal stores.
+ *
+ * With --neighbour, a cache-sensitive thread chases pointers through a working
+ * set of the given size while the generators run, and its CPU time per access
+ * shows how much of the caches the generators take from other processes.
+ */
+
+#define _GNU_SOURCE
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <ctype.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "datagen.h"
+#include "kernels.h"
+#include "util.h"
+
+#define MAX_LIST 32
+
+/// Generators plus a fill and a diff case per kernel implementation
+#define MAX_CASES 32
+
+/// Largest buffer the kernel check fills: past any L2, so streaming stores run
+#define CHECK_MAX (4u << 20)
+
+/// Neighbour hops between publications of its progress
+#define NB_BATCH 4096
+
+/**
+ * @brief The cache-sensitive neighbour thread and the progress it publishes.
+ */
+static struct {
+    size_t   size;      ///< Working set in bytes, 0 for no neighbour
+    int      stop;      ///< Set to end the thread
+    uint64_t hops;      ///< Pointer hops so far
+    uint64_t cpu_ns;    ///< Thread CPU time at the last publication
+} g_nb;
+
+/**
+ * @brief One measured operation: a generator or kernel fill, or a kernel compare.
+ */
+typedef struct {
+    char        name[32];
+    datagen_fn  fill;   ///< Fills the buffer; with diff, only prepares the inputs
+    uint64_t  (*diff)(const void *a, const void *b, size_t len);  ///< Measured if set
+} bench_case_t;
+
+/**
+ * @brief Per-thread state for one measurement.
+ */
+typedef struct {
+    const bench_case_t *bc;
+    size_t             size;
+    double             min_time;
+    pthread_barrier_t *barrier;
+    uint64_t           bytes;      ///< Bytes generated inside the timed window
+    uint64_t           diffs;      ///< Sum of the compare results, so they are not optimised out
+    int                error;
+} bench_thread_t;
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static uint64_t thread_cpu_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Chase pointers through one random cycle over g_nb.size bytes, one cache
+ *        line per node, so every hop is a dependent load that hits only if the
+ *        working set is still cached.
+ */
+static void *neighbour_thread(void *arg) {
+    size_t n = g_nb.size / 64;
+    void **nodes = aligned_alloc(64, n * 64);
+    size_t *order = malloc(n * sizeof(*order));
+    (void)arg;
+
+    if (!nodes || !order) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    // Sattolo's shuffle gives a single cycle through every node
+    for (size_t i = 0; i < n; ++i) {
+        order[i] = i;
+    }
+    uint64_t rng = 0x9E3779B97F4A7C15ULL;
+    for (size_t i = n - 1; i > 0; --i) {
+        rng ^= rng << 13;
+        rng ^= rng >> 7;
+        rng ^= rng << 17;
+        size_t j = (size_t)(rng % i);
+        size_t t = order[i];
+        order[i] = order[j];
+        order[j] = t;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        nodes[order[i] * 8] = &nodes[order[(i + 1) % n] * 8];
+    }
+    free(order);
+
+    void **p = &nodes[0];
+    while (!__atomic_load_n(&g_nb.stop, __ATOMIC_RELAXED)) {
+        for (int i = 0; i < NB_BATCH; ++i) {
+            p = (void**)*p;
+        }
+        __asm__ volatile("" : : "r"(p));
+        __atomic_store_n(&g_nb.cpu_ns, thread_cpu_ns(), __ATOMIC_RELAXED);
+        __atomic_add_fetch(&g_nb.hops, NB_BATCH, __ATOMIC_RELEASE);
+    }
+    free(nodes);
+    return NULL;
+}
+
+/**
+ * @brief Snapshot the neighbour's progress.
+ */
+static void neighbour_sample(uint64_t *hops, uint64_t *cpu_ns) {
+    *hops   = __atomic_load_n(&g_nb.hops, __ATOMIC_ACQUIRE);
+    *cpu_ns = __atomic_load_n(&g_nb.cpu_ns, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Neighbour CPU nanoseconds per hop between two snapshots (0 if none).
+ */
+static double neighbour_ns(uint64_t hops0, uint64_t cpu0) {
+    uint64_t hops, cpu;
+    neighbour_sample(&hops, &cpu);
+    return (hops > hops0) ? (double)(cpu - cpu0) / (double)(hops - hops0) : 0.0;
+}
+
+/**
+ * @brief Parse a plain positive count.
+ *
+ * @return size_t The count, or 0 if the string is not a valid count.
+ */
+static size_t parse_count(const char *str) {
+    char *end = NULL;
+    errno = 0;
+    unsigned long long v = strtoull(str, &end, 10);
+    return (isdigit((unsigned char)str[0]) && *end == '\0' && errno == 0) ? (size_t)v : 0;
+}
+
+/**
+ * @brief parse_size() (which exits on bad input) as a list entry parser.
+ */
+static size_t parse_list_size(const char *str) {
+    return (size_t)parse_size(str);
+}
+
+/**
+ * @brief Split a comma separated list into sizes or counts with PARSE.
+ *
+ * @return int Number of entries parsed, or -1 on a malformed or zero entry.
+ */
+static int parse_list(const char *arg, size_t (*parse)(const char *), size_t *out, int max) {
+    char *copy = strdup(arg);
+    char *save = NULL;
+    int n = 0;
+
+    for (char *tok = strtok_r(copy, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        if (n == max || (out[n] = parse(tok)) == 0) {
+            free(copy);
+            return -1;
+        }
+        ++n;
+    }
+    free(copy);
+    return n;
+}
+
+static void *bench_thread(void *arg) {
+    bench_thread_t *t = (bench_thread_t*)arg;
+    const bench_case_t *bc = t->bc;
+    unsigned char *buf  = malloc(t->size);
+    unsigned char *buf2 = bc->diff ? malloc(t->size) : NULL;
+
+    if (!buf || (bc->diff && !buf2)) {
+        perror("malloc");
+        t->error = 1;
+    } else {
+        // Warm-up pass: fault the pages in so the timed loop measures generation only
+        bc->fill(buf, t->size, 1);
+        if (buf2) {
+            // Equal but for one byte per page, as when verify finds a few bad blocks
+            memcpy(buf2, buf, t->size);
+            for (size_t i = 0; i < t->size; i += 4096) {
+                buf2[i] ^= 1;
+            }
+        }
+    }
+
+    pthread_barrier_wait(t->barrier);
+    if (t->error) {
+        free(buf);
+        free(buf2);
+        return NULL;
+    }
+
+    double start = now_sec();
+    uint64_t seed = 2;
+    do {
+        if (bc->diff) {
+            t->diffs += bc->diff(buf, buf2, t->size);
+        } else {
+            bc->fill(buf, t->size, seed++);
+        }
+        t->bytes += t->size;
+    } while (now_sec() - start < t->min_time);
+
+    free(buf);
+    free(buf2);
+    return NULL;
+}
+
+/**
+ * @brief Run one case/size/thread-count combination.
+ *
+ * @return double Aggregate throughput in MB/s, or a negative value on error.
+ */
+static double run_one(const bench_case_t *bc, size_t size, size_t threads, double min_time) {
+    pthread_t tids[threads];
+    bench_thread_t state[threads];
+    pthread_barrier_t barrier;
+    uint64_t total = 0;
+    int error = 0;
+
+    pthread_barrier_init(&barrier, NULL, (unsigned)threads + 1);
+    for (size_t i = 0; i < threads; ++i) {
+        state[i] = (bench_thread_t){ bc, size, min_time, &barrier, 0, 0, 0 };
+        if (pthread_create(&tids[i], NULL, bench_thread, &state[i]) != 0) {
+            perror("pthread_create");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    pthread_barrier_wait(&barrier);
+    double start = now_sec();
+    for (size_t i = 0; i < threads; ++i) {
+        pthread_join(tids[i], NULL);
+        total += state[i].bytes;
+        error |= state[i].error;
+    }
+    double elapsed = now_sec() - start;
+    pthread_barrier_destroy(&barrier);
+
+    if (error || elapsed <= 0.0) {
+        return -1.0;
+    }
+    return (double)total / (1024.0 * 1024.0) / elapsed;
+}
+
+/**
+ * @brief Check one kernel implementation against REF (the scalar one) with the
+ *        current non-temporal threshold. Buffers are CHECK_MAX + 64 bytes.
+ *
+ * @return int Number of mismatches found (each one is reported).
+ */
+static int check_kernel(const kernel_set_t *k, const kernel_set_t *ref,
+                        unsigned char *want, unsigned char *got, const char *nt) {
+    static const size_t lens[] = { 0, 1, 2, 3, 4, 5, 7, 15, 16, 17, 31, 32, 33, 63, 64, 65,
+                                   127, 128, 129, 255, 256, 1000, 4096, 65536 + 12,
+                                   CHECK_MAX - 3 };
+    static const size_t offs[] = { 0, 1, 2, 3, 4, 32 };
+    static const uint64_t seeds[] = { 1, 0x0123456789ABCDEFULL };
+    int bad = 0;
+
+    for (size_t l = 0; l < sizeof(lens) / sizeof(lens[0]); ++l) {
+        size_t len = lens[l];
+        for (size_t s = 0; s < sizeof(seeds) / sizeof(seeds[0]); ++s) {
+            ref->random_fill(want, len, seeds[s]);
+            for (size_t o = 0; o < sizeof(offs) / sizeof(offs[0]); ++o) {
+                // Guard bytes around the range catch writes outside it
+                size_t off = offs[o];
+                memset(got, 0xA5, CHECK_MAX + 64);
+                k->random_fill(got + off, len, seeds[s]);
+                int guards_ok = 1;
+                for (size_t i = 0; i < off; ++i) {
+                    guards_ok &= (got[i] == 0xA5);
+                }
+                for (size_t i = off + len; i < off + len + 16; ++i) {
+                    guards_ok &= (got[i] == 0xA5);
+                }
+                if (memcmp(want, got + off, len) != 0 || !guards_ok) {
+                    fprintf(stderr, "Error: %s random_fill differs from %s (len %zu, offset %zu, "
+                                    "seed %#llx, non-temporal %s).\n", k->name, ref->name, len,
+                            off, (unsigned long long)seeds[s], nt);
+                    ++bad;
+                    continue;
+                }
+
+                // Flip bytes at both ends and in between, then compare misaligned
+                size_t flips[] = { 0, len / 3, len / 2, len - 1 };
+                for (size_t f = 0; len > 0 && f < 4; ++f) {
+                    got[off + flips[f]] ^= (unsigned char)(0x11 << f);
+                }
+                uint64_t expect = ref->count_diff(want, got + off, len);
+                uint64_t n      = k->count_diff(want, got + off, len);
+                if (n != expect) {
+                    fprintf(stderr, "Error: %s count_diff returned %llu, %s %llu (len %zu, "
+                                    "offset %zu).\n", k->name, (unsigned long long)n, ref->name,
+                            (unsigned long long)expect, len, off);
+                    ++bad;
+                }
+            }
+        }
+    }
+    return bad;
+}
+
+/**
+ * @brief Check every supported kernel implementation against the scalar one,
+ *        with and without non-temporal stores.
+ *
+ * @return int Number of mismatches found.
+ */
+static int check_kernels(void) {
+    const kernel_set_t *ref = NULL;
+    for (const kernel_set_t *k = kernel_table; k->name; ++k) {
+        if (strcmp(k->name, "scalar") == 0) {
+            ref = k;
+        }
+    }
+    unsigned char *want = malloc(CHECK_MAX + 64);
+    unsigned char *got  = aligned_alloc(64, CHECK_MAX + 64);
+    if (!ref || !want || !got) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+
+    int bad = 0;
+    size_t nt = kernels_set_nt_threshold(SIZE_MAX);
+    for (const kernel_set_t *k = kernel_table; k->name; ++k) {
+        if (k == ref || !k->supported()) {
+            continue;
+        }
+        kernels_set_nt_threshold(SIZE_MAX);
+        bad += check_kernel(k, ref, want, got, "off");
+        kernels_set_nt_threshold(64);
+        bad += check_kernel(k, ref, want, got, "on");
+    }
+    kernels_set_nt_threshold(nt);
+    free(want);
+    free(got);
+    return bad;
+}
+
+/**
+ * @brief List what can be measured: every generator, then a fill and a diff
+ *        case for every kernel implementation this CPU supports.
+ *
+ * @return int Number of cases.
+ */
+static int build_cases(bench_case_t *cases) {
+    int n = 0;
+    for (const datagen_t *g = datagen_table; g->name && n < MAX_CASES; ++g) {
+        cases[n] = (bench_case_t){ "", g->fill, NULL };
+        snprintf(cases[n++].name, sizeof(cases[0].name), "%s", g->name);
+    }
+    for (const kernel_set_t *k = kernel_table; k->name && n + 2 <= MAX_CASES; ++k) {
+        if (!k->supported()) {
+            continue;
+        }
+        cases[n] = (bench_case_t){ "", k->random_fill, NULL };
+        snprintf(cases[n++].name, sizeof(cases[0].name), "fill.%s", k->name);
+        cases[n] = (bench_case_t){ "", k->random_fill, k->count_diff };
+        snprintf(cases[n++].name, sizeof(cases[0].name), "diff.%s", k->name);
+    }
+    return n;
+}
+
+static void show_help(const char *prog_name) {
+    fprintf(stderr,
+        "Usage: %s [OPTIONS]\n\n"
+        "Measure in-memory throughput of the fillfs data generators.\n\n"
+        "Options:\n"
+        "  -g, --generator=NAME   Only run this generator or kernel case, e.g. random or\n"
+        "                         diff.avx2 (may be repeated).\n"
+        "  -s, --sizes=LIST       Buffer sizes, comma separated (default 4K,64K,1M,32M).\n"
+        "  -t, --threads=LIST     Thread counts, comma separated (default 1,<ncpu>).\n"
+        "  -m, --min-time=T       Minimum time per measurement, e.g. 200ms (default 0.5s).\n"
+        "  -n, --neighbour=SIZE   Run a pointer-chasing thread over SIZE bytes alongside\n"
+        "                         and report its CPU ns per access (cache disturbance).\n"
+        "  -N, --nt-threshold=SIZE|off\n"
+        "                         Use non-temporal stores for buffers of SIZE or more\n"
+        "                         (default: the L2 cache size).\n"
+        "  -T, --tsv              Print tab-separated values instead of a table.\n"
+        "  -l, --list             List the generators and kernel cases and exit.\n"
+        "  -h, --help             Display this help message and exit.\n",
+        prog_name);
+}
+
+int main(int argc, char *argv[]) {
+    size_t sizes[MAX_LIST]   = { 4096, 65536, 1 << 20, 32 << 20 };
+    size_t threads[MAX_LIST] = { 1, 0 };
+    int    n_sizes           = 4;
+    int    n_threads         = 2;
+    double min_time          = 0.5;
+    int    tsv               = 0;
+    const char *only[MAX_LIST];
+    int    n_only            = 0;
+    bench_case_t cases[MAX_CASES];
+    int    n_cases           = build_cases(cases);
+
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    threads[1] = (ncpu > 1) ? (size_t)ncpu : 0;
+    if (threads[1] == 0) {
+        n_threads = 1;
+    }
+
+    static struct option long_opts[] = {
+        {"generator", required_argument, 0, 'g'},
+        {"sizes",     required_argument, 0, 's'},
+        {"threads",   required_argument, 0, 't'},
+        {"min-time",  required_argument, 0, 'm'},
+        {"neighbour", required_argument, 0, 'n'},
+        {"nt-threshold", required_argument, 0, 'N'},
+        {"tsv",       no_argument,       0, 'T'},
+        {"list",      no_argument,       0, 'l'},
+        {"help",      no_argument,       0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    int c;
+    while ((c = getopt_long(argc, argv, "g:s:t:m:n:N:Tlh", long_opts, NULL)) != -1) {
+        switch (c) {
+            case 'g': {
+                int known = 0;
+                for (int i = 0; i < n_cases; ++i) {
+                    known |= (strcmp(cases[i].name, optarg) == 0);
+                }
+                if (!known) {
+                    fprintf(stderr, "Error: Unknown generator or kernel case '%s' (see --list).\n", optarg);
+                    return 1;
+                }
+                if (n_only < MAX_LIST) {
+                    only[n_only++] = optarg;
+                }
+                break;
+            }
+            case 's':
+                if ((n_sizes = parse_list(optarg, parse_list_size, sizes, MAX_LIST)) <= 0) {
+                    fprintf(stderr, "Error: Invalid size list '%s'.\n", optarg);
+                    return 1;
+                }
+                break;
+            case 't':
+                if ((n_threads = parse_list(optarg, parse_count, threads, MAX_LIST)) <= 0) {
+                    fprintf(stderr, "Error: Invalid thread list '%s'.\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'm':
+                min_time = parse_duration(optarg);
+                if (min_time <= 0.0) {
+                    fprintf(stderr, "Error: Invalid minimum time '%s'.\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'n':
+                g_nb.size = (size_t)parse_size(optarg);
+                if (g_nb.size < 64) {
+                    fprintf(stderr, "Error: Invalid neighbour size '%s'.\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'N': {
+                size_t v = (strcmp(optarg, "off") == 0) ? SIZE_MAX : (size_t)parse_size(optarg);
+                if (v == 0) {
+                    fprintf(stderr, "Error: Invalid threshold '%s'.\n", optarg);
+                    return 1;
+                }
+                kernels_set_nt_threshold(v);
+                break;
+            }
+            case 'T':
+                tsv = 1;
+                break;
+            case 'l':
+                for (int i = 0; i < n_cases; ++i) {
+                    printf("%s\n", cases[i].name);
+                }
+                return 0;
+            case 'h':
+                show_help(argv[0]);
+                return 0;
+            default:
+                show_help(argv[0]);
+                return 1;
+        }
+    }
+
+    if (check_kernels() != 0) {
+        fprintf(stderr, "Error: Kernel implementations disagree with the scalar one.\n");
+        return 1;
+    }
+
+    pthread_t nb_tid;
+    if (g_nb.size) {
+        if (pthread_create(&nb_tid, NULL, neighbour_thread, NULL) != 0) {
+            perror("pthread_create");
+            return 1;
+        }
+        // Baseline: the neighbour alone, once its working set is warm
+        uint64_t hops0 = 0, cpu0 = 0;
+        while (hops0 == 0) {
+            usleep(10000);
+            neighbour_sample(&hops0, &cpu0);
+        }
+        usleep((useconds_t)(min_time * 1e6));
+        fprintf(stderr, "neighbour alone: %.2f ns per access over %zu bytes\n",
+                neighbour_ns(hops0, cpu0), g_nb.size);
+    }
+
+    if (tsv) {
+        printf("kernel\tsize\tthreads\tmb_s\tns_per_byte%s\n", g_nb.size ? "\tneighbour_ns" : "");
+    } else {
+        printf("%-16s %10s %8s %12s %12s%s\n", "kernel", "size", "threads", "MB/s", "ns/byte",
+               g_nb.size ? "  neighbour ns" : "");
+    }
+
+    for (const bench_case_t *g = cases; g < cases + n_cases; ++g) {
+        if (n_only > 0) {
+            int wanted = 0;
+            for (int i = 0; i < n_only; ++i) {
+                wanted |= (strcmp(only[i], g->name) == 0);
+            }
+            if (!wanted) {
+                continue;
+            }
+        }
+
+        for (int s = 0; s < n_sizes; ++s) {
+            for (int t = 0; t < n_threads; ++t) {
+                uint64_t hops0, cpu0;
+                neighbour_sample(&hops0, &cpu0);
+                double mb_s = run_one(g, sizes[s], threads[t], min_time);
+                double nb_ns = neighbour_ns(hops0, cpu0);
+                if (mb_s < 0.0) {
+                    fprintf(stderr, "Error: %s failed at size %zu.\n", g->name, sizes[s]);
+                    return 1;
+                }
+                // ns per byte as seen by a single thread
+                double ns_b = 1e9 / (mb_s * 1024.0 * 1024.0 / (double)threads[t]);
+                if (tsv) {
+                    printf("%s\t%zu\t%zu\t%.2f\t%.4f", g->name, sizes[s], threads[t], mb_s, ns_b);
+                    if (g_nb.size) {
+                        printf("\t%.2f", nb_ns);
+                    }
+                } else {
+                    printf("%-16s %10zu %8zu %12.2f %12.4f", g->name, sizes[s], threads[t], mb_s, ns_b);
+                    if (g_nb.size) {
+                        printf("  %12.2f", nb_ns);
+                    }
+                }
+                printf("\n");
+                fflush(stdout);
+            }
+        }
+    }
+
+    if (g_nb.size) {
+        __atomic_store_n(&g_nb.stop, 1, __ATOMIC_RELAXED);
+        pthread_join(nb_tid, NULL);
+    }
+    return 0;
+}
@@ -30,36 +30,37 @@
 #define _DEFAULT_SOURCE     /* Helps ensure 'usleep' is declared (or you could use _XOPEN_SOURCE) */
 #define _POSIX_C_SOURCE 200809L
 
+/*
+ * Command line front end. The fill itself lives in libfillfs (fillfs.h);
+ * this file parses options, shows progress and cleans up. Signals are taken
+ * on the control module's signal thread (control.h), which cancels the
+ * writers; the main thread then drains them, reports and cleans up.
+ */
+
 #include <stdint.h>    // for SIZE_MAX
-#include <fcntl.h>     // for O_WRONLY, O_CREAT, O_TRUNC, etc.
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>    // for close, unlink, etc.
-#include <sys/types.h>
-#include <sys/stat.h>
 #include <string.h>
 #include <time.h>
 #include <errno.h>
 #include <getopt.h>
-#include <ctype.h>
-#include <signal.h>
-#include <sys/statvfs.h>
 #include <limits.h>    // for PATH_MAX
-#include <pthread.h>   // for pthread_create, pthread_join, etc.
-
-#ifdef __linux__      // For ioprio_set (Linux only)
-#include <sys/syscall.h>
-#include <linux/ioprio.h>
-#endif
+#include <sys/time.h>  // for struct timeval (getrusage)
+#include <sys/resource.h> // for getrusage
+#include <sys/stat.h>
+#include <math.h>
 
-#include <sys/resource.h> // for setpriority, PRIO_PROCESS
+#include "control.h"
+#include "fillfs.h"
+#include "jobfile.h"
+#include "promfile.h"
+#include "util.h"
 
 #ifndef MAX_FILENAME_LENGTH
 #define MAX_FILENAME_LENGTH 1024
 #endif
 
-#define FILLFS_FILE_NAME "/.fillfs"
-
 /*
  * Global filename for hidden-file usage if target is a directory.
  * If the user passed an actual file, we won't use/unlink g_hidden_filename.
@@ -94,220 +95,393 @@ static void exit_handler(void) {
 }
 
 /**
- * @brief Signal handler for common signals to ensure cleanup.
- *
- * @param signum The signal number caught.
+ * @brief Write a string as a JSON string literal (with quotes and escaping).
  */
-static void signal_handler(int signum) {
-    fprintf(stderr, "\nCaught signal %d. Cleaning up...\n", signum);
-    clean_exit(EXIT_FAILURE);
+static void json_print_string(FILE *out, const char *str) {
+    fputc('"', out);
+    for (const unsigned char *p = (const unsigned char*)str; *p; ++p) {
+        if (*p == '"' || *p == '\\') {
+            fprintf(out, "\\%c", *p);
+        } else if (*p < 0x20) {
+            fprintf(out, "\\u%04x", *p);
+        } else {
+            fputc(*p, out);
+        }
+    }
+    fputc('"', out);
 }
 
 /**
- * @brief Parse a human-readable size string (e.g., 800K, 32M, 10G, etc.) into bytes.
- *
- * @param size_str Input string representing the size (with optional suffix).
- * @return size_t The size in bytes.
+ * @brief Process CPU time so far, in seconds.
  */
-static size_t parse_size(const char *size_str) {
-    size_t size = 0;
-    char suffix = 0;
-    char *endptr = NULL;
-
-    size = strtoull(size_str, &endptr, 10);
+static void cpu_times(double *user_s, double *sys_s) {
+    struct rusage ru;
+    memset(&ru, 0, sizeof(ru));
+    getrusage(RUSAGE_SELF, &ru);
+    *user_s = (double)ru.ru_utime.tv_sec + (double)ru.ru_utime.tv_usec / 1e6;
+    *sys_s  = (double)ru.ru_stime.tv_sec + (double)ru.ru_stime.tv_usec / 1e6;
+}
 
-    if (endptr && *endptr) {
-        suffix = (char)tolower((unsigned char)*endptr);
+/**
+ * @brief Print the statistics fields shared by the run and phase JSON objects.
+ */
+static void print_json_stats(FILE *out, const fillfs_stats_t *stats, double cpu_user_s, double cpu_sys_s) {
+    fprintf(out,
+            "\"engine\":\"%s\",\"threads\":%u,\"iodepth\":%u,"
+            "\"mode\":\"%s\",\"block_size\":%zu,\"bytes\":%llu,"
+            "\"elapsed_s\":%.6f,\"throughput_mb_s\":%.2f,\"paused_s\":%.3f,"
+            "\"cpu_user_s\":%.6f,\"cpu_sys_s\":%.6f,\"writes\":%llu,"
+            "\"lat_mean_us\":%.1f,\"lat_p50_us\":%.1f,\"lat_p90_us\":%.1f,"
+            "\"lat_p99_us\":%.1f,\"lat_max_us\":%.1f,"
+            "\"writer_cpu_user_s\":%.6f,\"writer_cpu_sys_s\":%.6f,\"cpu_s_per_gb\":%.4f,"
+            "\"syscalls\":%llu,\"syscalls_per_gb\":%.1f,"
+            "\"ctx_voluntary\":%llu,\"ctx_involuntary\":%llu,",
+            stats->engine,
+            stats->threads,
+            stats->iodepth,
+            stats->data_mode,
+            stats->block_size,
+            (unsigned long long)stats->bytes_written,
+            stats->elapsed_s,
+            stats->throughput_mb_s,
+            stats->paused_s,
+            cpu_user_s,
+            cpu_sys_s,
+            (unsigned long long)stats->writes,
+            stats->lat_mean_us,
+            stats->lat_p50_us,
+            stats->lat_p90_us,
+            stats->lat_p99_us,
+            stats->lat_max_us,
+            stats->cpu_user_s,
+            stats->cpu_sys_s,
+            stats->cpu_s_per_gb,
+            (unsigned long long)stats->syscalls,
+            stats->syscalls_per_gb,
+            (unsigned long long)stats->ctx_voluntary,
+            (unsigned long long)stats->ctx_involuntary);
+    if (stats->hw_counters) {
+        fprintf(out, "\"cycles\":%llu,\"instructions\":%llu,\"cache_misses\":%llu,\"ipc\":%.3f,",
+                (unsigned long long)stats->cycles,
+                (unsigned long long)stats->instructions,
+                (unsigned long long)stats->cache_misses,
+                stats->ipc);
     }
-
-    switch (suffix) {
-        case 'k':  // Kilobytes (1024 bytes)
-            size *= 1024ULL;
-            break;
-        case 'm':  // Megabytes (1024 * 1024)
-            size *= 1024ULL * 1024ULL;
-            break;
-        case 'g':  // Gigabytes (1024 * 1024 * 1024)
-            size *= 1024ULL * 1024ULL * 1024ULL;
-            break;
-        case 't':  // Terabytes
-            size *= 1024ULL * 1024ULL * 1024ULL * 1024ULL;
-            break;
-        case 'p':  // Petabytes
-            size *= 1024ULL * 1024ULL * 1024ULL * 1024ULL * 1024ULL;
-            break;
-        case 'e':  // Exabytes
-            size *= 1024ULL * 1024ULL * 1024ULL * 1024ULL * 1024ULL * 1024ULL;
-            break;
-        case 'z':  // Zettabytes
-            size *= 1024ULL * 1024ULL * 1024ULL * 1024ULL * 1024ULL * 1024ULL * 1024ULL;
-            break;
-        case 'y':  // Yottabytes
-            size *= 1024ULL * 1024ULL * 1024ULL * 1024ULL * 1024ULL * 1024ULL * 1024ULL * 1024ULL;
-            break;
-        case 0:    // No suffix provided; assume bytes
-            break;
-        default:
-            fprintf(stderr,
-                    "Error: Invalid size suffix '%c'. Supported: K, M, G, T, P, E, Z, Y.\n",
-                    suffix);
-            exit(EXIT_FAILURE);
+    fprintf(out, "\"stalls\":%u,\"stall_s\":%.3f,", stats->stalls, stats->stall_s);
+    if (stats->reads || stats->read_errors) {
+        fprintf(out, "\"reads\":%llu,\"read_bytes\":%llu,\"read_errors\":%llu,"
+                     "\"read_lat_mean_us\":%.1f,\"read_lat_p50_us\":%.1f,\"read_lat_p90_us\":%.1f,"
+                     "\"read_lat_p99_us\":%.1f,\"read_lat_max_us\":%.1f,",
+                (unsigned long long)stats->reads,
+                (unsigned long long)stats->read_bytes,
+                (unsigned long long)stats->read_errors,
+                stats->read_lat_mean_us,
+                stats->read_lat_p50_us,
+                stats->read_lat_p90_us,
+                stats->read_lat_p99_us,
+                stats->read_lat_max_us);
     }
-
-    return size;
+    fprintf(out, "\"disk_full\":%d,\"cancelled\":%d,\"error\":%d",
+            stats->disk_full, stats->cancelled, stats->error);
 }
 
 /**
- * @brief Generate full path for the fill file in the provided directory.
- *
- * @param path         The buffer to store the resulting filename.
- * @param mount_point  The directory path where the file will be created.
+ * @brief Print the CPU cost lines of the --status summary.
  */
-static void generate_file_path(char *path, const char *mount_point) {
-    snprintf(path, MAX_FILENAME_LENGTH, "%s%s", mount_point, FILLFS_FILE_NAME);
+static void print_cpu_summary(FILE *out, const fillfs_stats_t *stats) {
+    fprintf(out,
+            "CPU: %.3f s/GB (user %.2f s, sys %.2f s) | %.0f syscalls/GB | "
+            "%llu context switches (%llu involuntary)\n",
+            stats->cpu_s_per_gb, stats->cpu_user_s, stats->cpu_sys_s, stats->syscalls_per_gb,
+            (unsigned long long)(stats->ctx_voluntary + stats->ctx_involuntary),
+            (unsigned long long)stats->ctx_involuntary);
+    if (stats->hw_counters) {
+        fprintf(out, "IPC: %.2f (%llu cycles, %llu instructions, %llu cache misses)\n",
+                stats->ipc,
+                (unsigned long long)stats->cycles,
+                (unsigned long long)stats->instructions,
+                (unsigned long long)stats->cache_misses);
+    }
 }
 
-#ifdef __linux__
+/** Most throughput phases reported; a change-point per few seconds is plenty. */
+#define MAX_TPUT_PHASES 32
+
 /**
- * @brief Attempt to set the I/O priority of the current thread to "idle" class.
- *        This is Linux-specific and requires the ioprio_set syscall.
+ * @brief Print the throughput phase table of the --status summary.
  */
-static void set_io_priority_idle(void) {
-    // ioprio_set(ioprio_which = 1 for PRIO_PROCESS, who = 0 for current,
-    // ioprio = IOPRIO_PRIO_VALUE(IOPRIO_CLASS_IDLE, 7))
-    if (syscall(SYS_ioprio_set, 1, 0, IOPRIO_PRIO_VALUE(IOPRIO_CLASS_IDLE, 7)) == -1) {
-        perror("ioprio_set");
-        // If this fails, we silently ignore or fallback to CPU nice.
+static void print_tput_phases(FILE *out, const fillfs_tput_phase_t *phases, unsigned n) {
+    fprintf(out, "Throughput phases:\n");
+    fprintf(out, "  %-3s %12s %12s %10s %10s %10s\n",
+            "#", "From (MB)", "To (MB)", "Start (s)", "Time (s)", "MB/s");
+    for (unsigned i = 0; i < n; ++i) {
+        fprintf(out, "  %-3u %12.0f %12.0f %10.1f %10.1f %10.1f\n", i + 1,
+                (double)phases[i].start_bytes / (1024.0 * 1024.0),
+                (double)phases[i].end_bytes / (1024.0 * 1024.0),
+                phases[i].start_s, phases[i].duration_s, phases[i].throughput_mb_s);
     }
 }
-#endif
 
 /**
- * @brief Struct for passing arguments & tracking progress between threads.
+ * @brief Print the fill-level profile as a table, or as CSV for --fill-profile-csv.
  */
-typedef struct {
-    const char *filename;       ///< Path to file to fill/overwrite
-    size_t      file_size;      ///< Desired size in bytes (or min with file if existing)
-    size_t      block_size;     ///< Write in these chunks
-    int         use_random;     ///< 1 if random, 0 if not
-    int         use_zero;       ///< 1 if zero, overrides random
-    size_t      known_free_space; ///< For better progress calc if file_size == SIZE_MAX
-    int         existing_file;  ///< 1 if user gave us an existing file, 0 if hidden-file
-
-    volatile size_t total_written; ///< Shared progress: how many bytes have been written
-    volatile int    done;          ///< 1 when writer thread finishes
-    volatile int    error;         ///< Non-zero if error
-} fill_thread_args_t;
+static void print_fill_profile(FILE *out, const fillfs_level_stats_t *levels, unsigned n, int csv) {
+    if (csv) {
+        fprintf(out, "from_pct,to_pct,bytes,writes,duration_s,throughput_mb_s,"
+                     "lat_mean_us,lat_p50_us,lat_p90_us,lat_p99_us,lat_max_us\n");
+    } else {
+        fprintf(out, "Fill-level profile:\n");
+        fprintf(out, "  %6s %6s %10s %9s %10s %10s %10s %10s %10s\n",
+                "From%", "To%", "MB", "Time (s)", "MB/s", "p50 (us)", "p90 (us)", "p99 (us)", "max (us)");
+    }
+    for (unsigned i = 0; i < n; ++i) {
+        const fillfs_level_stats_t *l = &levels[i];
+        if (csv) {
+            fprintf(out, "%.2f,%.2f,%llu,%llu,%.3f,%.2f,%.1f,%.1f,%.1f,%.1f,%.1f\n",
+                    l->from_pct, l->to_pct, (unsigned long long)l->bytes,
+                    (unsigned long long)l->writes, l->duration_s, l->throughput_mb_s,
+                    l->lat_mean_us, l->lat_p50_us, l->lat_p90_us, l->lat_p99_us, l->lat_max_us);
+        } else {
+            fprintf(out, "  %6.1f %6.1f %10.0f %9.1f %10.1f %10.0f %10.0f %10.0f %10.0f\n",
+                    l->from_pct, l->to_pct, (double)l->bytes / (1024.0 * 1024.0), l->duration_s,
+                    l->throughput_mb_s, l->lat_p50_us, l->lat_p90_us, l->lat_p99_us, l->lat_max_us);
+        }
+    }
+}
 
 /**
- * @brief Thread function that fills (or overwrites) the file until file_size is reached or ENOSPC.
+ * @brief Write the fill-level profile of JOB to stdout and/or a CSV file.
  *
- * @param arg Pointer to fill_thread_args_t containing all parameters and shared progress.
- * @return void* Not used. Thread sets arg->done and arg->error internally.
+ * @return int 0 on success, -1 if the CSV file could not be written.
  */
-static void* fill_file_thread(void *arg) {
-    fill_thread_args_t *params = (fill_thread_args_t*)arg;
-    int fd = -1;
-    void *buffer = NULL;
-    ssize_t bytes_written;
-    size_t total_written_local = 0;
-
-    // Lower CPU priority:
-    setpriority(PRIO_PROCESS, 0, 19); // NICENESS=19 => lowest CPU scheduling priority
-
-#ifdef __linux__
-    // Also try to set I/O priority to idle class on Linux:
-    set_io_priority_idle();
-#endif
-
-    // Allocate buffer
-    buffer = malloc(params->block_size);
-    if (!buffer) {
+static int report_fill_profile(fillfs_job_t *job, const char *csv_path) {
+    unsigned n = fillfs_job_fill_profile(job, NULL, 0);
+    fillfs_level_stats_t *levels = calloc(n ? n : 1, sizeof(*levels));
+    if (!levels) {
         perror("malloc");
-        params->error = 1;
-        params->done  = 1;
-        pthread_exit(NULL);
+        return -1;
+    }
+    n = fillfs_job_fill_profile(job, levels, n);
+
+    int rc = 0;
+    if (csv_path) {
+        FILE *f = fopen(csv_path, "w");
+        if (!f) {
+            perror(csv_path);
+            rc = -1;
+        } else {
+            print_fill_profile(f, levels, n, 1);
+            if (fclose(f) != 0) {
+                perror(csv_path);
+                rc = -1;
+            }
+        }
+    } else {
+        print_fill_profile(stdout, levels, n, 0);
     }
+    free(levels);
+    return rc;
+}
+
+/** SNIA PTS steady-state window, in rounds (loops). */
+#define STEADY_WINDOW 5
 
-    // Fill buffer with either zeros or random data
-    if (params->use_zero) {
-        memset(buffer, 0, params->block_size);
+/**
+ * @brief State of --loops / --duration overwrite passes.
+ */
+typedef struct {
+    int       active;       ///< Loop mode (the job is persistent)
+    unsigned  max;          ///< Loops requested, 0 = until the duration is up
+    double    duration_s;   ///< Stop after this long, 0 = no limit
+    unsigned  done;         ///< Loops finished
+    double   *tput;         ///< Throughput of each complete loop
+    unsigned  n_tput;
+    uint64_t  base;         ///< bytes_written at the start of the current loop
+    int       timed_out;    ///< The duration ran out; the last loop is partial
+    unsigned  steady_at;    ///< Loop that completed the first steady-state window, 0 = none
+    double    cpu_user_s;   ///< Process CPU time at the end of the previous loop
+    double    cpu_sys_s;
+} loop_state_t;
+
+/**
+ * @brief SNIA PTS steady-state test over the last STEADY_WINDOW values: the
+ *        range must stay within 20% of their mean, and the least-squares line
+ *        through them may move by at most 10% of the mean across the window.
+ *
+ * @return int 1 if the window is steady; RANGE_PCT and SLOPE_PCT get the figures.
+ */
+static int steady_state(const double *y, unsigned n, double *range_pct, double *slope_pct) {
+    if (n < STEADY_WINDOW) {
+        return 0;
     }
-    else if (params->use_random) {
-        srand((unsigned int)time(NULL));
-        for (size_t i = 0; i < params->block_size; ++i) {
-            ((unsigned char*)buffer)[i] = (unsigned char)(rand() % 256);
-        }
+    y += n - STEADY_WINDOW;
+
+    double lo = y[0], hi = y[0], sum = 0.0, sum_xy = 0.0;
+    for (unsigned i = 0; i < STEADY_WINDOW; ++i) {
+        lo = (y[i] < lo) ? y[i] : lo;
+        hi = (y[i] > hi) ? y[i] : hi;
+        sum    += y[i];
+        sum_xy += (double)i * y[i];
     }
-    else {
-        // Default to zero if neither random nor zero is specified
-        memset(buffer, 0, params->block_size);
+    double mean = sum / STEADY_WINDOW;
+    if (mean <= 0.0) {
+        return 0;
     }
+    // x = 0..W-1: mean (W-1)/2, sum of squared deviations W(W^2-1)/12
+    double x_mean = (STEADY_WINDOW - 1) / 2.0;
+    double sxx    = STEADY_WINDOW * (STEADY_WINDOW * STEADY_WINDOW - 1) / 12.0;
+    double slope  = (sum_xy - x_mean * sum) / sxx;
+
+    *range_pct = 100.0 * (hi - lo) / mean;
+    *slope_pct = 100.0 * fabs(slope) * (STEADY_WINDOW - 1) / mean;
+    return *range_pct <= 20.0 && *slope_pct <= 10.0;
+}
 
-    /*
-     * If it's an existing file, open for writing but do NOT truncate,
-     * because we only want to overwrite. If it's a hidden file in a directory,
-     * we can create/truncate as usual.
-     */
-    int open_flags = 0;
-    if (params->existing_file) {
-        // Overwrite existing file. No O_TRUNC => we won't shrink it on open.
-        open_flags = O_WRONLY;
-    } else {
-        // If it's a newly created hidden file, we do O_CREAT | O_TRUNC
-        open_flags = O_WRONLY | O_CREAT | O_TRUNC;
-    }
-
-    fd = open(params->filename, open_flags, 0666);
-    if (fd == -1) {
-        perror("open");
-        free(buffer);
-        params->error = 1;
-        params->done  = 1;
-        pthread_exit(NULL);
-    }
-
-    // Perform writes in a loop
-    while (total_written_local < params->file_size) {
-        // Compute how much we can write in this iteration (avoid overshooting)
-        size_t bytes_to_write = params->block_size;
-        size_t remaining      = params->file_size - total_written_local;
-        if (remaining < params->block_size) {
-            bytes_to_write = remaining;
-        }
-
-        bytes_written = write(fd, buffer, bytes_to_write);
-        if (bytes_written == -1) {
-            if (errno == ENOSPC) {
-                // Disk is full
-                break;  // done writing
+/**
+ * @brief Account the loop that just finished, report it, and start the next
+ *        one if the loop count and duration allow.
+ *
+ * @return int 1 if another loop was started, 0 when looping is over.
+ */
+static int next_loop(fillfs_job_t *job, loop_state_t *loop, uint64_t size, int json, int status) {
+    fillfs_stats_t stats;
+    int rc = fillfs_job_wait_phase(job, &stats);
+    int partial = loop->timed_out || stats.cancelled;
+    loop->done++;
+
+    // A partial loop says nothing about steady state
+    double range_pct = 0.0, slope_pct = 0.0;
+    int steady = 0;
+    if (!partial) {
+        double *t = realloc(loop->tput, (loop->n_tput + 1) * sizeof(*t));
+        if (t) {
+            loop->tput = t;
+            loop->tput[loop->n_tput++] = stats.throughput_mb_s;
+            steady = steady_state(loop->tput, loop->n_tput, &range_pct, &slope_pct);
+            if (steady && !loop->steady_at) {
+                loop->steady_at = loop->done;
             }
-            perror("write");
-            params->error = 1;
-            break;
         }
+    }
 
-        total_written_local   += (size_t)bytes_written;
-        params->total_written = total_written_local; // update shared progress
-
-        // If we reached the target file size
-        if (total_written_local >= params->file_size) {
-            break;
+    if (json) {
+        double cpu_user_s, cpu_sys_s;
+        cpu_times(&cpu_user_s, &cpu_sys_s);
+        fprintf(stdout, "{\"loop\":%u,\"partial\":%d,\"steady\":%d,", loop->done, partial, steady);
+        print_json_stats(stdout, &stats, cpu_user_s - loop->cpu_user_s, cpu_sys_s - loop->cpu_sys_s);
+        fprintf(stdout, "}\n");
+        loop->cpu_user_s = cpu_user_s;
+        loop->cpu_sys_s  = cpu_sys_s;
+    } else {
+        fprintf(stdout, "%sLoop %u%s: %.2f MB in %.2f s (%.2f MB/s)",
+                status ? "\r" : "", loop->done, partial ? " (partial)" : "",
+                (double)stats.bytes_written / (1024.0 * 1024.0), stats.elapsed_s,
+                stats.throughput_mb_s);
+        if (loop->n_tput >= STEADY_WINDOW && !partial) {
+            fprintf(stdout, " | last %d: range %.1f%%, slope %.1f%%%s",
+                    STEADY_WINDOW, range_pct, slope_pct, steady ? " - steady state" : "");
         }
+        fprintf(stdout, "%s\n", status ? "                    " : "");
     }
+    fflush(stdout);
 
-    // Flush
-    if (fsync(fd) == -1) {
-        perror("fsync");
-        params->error = 1;
+    if (rc != 0 || partial || (loop->max && loop->done >= loop->max)) {
+        return 0;
+    }
+    loop->base += stats.bytes_written;
+    return fillfs_job_continue(job, 0, size) == 0;
+}
+
+/**
+ * @brief Print a one-line JSON summary of a finished fill (for --json).
+ *
+ * Throughput is derived from the writers' own timestamps rather than the
+ * status loop, so it is not quantised by the 200 ms polling interval.
+ *
+ * @param out      Stream to print to.
+ * @param path_arg Target as given on the command line.
+ * @param stats    Final job statistics.
+ * @param phases   Throughput phases of the run.
+ * @param n        Number of phases.
+ */
+static void print_json_summary(FILE *out, const char *path_arg, const fillfs_stats_t *stats,
+                               const fillfs_tput_phase_t *phases, unsigned n) {
+    double cpu_user_s, cpu_sys_s;
+    cpu_times(&cpu_user_s, &cpu_sys_s);
+
+    fprintf(out, "{\"target\":");
+    json_print_string(out, path_arg);
+    fputc(',', out);
+    print_json_stats(out, stats, cpu_user_s, cpu_sys_s);
+    fprintf(out, ",\"tput_phases\":[");
+    for (unsigned i = 0; i < n; ++i) {
+        fprintf(out, "%s{\"start_bytes\":%llu,\"end_bytes\":%llu,\"start_s\":%.1f,"
+                     "\"duration_s\":%.1f,\"mb_s\":%.2f}",
+                i ? "," : "",
+                (unsigned long long)phases[i].start_bytes,
+                (unsigned long long)phases[i].end_bytes,
+                phases[i].start_s, phases[i].duration_s, phases[i].throughput_mb_s);
     }
+    fprintf(out, "]}\n");
+    fflush(out);
+}
 
-    close(fd);
-    free(buffer);
+/**
+ * @brief Job file phase reporter: a text line per phase, or a JSON object with --json.
+ */
+typedef struct {
+    int    json;
+    double cpu_user_s;  ///< Process CPU time at the end of the previous phase
+    double cpu_sys_s;
+} phase_report_t;
+
+static void report_phase(const jobfile_phase_t *phase, void *user) {
+    phase_report_t *rep = (phase_report_t*)user;
+    double cpu_user_s, cpu_sys_s;
+    cpu_times(&cpu_user_s, &cpu_sys_s);
+
+    if (rep->json) {
+        fprintf(stdout, "{\"phase\":");
+        json_print_string(stdout, phase->name);
+        fprintf(stdout, ",\"action\":\"%s\",\"target\":", phase->action);
+        json_print_string(stdout, phase->target);
+        fprintf(stdout, ",\"fs_used_pct\":%.2f,", phase->fs_used_pct);
+        if (phase->stats) {
+            fprintf(stdout, "\"file_extent\":%llu,", (unsigned long long)phase->stats->file_extent);
+            print_json_stats(stdout, phase->stats,
+                             cpu_user_s - rep->cpu_user_s, cpu_sys_s - rep->cpu_sys_s);
+        } else {
+            fprintf(stdout,
+                    "\"bytes\":%llu,\"files\":%llu,\"mismatched\":%llu,"
+                    "\"elapsed_s\":%.6f,\"error\":%d",
+                    (unsigned long long)phase->bytes,
+                    (unsigned long long)phase->files,
+                    (unsigned long long)phase->mismatched,
+                    phase->elapsed_s,
+                    phase->error);
+        }
+        fprintf(stdout, "}\n");
+    } else {
+        fprintf(stdout, "[%s] %-6s %8.2f s  %10.2f MB",
+                phase->name, phase->action, phase->elapsed_s,
+                (double)phase->bytes / (1024.0 * 1024.0));
+        if (phase->stats) {
+            fprintf(stdout, "  %8.2f MB/s  p99 %.1f us%s",
+                    phase->stats->throughput_mb_s, phase->stats->lat_p99_us,
+                    phase->stats->disk_full ? "  (disk full)" : "");
+        }
+        if (phase->fs_used_pct >= 0.0) {
+            fprintf(stdout, "  fs %.1f%% used", phase->fs_used_pct);
+        }
+        if (phase->error) {
+            fprintf(stdout, "  FAILED");
+        }
+        fputc('\n', stdout);
+    }
+    fflush(stdout);
 
-    // Mark done
-    params->done = 1;
-    pthread_exit(NULL);
+    rep->cpu_user_s = cpu_user_s;
+    rep->cpu_sys_s  = cpu_sys_s;
 }
 
 /**
@@ -328,12 +502,60 @@ static void show_help(const char *prog_name) {
         "     - an existing file: overwrite up to [size] or to its own size.\n\n"
         "  [size]          Optional. If omitted, fill until the disk is full (dir case),\n"
         "                  or overwrite the entire existing file (file case).\n"
-        "                  Supports suffixes: K, M, G, T, P, E, Z, Y.\n\n"
+        "                  Sizes take a fraction and a unit: 1.5T, 32M and 4GiB are\n"
+        "                  binary (1024-based), 4GB and 10TB decimal (1000-based).\n"
+        "                  Rates may end in /s (200MB/s).\n\n"
         "Options:\n"
         "  -r, --random           Write random data.\n"
         "  -z, --zero             Write zero data (overrides --random if both set).\n"
         "  -s, --status           Show progress (throughput, ETA, etc.).\n"
         "  -b, --block-size=SIZE  Set the write block size. Defaults to 32M if not specified.\n"
+        "  -e, --engine=NAME      I/O engine: sync (default), uring or fake.\n"
+        "                         Use --engine=help to list engines.\n"
+        "  -q, --iodepth=N        Writes in flight per thread (async engines, default 8).\n"
+        "  -t, --threads=N        Number of writer threads (default 1).\n"
+        "      --rate=SIZE        Limit the aggregate write rate to SIZE per second.\n"
+        "      --job=FILE         Run the phases of a job file (age, fill, hold, free,\n"
+        "                         verify) in one process; see fillfs(1).\n"
+        "      --fault=SPEC       Use the in-process fake engine (no data is written) and\n"
+        "                         inject faults, e.g. enospc=1G,short=0.1,eio=0.01,seed=7.\n"
+        "  -J, --json             Print a one-line JSON summary (throughput, CPU time,\n"
+        "                         write latency percentiles) when finished.\n"
+        "      --hw-counters      Also count cycles, instructions and cache misses of the\n"
+        "                         writer threads (perf_event_open) and report IPC.\n"
+        "      --trace=PATH       Record spans per thread (generate, open, submit, wait,\n"
+        "                         fsync, cleanup) and write a Chrome trace JSON for Perfetto.\n"
+        "      --trace-sample=N   Also trace one write in N individually (default 16).\n"
+        "      --prom-textfile=PATH  Keep PATH updated with Prometheus metrics (bytes,\n"
+        "                         rate, latency histogram, errors, phase, free space) for\n"
+        "                         node_exporter's textfile collector.\n"
+        "      --prom-interval=T  Rewrite the textfile every T (default 15s).\n"
+        "      --control=PATH     Accept commands on a Unix socket at PATH: stats, rate SIZE,\n"
+        "                         pause, resume, threads N, stop (one per line).\n"
+        "      --link-fill-file   Give the anonymous fill file a visible name (/.fillfs)\n"
+        "                         for debugging; it is then not released if killed.\n"
+        "      --shutdown-timeout=T  After SIGINT/SIGTERM, exit anyway if writes in flight\n"
+        "                         and cleanup take longer than T (default 30s, 0 = no limit).\n"
+        "      --stall-timeout=T  Warn when a write has been in flight longer than T, with\n"
+        "                         the writer, device and offset (default 30s, 0 = off).\n"
+        "      --stall-dump       With each stall warning, also print the device's in-flight\n"
+        "                         counts and the kernel stack of every thread.\n"
+        "      --fill-profile[=PCT]  Record throughput and write latency percentiles for\n"
+        "                         every PCT (default 1) of filesystem capacity filled and\n"
+        "                         print them as a table at the end.\n"
+        "      --fill-profile-csv=PATH  Write that profile to PATH as CSV instead.\n"
+        "      --loops=N          Overwrite an existing file or block device N times,\n"
+        "                         reporting each loop and SNIA steady state.\n"
+        "      --duration=T       Keep overwriting until T has passed (with --loops, at\n"
+        "                         most N loops).\n"
+        "      --random-order     Write the blocks of each pass in a new random order.\n"
+        "      --read-file=PATH   While filling, time reads of the existing file PATH\n"
+        "                         (O_DIRECT where possible) and report their latency.\n"
+        "      --read-iops=N      Background reads per second (default 100, 0 = back to back).\n"
+        "      --read-size=SIZE   Bytes per background read (default 4K).\n"
+        "      --read-seq         Read PATH in order instead of at random offsets.\n"
+        "      --show-cpu-features  Show the CPU features found and the data kernels\n"
+        "                         selected for them, then exit.\n"
         "  -h, --help             Display this help message and exit.\n\n"
         "Examples:\n"
         "  %s / --status 1G\n"
@@ -350,20 +572,26 @@ int main(int argc, char *argv[]) {
     // Install cleanup for hidden-file scenario
     atexit(exit_handler);
 
-    // Register signals
-    signal(SIGINT,  signal_handler);
-    signal(SIGTERM, signal_handler);
-#ifdef SIGHUP
-    signal(SIGHUP,  signal_handler);
-#endif
-
     // Default settings
     int    use_random       = 0;
     int    use_zero         = 0;
     int    show_status      = 0;
+    int    show_json        = 0;
     size_t file_size        = SIZE_MAX;  // fill until full by default (dir scenario)
     size_t block_size       = 0;         // will default to 32M if not specified
-    size_t known_free_space = 0;         // helps with ETA if user doesn't specify size
+    const char *job_file    = NULL;
+    const char *prom_path   = NULL;
+    double prom_interval    = 15.0;
+    const char *control_path = NULL;
+    double shutdown_timeout = 30.0;
+    const char *profile_csv = NULL;
+    loop_state_t loop;
+    memset(&loop, 0, sizeof(loop));
+
+    fillfs_config_t cfg;
+    fillfs_config_init(&cfg);
+    cfg.stall_ms  = 30000;
+    cfg.read_iops = 100;
 
     static struct option long_opts[] = {
         {"random",      no_argument,       0, 'r'},
@@ -371,12 +599,39 @@ int main(int argc, char *argv[]) {
         {"status",      no_argument,       0, 's'},
         {"help",        no_argument,       0, 'h'},
         {"block-size",  required_argument, 0, 'b'},
+        {"json",        no_argument,       0, 'J'},
+        {"fault",       required_argument, 0, 'F'},
+        {"engine",      required_argument, 0, 'e'},
+        {"iodepth",     required_argument, 0, 'q'},
+        {"threads",     required_argument, 0, 't'},
+        {"rate",        required_argument, 0, 'R'},
+        {"job",         required_argument, 0, 'j'},
+        {"hw-counters", no_argument,       0, 'H'},
+        {"trace",       required_argument, 0, 'T'},
+        {"trace-sample", required_argument, 0, 'S'},
+        {"prom-textfile", required_argument, 0, 'P'},
+        {"prom-interval", required_argument, 0, 'I'},
+        {"control",     required_argument, 0, 'C'},
+        {"shutdown-timeout", required_argument, 0, 'D'},
+        {"link-fill-file", no_argument,    0, 'L'},
+        {"stall-timeout", required_argument, 0, 'W'},
+        {"stall-dump",  no_argument,       0, 'U'},
+        {"fill-profile", optional_argument, 0, 'G'},
+        {"fill-profile-csv", required_argument, 0, 'V'},
+        {"loops",       required_argument, 0, 'O'},
+        {"duration",    required_argument, 0, 'Y'},
+        {"random-order", no_argument,      0, 'X'},
+        {"read-file",   required_argument, 0, 'A'},
+        {"read-iops",   required_argument, 0, 'B'},
+        {"read-size",   required_argument, 0, 'K'},
+        {"read-seq",    no_argument,       0, 'Q'},
+        {"show-cpu-features", no_argument, 0, 'M'},
         {0, 0, 0, 0}
     };
 
     while (1) {
         int opt_index = 0;
-        int c = getopt_long(argc, argv, "rzshb:", long_opts, &opt_index);
+        int c = getopt_long(argc, argv, "rzshb:Je:q:t:", long_opts, &opt_index);
         if (c == -1) {
             break;
         }
@@ -390,6 +645,150 @@ int main(int argc, char *argv[]) {
             case 's':
                 show_status = 1;
                 break;
+            case 'J':
+                show_json = 1;
+                break;
+            case 'F':
+                cfg.fault_spec = optarg;
+                break;
+            case 'R':
+                cfg.rate_limit = parse_rate(optarg);
+                break;
+            case 'j':
+                job_file = optarg;
+                break;
+            case 'H':
+                cfg.hw_counters = 1;
+                break;
+            case 'T':
+                cfg.trace_path = optarg;
+                break;
+            case 'P':
+                prom_path = optarg;
+                break;
+            case 'C':
+                control_path = optarg;
+                break;
+            case 'L':
+                cfg.link_fill_file = 1;
+                break;
+            case 'D':
+                shutdown_timeout = parse_duration(optarg);
+                if (shutdown_timeout < 0.0) {
+                    fprintf(stderr, "Error: Invalid shutdown timeout '%s'.\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'W': {
+                double t = parse_duration(optarg);
+                if (t < 0.0 || t > 86400.0) {
+                    fprintf(stderr, "Error: Invalid stall timeout '%s'.\n", optarg);
+                    return 1;
+                }
+                cfg.stall_ms = (unsigned)(t * 1000.0 + 0.5);
+                break;
+            }
+            case 'U':
+                cfg.stall_dump = 1;
+                break;
+            case 'O': {
+                char *end = NULL;
+                unsigned long v = strtoul(optarg, &end, 10);
+                if (*end != '\0' || v == 0 || v > 1000000) {
+                    fprintf(stderr, "Error: Invalid loop count '%s'.\n", optarg);
+                    return 1;
+                }
+                loop.max = (unsigned)v;
+                break;
+            }
+            case 'Y':
+                loop.duration_s = parse_duration(optarg);
+                if (loop.duration_s <= 0.0) {
+                    fprintf(stderr, "Error: Invalid duration '%s'.\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'X':
+                cfg.random_order = 1;
+                break;
+            case 'A':
+                cfg.read_path = optarg;
+                break;
+            case 'B': {
+                char *end = NULL;
+                unsigned long v = strtoul(optarg, &end, 10);
+                if (*end != '\0' || v > 1000000) {
+                    fprintf(stderr, "Error: Invalid read rate '%s'.\n", optarg);
+                    return 1;
+                }
+                cfg.read_iops = (unsigned)v;
+                break;
+            }
+            case 'K':
+                cfg.read_size = parse_size(optarg);
+                if (cfg.read_size == 0) {
+                    fprintf(stderr, "Error: Invalid read size.\n");
+                    return 1;
+                }
+                break;
+            case 'Q':
+                cfg.read_seq = 1;
+                break;
+            case 'M':
+                fillfs_show_cpu_features(stdout);
+                return 0;
+            case 'G':
+            case 'V':
+                if (c == 'V') {
+                    profile_csv = optarg;
+                } else if (optarg) {
+                    char *end = NULL;
+                    double step = strtod(optarg, &end);
+                    if (end == optarg || (*end != '\0' && strcmp(end, "%") != 0) ||
+                        step < 0.01 || step > 50.0) {
+                        fprintf(stderr, "Error: Invalid fill-profile step '%s'.\n", optarg);
+                        return 1;
+                    }
+                    cfg.profile_step_pct = step;
+                }
+                if (cfg.profile_step_pct == 0.0) {
+                    cfg.profile_step_pct = 1.0;
+                }
+                break;
+            case 'I':
+                prom_interval = parse_duration(optarg);
+                if (prom_interval <= 0.0) {
+                    fprintf(stderr, "Error: Invalid interval '%s'.\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'e':
+                if (strcmp(optarg, "help") == 0) {
+                    fillfs_list_engines(stdout);
+                    return 0;
+                }
+                cfg.engine = optarg;
+                break;
+            case 'q':
+            case 't':
+            case 'S': {
+                char *end = NULL;
+                unsigned long v = strtoul(optarg, &end, 10);
+                if (*end != '\0' || v == 0 || v > 4096) {
+                    fprintf(stderr, "Error: Invalid %s '%s'.\n",
+                            (c == 'q') ? "I/O depth" : (c == 't') ? "thread count" : "trace sample",
+                            optarg);
+                    return 1;
+                }
+                if (c == 'q') {
+                    cfg.iodepth = (unsigned)v;
+                } else if (c == 't') {
+                    cfg.threads = (unsigned)v;
+                } else {
+                    cfg.trace_sample = (unsigned)v;
+                }
+                break;
+            }
             case 'h':
                 show_help(argv[0]);
                 return 0;
@@ -406,6 +805,46 @@ int main(int argc, char *argv[]) {
         }
     }
 
+    // Before any other thread starts, so that all of them leave signals to it
+    if (control_signals_start(shutdown_timeout, job_file ? jobfile_stop : NULL) != 0) {
+        return 1;
+    }
+    if (prom_path && prom_exporter_start(prom_path, prom_interval) != 0) {
+        return 1;
+    }
+    if (control_path) {
+        // Leave room to add writers at run time
+        cfg.max_threads = CONTROL_MAX_THREADS;
+        if (control_start(control_path) != 0) {
+            prom_exporter_stop();
+            return 1;
+        }
+    }
+
+    if (job_file) {
+        // The job file's [global] section overrides the command line
+        phase_report_t rep;
+        memset(&rep, 0, sizeof(rep));
+        rep.json = show_json;
+        cpu_times(&rep.cpu_user_s, &rep.cpu_sys_s);
+
+        cfg.target     = (optind < argc) ? argv[optind] : NULL;
+        cfg.block_size = block_size ? block_size : parse_size("32M");
+        cfg.data_mode  = (use_random && !use_zero) ? "random" : "zero";
+        int rc = jobfile_run(job_file, &cfg, report_phase, &rep);
+        control_stop();
+        prom_exporter_stop();
+
+        uint64_t stop_ns = 0;
+        int sig = control_stop_signal(&stop_ns);
+        if (sig) {
+            fprintf(stderr, "Stopped by signal %d; shutdown took %.1f ms.\n",
+                    sig, (double)(now_ns() - stop_ns) / 1e6);
+            rc = 1;
+        }
+        return rc;
+    }
+
     if (optind >= argc) {
         fprintf(stderr, "Error: Missing <mount_point_or_file> argument.\n");
         show_help(argv[0]);
@@ -424,93 +863,45 @@ int main(int argc, char *argv[]) {
         block_size = parse_size("32M");
     }
 
-    /*
-     * Detect if 'path_arg' is a directory or a file.
-     * We'll use stat. If S_ISDIR -> directory, if S_ISREG -> file, etc.
-     */
-    struct stat st;
-    memset(&st, 0, sizeof(st));
-    if (stat(path_arg, &st) == -1) {
-        perror("stat");
-        return 1;
+    // Overwrite passes: a persistent job runs one phase per loop
+    if (loop.max > 1 || loop.duration_s > 0.0) {
+        struct stat st;
+        if (stat(path_arg, &st) == 0 && S_ISDIR(st.st_mode)) {
+            fprintf(stderr, "Error: --loops and --duration need an existing file or block device.\n");
+            return 1;
+        }
+        loop.active    = 1;
+        cfg.persistent = 1;
+        cpu_times(&loop.cpu_user_s, &loop.cpu_sys_s);
     }
 
-    int is_directory = S_ISDIR(st.st_mode);
-    int is_reg_file  = S_ISREG(st.st_mode);
+    cfg.target     = path_arg;
+    cfg.size       = (file_size == SIZE_MAX) ? FILLFS_SIZE_AUTO : (uint64_t)file_size;
+    cfg.block_size = block_size;
+    cfg.data_mode  = (use_random && !use_zero) ? "random" : "zero"; // zero overrides random
 
     /*
-     * We'll prepare our fill_thread_args_t accordingly:
-     *   - If it's a directory, we generate the hidden file path, and we fill until file_size or disk full.
-     *   - If it's an existing file, we do NOT remove it on exit, and we only write up to the user-specified size
-     *     or the file's own size if user didn't specify or specified something bigger than the file.
+     * The library works out whether 'path_arg' is a directory (fill a hidden
+     * file until file_size or disk full) or an existing file (overwrite up to
+     * file_size or the file's own size, never removing it).
      */
-    fill_thread_args_t args;
-    memset(&args, 0, sizeof(args));
-
-    args.use_random       = use_random;
-    args.use_zero         = use_zero;
-    args.block_size       = block_size;
-    args.total_written    = 0;
-    args.done             = 0;
-    args.error            = 0;
-
-    if (is_directory) {
-        // For directory scenario:
-        generate_file_path(g_hidden_filename, path_arg);
-
-        // If file_size == SIZE_MAX, try to get free space from the directory
-        if (file_size == SIZE_MAX) {
-            struct statvfs fs_info;
-            if (statvfs(path_arg, &fs_info) == 0) {
-                known_free_space = (size_t)fs_info.f_bavail * fs_info.f_bsize;
-            }
-        }
-
-        args.filename         = g_hidden_filename;
-        args.file_size        = file_size;  // Could be SIZE_MAX
-        args.known_free_space = known_free_space;
-        args.existing_file    = 0; // We'll remove it on exit
-    }
-    else if (is_reg_file) {
-        /*
-         * We have an existing file. We do not remove it upon exit.
-         * If user gave a size == SIZE_MAX => overwrite the entire file.
-         * Otherwise, if user gave a smaller size, only overwrite that portion.
-         * If user gave a bigger size than the file, we only overwrite the file's size
-         * (since we won't expand the file in this scenario).
-         */
-        size_t file_actual_size = (size_t)st.st_size;
-        size_t final_size = 0;
-
-        if (file_size == SIZE_MAX) {
-            // Overwrite the entire existing file
-            final_size = file_actual_size;
-        } else {
-            // Overwrite up to min(file_size, file_actual_size)
-            final_size = (file_size < file_actual_size) ? file_size : file_actual_size;
-        }
-
-        args.filename         = path_arg;
-        args.file_size        = final_size;
-        args.known_free_space = 0; // Not used for file scenario
-        args.existing_file    = 1; // We won't remove it on exit
+    fillfs_job_t *job = NULL;
+    if (fillfs_job_create(&cfg, &job) != 0) {
+        return 1;  // The library has already explained why
     }
-    else {
-        fprintf(stderr, "Error: '%s' is neither a directory nor a regular file.\n", path_arg);
-        return 1;
+
+    if (fillfs_job_is_temporary(job)) {
+        snprintf(g_hidden_filename, sizeof(g_hidden_filename), "%s", fillfs_job_fill_path(job));
     }
 
-    // Create background writer thread
-    pthread_t writer_thread;
-    if (pthread_create(&writer_thread, NULL, fill_file_thread, &args) != 0) {
-        perror("pthread_create");
-        // If we fail to create the thread, clean up if we created a hidden file:
-        if (is_directory) {
-            clean_exit(EXIT_FAILURE);
-        } else {
-            return 1;
-        }
+    // Start the background writer threads
+    if (fillfs_job_start(job) != 0) {
+        fillfs_job_wait(job, NULL);
+        fillfs_job_destroy(job);
+        clean_exit(EXIT_FAILURE);
     }
+    prom_exporter_set_source(job, path_arg, NULL);
+    control_set_source(job, path_arg);
 
     // If showing status, do it in the foreground
     struct timespec start_time, current_time;
@@ -519,21 +910,48 @@ int main(int argc, char *argv[]) {
     double filtered_throughput_mb_s = 0.0;
     const double alpha = 0.2;
     double last_print_time = 0.0;
+    fillfs_progress_t progress;
+
+    fillfs_job_progress(job, &progress);
+    while (progress.state != FILLFS_STATE_DONE && !control_stop_signal(NULL)) {
+        clock_gettime(CLOCK_MONOTONIC, &current_time);
+        double elapsed_sec = (current_time.tv_sec - start_time.tv_sec) +
+                             (current_time.tv_nsec - start_time.tv_nsec) / 1e9;
+
+        if (loop.active) {
+            // Out of time: cut the current loop short; it is reported as partial
+            if (loop.duration_s > 0.0 && !loop.timed_out && elapsed_sec >= loop.duration_s) {
+                loop.timed_out = 1;
+                fillfs_job_cancel(job);
+            }
+            if (progress.state == FILLFS_STATE_IDLE) {
+                if (!next_loop(job, &loop, cfg.size, show_json, show_status)) {
+                    break;
+                }
+                fillfs_job_progress(job, &progress);
+                continue;
+            }
+        }
 
-    while (!args.done) {
         if (show_status) {
             // Print status ~ once per second
-            clock_gettime(CLOCK_MONOTONIC, &current_time);
-            double elapsed_sec = (current_time.tv_sec - start_time.tv_sec) +
-                                 (current_time.tv_nsec - start_time.tv_nsec) / 1e9;
 
-            if (elapsed_sec - last_print_time >= 1.0) {
+            if (elapsed_sec - last_print_time >= 1.0 && progress.state == FILLFS_STATE_PAUSED) {
+                last_print_time = elapsed_sec;
+                fprintf(stdout,
+                        "\rPaused for %.0f s | Written: %.2f MB | resume with SIGUSR2 or the control socket ",
+                        progress.paused_s, progress.bytes_written / (1024.0 * 1024.0));
+                fflush(stdout);
+            } else if (elapsed_sec - last_print_time >= 1.0) {
                 last_print_time = elapsed_sec;
 
-                size_t tw = args.total_written;
-                double written_mb = tw / (1024.0 * 1024.0);
+                // In loop mode the percentage and ETA are those of the current loop
+                uint64_t tw = progress.bytes_written - loop.base;
+                double written_mb = progress.bytes_written / (1024.0 * 1024.0);
 
-                double instantaneous_throughput = (written_mb / elapsed_sec);
+                // Time spent paused doesn't count against the throughput
+                double active_sec = elapsed_sec - progress.paused_s;
+                double instantaneous_throughput = (active_sec > 0.0) ? (written_mb / active_sec) : 0.0;
                 if (filtered_throughput_mb_s < 1e-9) {
                     filtered_throughput_mb_s = instantaneous_throughput;
                 } else {
@@ -544,106 +962,155 @@ int main(int argc, char *argv[]) {
 
                 double tput = filtered_throughput_mb_s;
 
-                if (is_directory && args.file_size == SIZE_MAX) {
-                    // Possibly indefinite or limited by known_free_space
-                    double progress_percent = 0.0;
-                    if (args.known_free_space > 0) {
-                        progress_percent =
-                            (100.0 * (double)tw) / (double)args.known_free_space;
-                        if (progress_percent > 100.0) {
-                            progress_percent = 100.0;
-                        }
+                // target_bytes is the requested/file size, or the free space when filling until full
+                double progress_percent = 0.0;
+                if (progress.target_bytes > 0) {
+                    progress_percent =
+                        (100.0 * (double)tw) / (double)progress.target_bytes;
+                    if (progress_percent > 100.0) {
+                        progress_percent = 100.0;
                     }
-                    double remaining_bytes = 0.0;
-                    if (args.known_free_space > tw) {
-                        remaining_bytes = (double)args.known_free_space - (double)tw;
-                    }
-                    double est_time_sec = (tput > 0.0)
-                        ? (remaining_bytes / (1024.0 * 1024.0)) / tput
-                        : 0.0;
-
-                    int total_seconds = (int)(est_time_sec + 0.5);
-                    int eta_h = total_seconds / 3600;
-                    int remainder = total_seconds % 3600;
-                    int eta_m = remainder / 60;
-                    int eta_s = remainder % 60;
-
-                    fprintf(stdout,
-                            "\rProgress: %.2f%% | Written: %.2f / %.2f MB | "
-                            "Throughput: %.2f MB/s | ETA: %02d:%02d:%02d ",
-                            progress_percent,
-                            written_mb,
-                            args.known_free_space / (1024.0 * 1024.0),
-                            tput,
-                            eta_h, eta_m, eta_s);
                 }
-                else {
-                    // We have a definite size to fill
-                    double progress_percent = 0.0;
-                    if (args.file_size > 0) {
-                        progress_percent =
-                            (100.0 * (double)tw) / (double)args.file_size;
-                        if (progress_percent > 100.0) {
-                            progress_percent = 100.0;
-                        }
-                    }
-                    double remaining_bytes =
-                        (double)args.file_size - (double)tw;
-                    double est_time_sec = (tput > 0.0)
-                        ? (remaining_bytes / (1024.0 * 1024.0)) / tput
-                        : 0.0;
-
-                    int total_seconds = (int)(est_time_sec + 0.5);
-                    int eta_h = total_seconds / 3600;
-                    int remainder = total_seconds % 3600;
-                    int eta_m = remainder / 60;
-                    int eta_s = remainder % 60;
-
-                    fprintf(stdout,
-                            "\rProgress: %.2f%% | Written: %.2f / %.2f MB | "
-                            "Throughput: %.2f MB/s | ETA: %02d:%02d:%02d ",
-                            progress_percent,
-                            written_mb,
-                            (double)args.file_size / (1024.0 * 1024.0),
-                            tput,
-                            eta_h, eta_m, eta_s);
+                double remaining_bytes = 0.0;
+                if (progress.target_bytes > tw) {
+                    remaining_bytes = (double)progress.target_bytes - (double)tw;
+                }
+                double est_time_sec = (tput > 0.0)
+                    ? (remaining_bytes / (1024.0 * 1024.0)) / tput
+                    : 0.0;
+
+                int total_seconds = (int)(est_time_sec + 0.5);
+                int eta_h = total_seconds / 3600;
+                int remainder = total_seconds % 3600;
+                int eta_m = remainder / 60;
+                int eta_s = remainder % 60;
+
+                if (loop.active) {
+                    fprintf(stdout, "\rLoop %u | ", loop.done + 1);
+                } else {
+                    fputc('\r', stdout);
+                }
+                fprintf(stdout,
+                        "Progress: %.2f%% | Written: %.2f / %.2f MB | "
+                        "Throughput: %.2f MB/s | ETA: %02d:%02d:%02d ",
+                        progress_percent,
+                        tw / (1024.0 * 1024.0),
+                        (double)progress.target_bytes / (1024.0 * 1024.0),
+                        tput,
+                        eta_h, eta_m, eta_s);
+                if (progress.stall_s > 0.0) {
+                    fprintf(stdout, "| STALLED %.0f s ", progress.stall_s);
                 }
                 fflush(stdout);
             }
         }
 
-        // Sleep a bit to avoid busy waiting
-        usleep(200000); // 200 ms
+        // Sleep a bit to avoid busy waiting (200 ms), but notice a stop signal quickly
+        for (int i = 0; i < 10 && !control_stop_signal(NULL); ++i) {
+            usleep(20000);
+        }
+        fillfs_job_progress(job, &progress);
     }
 
-    // Wait for the writer thread to join
-    pthread_join(writer_thread, NULL);
+    // Wait for the writer threads to join and collect their statistics
+    fillfs_stats_t stats;
+    int rc = fillfs_job_wait(job, &stats);
+    uint64_t drained_ns = now_ns();
+    fillfs_tput_phase_t phases[MAX_TPUT_PHASES];
+    unsigned n_phases = fillfs_job_tput_phases(job, phases, MAX_TPUT_PHASES);
+
+    // Running out of --duration is how a timed run ends, not an interruption
+    if (loop.timed_out && !control_stop_signal(NULL)) {
+        stats.cancelled = 0;
+    }
 
     // If we were showing status, print final summary
     if (show_status) {
-        fprintf(stdout, "\rProgress: 100.00%% (finalizing)\n");
+        if (stats.cancelled) {
+            fprintf(stdout, "\nFill/Overwrite interrupted (partial results).\n");
+        } else {
+            fprintf(stdout, "\rProgress: 100.00%% (finalizing)\n");
+        }
 
         clock_gettime(CLOCK_MONOTONIC, &current_time);
         double total_elapsed = (current_time.tv_sec - start_time.tv_sec) +
                               (current_time.tv_nsec - start_time.tv_nsec) / 1e9;
-        double total_mb = (double)args.total_written / (1024.0 * 1024.0);
+        double total_mb = (double)stats.bytes_written / (1024.0 * 1024.0);
 
-        double final_throughput = (total_elapsed > 0.0)
-                                  ? (total_mb / total_elapsed)
+        // Time spent paused doesn't count against the throughput
+        double active_elapsed = total_elapsed - stats.paused_s;
+        double final_throughput = (active_elapsed > 0.0)
+                                  ? (total_mb / active_elapsed)
                                   : 0.0;
 
+        if (!stats.cancelled) {
+            fprintf(stdout, "Fill/Overwrite complete.\n");
+        }
         fprintf(stdout,
-                "Fill/Overwrite complete.\n"
                 "Wrote: %.2f MB in %.2f seconds (avg throughput: %.2f MB/s)\n",
                 total_mb, total_elapsed, final_throughput);
+        if (stats.paused_s > 0.0) {
+            fprintf(stdout, "Paused: %.2f seconds\n", stats.paused_s);
+        }
+        if (stats.stalls > 0) {
+            fprintf(stdout, "Stalls: %u (%.1f seconds in total)\n", stats.stalls, stats.stall_s);
+        }
+        if (stats.reads || stats.read_errors) {
+            fprintf(stdout, "Reads: %llu (%.0f/s, %llu failed) | latency p50 %.0f us, p90 %.0f us, "
+                            "p99 %.0f us, max %.0f us\n",
+                    (unsigned long long)stats.reads,
+                    (total_elapsed > 0.0) ? (double)stats.reads / total_elapsed : 0.0,
+                    (unsigned long long)stats.read_errors,
+                    stats.read_lat_p50_us, stats.read_lat_p90_us,
+                    stats.read_lat_p99_us, stats.read_lat_max_us);
+        }
+        print_cpu_summary(stdout, &stats);
+        if (n_phases > 0) {
+            print_tput_phases(stdout, phases, n_phases);
+        }
+    }
+
+    if (loop.active && !show_json) {
+        if (loop.steady_at) {
+            fprintf(stdout, "Steady state reached at loop %u (%d-loop window: range <= 20%%, "
+                            "slope <= 10%% of the mean throughput).\n", loop.steady_at, STEADY_WINDOW);
+        } else {
+            fprintf(stdout, "Steady state not reached in %u complete loop(s).\n", loop.n_tput);
+        }
+    }
+    free(loop.tput);
+
+    if (cfg.profile_step_pct > 0.0 && report_fill_profile(job, profile_csv) != 0) {
+        rc = 1;
+    }
+
+    if (show_json) {
+        print_json_summary(stdout, path_arg, &stats, phases, n_phases);
+    }
+
+    // Removes the hidden file in directory mode; an existing file is left alone
+    control_set_source(NULL, NULL);
+    control_stop();
+    prom_exporter_set_source(NULL, NULL, NULL);
+    prom_exporter_stop();
+    fillfs_job_destroy(job);
+
+    // Interrupted: report how long the writers took to drain and the cleanup took
+    uint64_t stop_ns = 0;
+    int sig = control_stop_signal(&stop_ns);
+    if (sig) {
+        uint64_t done_ns = now_ns();
+        fprintf(stderr, "Stopped by signal %d; shutdown took %.1f ms "
+                        "(writers drained in %.1f ms, cleanup %.1f ms).\n",
+                sig, (double)(done_ns - stop_ns) / 1e6,
+                (double)(drained_ns - stop_ns) / 1e6, (double)(done_ns - drained_ns) / 1e6);
+        rc = 1;
     }
 
-    // If the writer thread reported an error, exit with failure
-    if (args.error) {
+    // If a writer thread reported an error, exit with failure
+    if (rc != 0) {
         clean_exit(EXIT_FAILURE);
     } else {
-        // Otherwise success. If it's a directory, hidden file is unlinked in clean_exit().
-        // If it's a file, we skip the unlink.
         clean_exit(EXIT_SUCCESS);
     }
 
@@ -0,0 +1,387 @@
+/*
+ * fillfs.h
+ *
+ * Copyright (c) 2025 Robert Heffernan
+ *
+ * Author: Robert Heffernan <robert@heffernantech.au>
+ *
+ * This file is part of the fillfs utility. It is licensed under the MIT License:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify,
+ * merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * libfillfs: embeddable API for filling a filesystem or overwriting a file.
+ *
+ * Typical use:
+ *
+ *     fillfs_config_t cfg;
+ *     fillfs_job_t *job;
+ *     fillfs_stats_t stats;
+ *
+ *     fillfs_config_init(&cfg);
+ *     cfg.target = "/mnt/data";
+ *     cfg.size   = 1ULL << 30;
+ *     if (fillfs_job_create(&cfg, &job) == 0) {
+ *         fillfs_job_start(job);
+ *         ...poll fillfs_job_progress() or subscribe with fillfs_job_subscribe()...
+ *         fillfs_job_wait(job, &stats);
+ *         fillfs_job_destroy(job);
+ *     }
+ *
+ * Functions returning int return 0 on success or a negative errno value.
+ * Diagnostics are also printed to stderr, as the fillfs tool does.
+ */
+
+#ifndef FILLFS_H
+#define FILLFS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__GNUC__) && defined(FILLFS_BUILDING_LIBRARY)
+#define FILLFS_API __attribute__((visibility("default")))
+#else
+#define FILLFS_API
+#endif
+
+/** Size value meaning "until the disk is full" (directory) or "the whole file". */
+#define FILLFS_SIZE_AUTO UINT64_MAX
+
+typedef struct fillfs_job fillfs_job_t;
+
+/**
+ * @brief Job configuration. Initialise with fillfs_config_init() and then
+ *        override individual fields.
+ */
+typedef struct {
+    const char *target;         ///< Directory (fills <target>/.fillfs), existing file or block device
+    uint64_t    size;           ///< Bytes to write, or FILLFS_SIZE_AUTO
+    size_t      block_size;     ///< Bytes per write (default 32M)
+    const char *data_mode;      ///< "zero" (default) or "random"
+    const char *engine;         ///< I/O engine name (default "sync")
+    unsigned    iodepth;        ///< Writes in flight per thread (0 = engine default)
+    unsigned    threads;        ///< Writer threads (default 1)
+    const char *fault_spec;     ///< Fault schedule for the fake engine, or NULL
+    int         low_priority;   ///< Run writers at nice 19 / idle I/O class (default 1)
+    int         keep_file;      ///< Keep the directory-mode fill file on destroy (default 0)
+    uint64_t    rate_limit;     ///< Aggregate write rate in bytes/s (0 = unlimited)
+    uint64_t    seed;           ///< Data generator seed (0 = derive from the clock)
+    int         persistent;     ///< Keep writers alive between phases, see fillfs_job_continue()
+    int         hw_counters;    ///< Count cycles, instructions and cache misses per writer (perf_event_open)
+    const char *trace_path;     ///< Write a Chrome trace JSON here on destroy, or NULL
+    unsigned    trace_sample;   ///< Trace one write in this many individually (0 = 16)
+    unsigned    max_threads;    ///< Upper bound for fillfs_job_set_threads() (0 = threads)
+    int         link_fill_file; ///< Give an anonymous (O_TMPFILE) fill file a name in the directory
+    unsigned    stall_ms;       ///< Report a writer whose oldest write has been in flight this long (0 = off)
+    int         stall_dump;     ///< With a stall report, dump kernel stacks and device in-flight counts
+    double      profile_step_pct; ///< Fill-level profile bucket width in percent of capacity (0 = off)
+    int         random_order;   ///< Write the blocks of a sized range in a pseudo-random order, new every phase
+    const char *read_path;      ///< Time reads of this existing file while the job runs, or NULL
+    size_t      read_size;      ///< Bytes per background read (0 = 4K)
+    unsigned    read_iops;      ///< Background reads per second (0 = back to back)
+    int         read_seq;       ///< Read the file in order instead of at random offsets
+} fillfs_config_t;
+
+/**
+ * @brief Job life cycle.
+ */
+typedef enum {
+    FILLFS_STATE_CREATED = 0,   ///< Configured, not started
+    FILLFS_STATE_RUNNING,       ///< Writers active
+    FILLFS_STATE_DONE,          ///< All writers finished (complete, full, cancelled or failed)
+    FILLFS_STATE_IDLE,          ///< Persistent job: phase finished, writers parked
+    FILLFS_STATE_PAUSED         ///< fillfs_job_pause(): writes in flight drained, none queued
+} fillfs_state_t;
+
+/**
+ * @brief A point-in-time view of a running job.
+ */
+typedef struct {
+    fillfs_state_t state;
+    uint64_t bytes_written;     ///< Bytes written so far
+    uint64_t target_bytes;      ///< Bytes expected in total (size, file size or free space), 0 if unknown
+    double   elapsed_s;         ///< Seconds since the job started
+    int      error;             ///< Non-zero once a writer has failed
+    int      disk_full;         ///< A writer has seen ENOSPC
+    uint64_t rate_limit;        ///< Current aggregate rate limit in bytes/s, 0 = unlimited
+    unsigned threads;           ///< Writer threads currently allowed to write
+    double   paused_s;          ///< Time spent paused so far, see fillfs_job_pause()
+    double   stall_s;           ///< Age of the oldest write of a stalled writer, 0 if none is stalled
+} fillfs_progress_t;
+
+/**
+ * @brief Final statistics of a finished job.
+ */
+typedef struct {
+    const char *engine;         ///< Engine actually used
+    const char *data_mode;      ///< Data mode actually used
+    unsigned    threads;
+    unsigned    iodepth;
+    size_t      block_size;
+    uint64_t    bytes_written;
+    uint64_t    writes;         ///< Completed write requests
+    double      elapsed_s;      ///< First writer start to last writer end (incl. fsync and pauses)
+    double      throughput_mb_s; ///< Over elapsed_s minus paused_s
+    double      paused_s;       ///< Time spent paused with fillfs_job_pause()
+    double      lat_mean_us;    ///< Submit-to-completion write latency
+    double      lat_p50_us;
+    double      lat_p90_us;
+    double      lat_p99_us;
+    double      lat_max_us;
+    int         disk_full;      ///< Stopped because the filesystem reported ENOSPC
+    int         cancelled;      ///< Stopped by fillfs_job_cancel()
+    int         error;          ///< Non-zero if a writer failed
+    uint64_t    file_extent;    ///< Highest offset written so far (size of the fill data)
+    unsigned    stalls;         ///< Writer stalls reported by the watchdog (whole job so far)
+    double      stall_s;        ///< Total duration of those stalls
+
+    /* Background reader (read_path), whole job so far */
+    uint64_t    reads;          ///< Completed reads
+    uint64_t    read_bytes;
+    uint64_t    read_errors;    ///< Failed reads
+    double      read_lat_mean_us;
+    double      read_lat_p50_us;
+    double      read_lat_p90_us;
+    double      read_lat_p99_us;
+    double      read_lat_max_us;
+
+    /* CPU cost of the writer threads (and of generating the data buffer) */
+    double      cpu_user_s;
+    double      cpu_sys_s;
+    double      cpu_s_per_gb;   ///< User + system seconds per 10^9 bytes written
+    uint64_t    syscalls;       ///< I/O system calls (writes, io_uring_enter, fsync)
+    double      syscalls_per_gb;
+    uint64_t    ctx_voluntary;  ///< Context switches while blocked
+    uint64_t    ctx_involuntary; ///< Context switches by preemption
+    int         hw_counters;    ///< 1 if the hardware counters below were measured
+    uint64_t    cycles;
+    uint64_t    instructions;
+    uint64_t    cache_misses;
+    double      ipc;            ///< Instructions per cycle
+} fillfs_stats_t;
+
+/**
+ * @brief A stretch of the run with steady throughput, see fillfs_job_tput_phases().
+ */
+typedef struct {
+    uint64_t start_bytes;       ///< Bytes written when the phase began
+    uint64_t end_bytes;         ///< Bytes written when it ended
+    double   start_s;           ///< Seconds since the job started
+    double   duration_s;        ///< Time spent writing (paused and parked time left out)
+    double   throughput_mb_s;   ///< Mean throughput over the phase
+} fillfs_tput_phase_t;
+
+/**
+ * @brief Throughput and write latency over a range of filesystem fill levels,
+ *        see fillfs_job_fill_profile().
+ */
+typedef struct {
+    double   from_pct;          ///< Fill level (percent of the statvfs total in use) at the start
+    double   to_pct;            ///< Fill level at the end
+    uint64_t bytes;             ///< Bytes written in the range
+    uint64_t writes;            ///< Writes completed in the range
+    double   duration_s;        ///< Time spent in the range (paused time left out)
+    double   throughput_mb_s;
+    double   lat_mean_us;
+    double   lat_p50_us;
+    double   lat_p90_us;
+    double   lat_p99_us;
+    double   lat_max_us;        ///< Slowest histogram bucket (about 12% resolution)
+} fillfs_level_stats_t;
+
+/**
+ * @brief Progress callback, see fillfs_job_subscribe(). Runs on a library thread.
+ */
+typedef void (*fillfs_progress_cb)(const fillfs_progress_t *progress, void *user);
+
+/** Fill CFG with defaults. */
+FILLFS_API void fillfs_config_init(fillfs_config_t *cfg);
+
+/**
+ * @brief Validate CFG and prepare a job. Inspects the target (stat/statvfs)
+ *        but does not open or write anything yet.
+ */
+FILLFS_API int fillfs_job_create(const fillfs_config_t *cfg, fillfs_job_t **job);
+
+/**
+ * @brief Call CB every INTERVAL_MS while the job runs, and once more when it
+ *        finishes. Must be called before fillfs_job_start().
+ */
+FILLFS_API int fillfs_job_subscribe(fillfs_job_t *job, unsigned interval_ms,
+                                    fillfs_progress_cb cb, void *user);
+
+/** Start the writer threads and return immediately. */
+FILLFS_API int fillfs_job_start(fillfs_job_t *job);
+
+/** Take a progress snapshot (cheap; safe from any thread). */
+FILLFS_API void fillfs_job_progress(const fillfs_job_t *job, fillfs_progress_t *progress);
+
+/** Ask the writers to stop. In-flight writes complete; returns immediately. */
+FILLFS_API void fillfs_job_cancel(fillfs_job_t *job);
+
+/**
+ * @brief Wait for the job to finish and fetch its statistics (STATS may be NULL).
+ *
+ * @return int 0 if the job completed (or filled the disk / was cancelled), -EIO if a writer failed.
+ */
+FILLFS_API int fillfs_job_wait(fillfs_job_t *job, fillfs_stats_t *stats);
+
+/**
+ * @brief Live write latency distribution, for exporters (safe from any thread).
+ *
+ * @param bounds_us Ascending bucket upper bounds in microseconds.
+ * @param n         Number of bounds.
+ * @param counts    Out: writes with latency <= bounds_us[i] (cumulative; resolved
+ *                  to the internal histogram, about 12% wide per bucket).
+ * @param count     Out: all writes so far, from the same snapshot as COUNTS (so
+ *                  never below any of them).
+ * @param sum_us    Out: sum of all write latencies.
+ */
+FILLFS_API void fillfs_job_latency(fillfs_job_t *job, const double *bounds_us, unsigned n,
+                                   uint64_t *counts, uint64_t *count, double *sum_us);
+
+/**
+ * @brief Split the run into throughput phases, e.g. a device's fast write cache
+ *        and the slower steady state after it is exhausted.
+ *
+ * Throughput is sampled every second while writing; change-point detection
+ * on the samples starts a new phase where the mean throughput shifts by 10%
+ * or more and stays there for a few seconds. Safe from any thread; most
+ * useful after fillfs_job_wait().
+ *
+ * @param phases Out: up to MAX phases in time order.
+ * @return unsigned Number of phases (0 if the job has not written for a full second).
+ */
+FILLFS_API unsigned fillfs_job_tput_phases(fillfs_job_t *job, fillfs_tput_phase_t *phases, unsigned max);
+
+/**
+ * @brief Fill-level profile of a job created with profile_step_pct set: one
+ *        entry per profile_step_pct of filesystem capacity crossed.
+ *
+ * The fill level is read with statvfs() ten times a second, so an entry
+ * starts and ends within 100 ms of writing of the step boundary. A range
+ * crossed faster than that is merged into one entry. The last entry is
+ * added by fillfs_job_wait().
+ *
+ * @param levels Out: up to MAX entries in fill order (may be NULL if MAX is 0).
+ * @return unsigned Number of entries available, which may exceed MAX.
+ */
+FILLFS_API unsigned fillfs_job_fill_profile(fillfs_job_t *job, fillfs_level_stats_t *levels, unsigned max);
+
+/**
+ * @brief Change the rate limit of a running job (bytes/s, 0 = unlimited).
+ */
+FILLFS_API void fillfs_job_set_rate(fillfs_job_t *job, uint64_t bytes_per_s);
+
+/**
+ * @brief Pause a running job: writers finish the writes in flight and queue
+ *        no more until fillfs_job_resume(). The open file and progress are kept,
+ *        and the time paused is reported separately (paused_s) so it does not
+ *        count against throughput.
+ *
+ * Returns at once. The state becomes FILLFS_STATE_PAUSED, and paused time
+ * starts to count, only once the writes in flight have completed.
+ */
+FILLFS_API void fillfs_job_pause(fillfs_job_t *job);
+
+/**
+ * @brief Resume a job paused with fillfs_job_pause().
+ */
+FILLFS_API void fillfs_job_resume(fillfs_job_t *job);
+
+/**
+ * @brief Change the number of writer threads of a running job.
+ *
+ * New writers are started as needed, up to the config's max_threads; surplus
+ * writers drain their writes and wait (they are not stopped, so raising the
+ * count again is cheap).
+ *
+ * @return int 0 on success, -EINVAL if THREADS is out of range or the job is finishing,
+ *             -ENOMEM if a new writer's trace buffer cannot be allocated.
+ */
+FILLFS_API int fillfs_job_set_threads(fillfs_job_t *job, unsigned threads);
+
+/**
+ * @brief Persistent jobs: wait until the current phase is finished and fetch
+ *        the statistics of that phase alone. The writers stay parked, with
+ *        their buffer and open file, until fillfs_job_continue().
+ */
+FILLFS_API int fillfs_job_wait_phase(fillfs_job_t *job, fillfs_stats_t *stats);
+
+/**
+ * @brief Persistent jobs: start a new phase that writes from START to END
+ *        (FILLFS_SIZE_AUTO = until the disk is full). Clears a previous
+ *        disk-full or cancel condition. START is rounded down to a block
+ *        boundary, rewriting a partial last block, so that every block of the
+ *        file holds the whole buffer and fillfs_job_verify() can check it.
+ */
+FILLFS_API int fillfs_job_continue(fillfs_job_t *job, uint64_t start, uint64_t end);
+
+/**
+ * @brief Truncate the fill file to SIZE between phases (directory mode only).
+ */
+FILLFS_API int fillfs_job_truncate(fillfs_job_t *job, uint64_t size);
+
+/**
+ * @brief Read back the first SIZE bytes of the fill file (FILLFS_SIZE_AUTO =
+ *        everything written) and compare them with the generated data.
+ *        Must not be called while a phase is running.
+ *
+ * @return int 0 if the data matches, -EILSEQ on a mismatch (count in
+ *         *MISMATCHED, which may be NULL) or another negative errno.
+ */
+FILLFS_API int fillfs_job_verify(fillfs_job_t *job, uint64_t size, uint64_t *mismatched);
+
+/**
+ * @brief Release the job. In directory mode the fill file is removed unless
+ *        keep_file was set. The job must not be running.
+ */
+FILLFS_API void fillfs_job_destroy(fillfs_job_t *job);
+
+/**
+ * Path of the file being written. In directory mode the fill file is created
+ * anonymously with O_TMPFILE where the filesystem supports it, so its space
+ * is released even if the process is killed; its path is then
+ * /proc/self/fd/N unless link_fill_file was set.
+ */
+FILLFS_API const char *fillfs_job_fill_path(const fillfs_job_t *job);
+
+/**
+ * 1 if the job writes a fill file with a name in a directory, which the caller
+ * should remove if the process exits abnormally; 0 for an existing file or an
+ * anonymous fill file.
+ */
+FILLFS_API int fillfs_job_is_temporary(const fillfs_job_t *job);
+
+/** Print the available I/O engines to OUT. */
+FILLFS_API void fillfs_list_engines(FILE *out);
+
+/** Print the CPU features found at run time and the data kernels selected for them to OUT. */
+FILLFS_API void fillfs_show_cpu_features(FILE *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FILLFS_H */
@@ -0,0 +1,817 @@
+/*
+ * jobfile.c
+ *
+ * Copyright (c) 2025 Robert Heffernan
+ *
+ * Author: Robert Heffernan <robert@heffernantech.au>
+ *
+ * This file is part of the fillfs utility. It is licensed under the MIT License:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify,
+ * merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Job file runner. A job file is an INI file: a [global] section with the
+ * fill settings, followed by one section per phase, run in file order:
+ *
+ *     [global]
+ *     target=/mnt/data
+ *     engine=uring
+ *     data=random
+ *     rate=200M
+ *
+ *     [age]                   ; action defaults to the section name
+ *     files=10000
+ *     file-size=64K
+ *     delete=50%
+ *
+ *     [fill-95]
+ *     action=fill
+ *     fill-to=95%
+ *
+ *     [hold]
+ *     duration=10m
+ *
+ *     [free]
+ *     free=5%
+ *
+ *     [verify]
+ *
+ * Every target gets one persistent libfillfs job, so writer threads, their
+ * buffer and the open fill file carry over from one phase to the next.
+ */
+
+#define _GNU_SOURCE
+#define _POSIX_C_SOURCE 200809L
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+
+#include "jobfile.h"
+#include "datagen.h"
+#include "control.h"
+#include "promfile.h"
+#include "util.h"
+
+#define JOB_MAX_PHASES  64
+#define JOB_MAX_TARGETS 8
+#define JOB_LINE_MAX    1024
+#define AGE_DIR_NAME    "/.fillfs-age"
+#define AGE_CHUNK       (1024U * 1024U)
+
+typedef enum {
+    ACT_AGE = 0,
+    ACT_FILL,
+    ACT_HOLD,
+    ACT_FREE,
+    ACT_VERIFY,
+    ACT_COUNT
+} action_t;
+
+static const char *const action_names[ACT_COUNT] = { "age", "fill", "hold", "free", "verify" };
+
+typedef enum {
+    FILL_FULL = 0,  ///< Until the filesystem reports ENOSPC
+    FILL_TO_PCT,    ///< Until the filesystem is pct% used
+    FILL_SIZE,      ///< Until the fill file is amount bytes
+    FILL_ADD        ///< amount more bytes
+} fill_kind_t;
+
+/** Phase keys, as bits of the set recorded while parsing a section. */
+enum {
+    KEY_TARGET    = 1 << 0,
+    KEY_RATE      = 1 << 1,
+    KEY_FILL_TO   = 1 << 2,
+    KEY_SIZE      = 1 << 3,
+    KEY_ADD       = 1 << 4,
+    KEY_DURATION  = 1 << 5,
+    KEY_ACTION    = 1 << 6,
+    KEY_FREE      = 1 << 7,
+    KEY_FILES     = 1 << 8,
+    KEY_FILE_SIZE = 1 << 9,
+    KEY_DELETE    = 1 << 10
+};
+
+/** Keys in bit order. */
+static const char *const phase_keys[] = {
+    "target", "rate", "fill-to", "size", "add", "duration", "action", "free",
+    "files", "file-size", "delete"
+};
+
+#define KEY_COMMON (KEY_TARGET | KEY_RATE | KEY_ACTION)
+#define KEY_FILL_END (KEY_FILL_TO | KEY_SIZE | KEY_ADD)
+
+/**
+ * @brief One phase section of the job file.
+ */
+typedef struct {
+    char       *name;           ///< Section name
+    int         line;           ///< Line of the section header (for messages)
+    int         action;         ///< action_t, or -1 until known
+    char       *target;         ///< Overrides the global target, or NULL
+    int         has_rate;
+    uint64_t    rate;           ///< Rate limit for this phase (bytes/s)
+    int         fill_kind;      ///< fill_kind_t
+    double      pct;            ///< fill-to / free / delete percentage
+    int         is_pct;         ///< free: pct is set instead of amount
+    uint64_t    amount;         ///< size / add / free in bytes
+    double      duration_s;     ///< hold
+    uint64_t    files;          ///< age: number of files to create
+    uint64_t    file_size;      ///< age: size of each file
+} phase_t;
+
+/**
+ * @brief Runtime state of one target.
+ */
+typedef struct {
+    const char   *path;
+    int           is_dir;
+    fillfs_job_t *job;          ///< Created by the first fill phase
+    uint64_t      extent;       ///< Size of the fill data after the last phase
+    char          fill_path[1024]; ///< Temporary fill file to remove on exit, or ""
+    char          age_dir[1024];
+    unsigned      age_next;     ///< Next age file number (all below may exist)
+} target_t;
+
+static fillfs_config_t g_cfg;
+static phase_t  g_phases[JOB_MAX_PHASES];
+static unsigned g_n_phases;
+static target_t g_targets[JOB_MAX_TARGETS];
+static unsigned g_n_targets;
+static char    *g_strings[2 * JOB_MAX_PHASES + 8]; ///< strdup'ed values, freed at the end
+static unsigned g_n_strings;
+static volatile int g_stop;     ///< jobfile_stop(): run no further phases
+
+/**
+ * @brief Keep a copy of a value string for the lifetime of the run.
+ */
+static char *keep_string(const char *s) {
+    if (g_n_strings == sizeof(g_strings) / sizeof(g_strings[0])) {
+        return NULL;
+    }
+    char *copy = strdup(s);
+    if (copy) {
+        g_strings[g_n_strings++] = copy;
+    }
+    return copy;
+}
+
+/**
+ * @brief Remove everything the run created on disk: age files and fill files.
+ *
+ * Also registered with atexit, so an interrupted scenario cleans up too.
+ */
+static void cleanup_targets(void) {
+    char path[1100];
+    for (unsigned t = 0; t < g_n_targets; ++t) {
+        target_t *tg = &g_targets[t];
+        if (tg->age_dir[0]) {
+            for (unsigned i = 0; i < tg->age_next; ++i) {
+                snprintf(path, sizeof(path), "%s/age-%08u", tg->age_dir, i);
+                unlink(path);
+            }
+            rmdir(tg->age_dir);
+            tg->age_dir[0] = '\0';
+        }
+        if (tg->fill_path[0]) {
+            unlink(tg->fill_path);
+            tg->fill_path[0] = '\0';
+        }
+    }
+}
+
+/**
+ * @brief Trim leading and trailing white space in place.
+ */
+static char *trim(char *s) {
+    while (isspace((unsigned char)*s)) {
+        ++s;
+    }
+    char *end = s + strlen(s);
+    while (end > s && isspace((unsigned char)end[-1])) {
+        *--end = '\0';
+    }
+    return s;
+}
+
+/**
+ * @brief Parse "N%" into N. Returns -1.0 if VALUE is not a percentage in 0..100.
+ */
+static double parse_percent(const char *value) {
+    char *end = NULL;
+    double pct = strtod(value, &end);
+    if (end == value || strcmp(end, "%") != 0 || pct < 0.0 || pct > 100.0) {
+        return -1.0;
+    }
+    return pct;
+}
+
+/**
+ * @brief Parse a positive count.
+ */
+static int parse_count(const char *value, uint64_t *out) {
+    char *end = NULL;
+    errno = 0;
+    unsigned long long v = strtoull(value, &end, 10);
+    if (end == value || *end != '\0' || errno != 0 || v == 0) {
+        return -1;
+    }
+    *out = v;
+    return 0;
+}
+
+/**
+ * @brief Apply one key of the [global] section.
+ */
+static int set_global(const char *key, const char *value) {
+    uint64_t n;
+
+    if (strcmp(key, "target") == 0) {
+        g_cfg.target = keep_string(value);
+    } else if (strcmp(key, "engine") == 0) {
+        g_cfg.engine = keep_string(value);
+    } else if (strcmp(key, "data") == 0) {
+        g_cfg.data_mode = keep_string(value);
+    } else if (strcmp(key, "fault") == 0) {
+        g_cfg.fault_spec = keep_string(value);
+    } else if (strcmp(key, "block-size") == 0) {
+        if (parse_bytes(value, 0, &n) != PARSE_OK || n == 0) {
+            return -1;
+        }
+        g_cfg.block_size = n;
+    } else if (strcmp(key, "threads") == 0 || strcmp(key, "iodepth") == 0) {
+        if (parse_count(value, &n) != 0 || n > 4096) {
+            return -1;
+        }
+        *(key[0] == 't' ? &g_cfg.threads : &g_cfg.iodepth) = (unsigned)n;
+    } else if (strcmp(key, "rate") == 0) {
+        return (parse_bytes(value, PARSE_RATE, &g_cfg.rate_limit) == PARSE_OK) ? 0 : -1;
+    } else if (strcmp(key, "seed") == 0) {
+        if (parse_count(value, &n) != 0) {
+            return -1;
+        }
+        g_cfg.seed = n;
+    } else {
+        return -2;
+    }
+    return 0;
+}
+
+/**
+ * @brief Apply one key of a phase section.
+ *
+ * @return int 0 on success, -1 for a bad value, -2 for an unknown key.
+ */
+static int set_phase(phase_t *ph, const char *key, const char *value) {
+    if (strcmp(key, "action") == 0) {
+        for (int a = 0; a < ACT_COUNT; ++a) {
+            if (strcmp(value, action_names[a]) == 0) {
+                ph->action = a;
+                return 0;
+            }
+        }
+        return -1;
+    }
+    if (strcmp(key, "target") == 0) {
+        ph->target = keep_string(value);
+        return ph->target ? 0 : -1;
+    }
+    if (strcmp(key, "rate") == 0) {
+        ph->has_rate = 1;
+        return (parse_bytes(value, PARSE_RATE, &ph->rate) == PARSE_OK) ? 0 : -1;
+    }
+    if (strcmp(key, "fill-to") == 0) {
+        ph->fill_kind = FILL_TO_PCT;
+        ph->pct       = parse_percent(value);
+        return (ph->pct < 0.0) ? -1 : 0;
+    }
+    if (strcmp(key, "size") == 0 || strcmp(key, "add") == 0) {
+        ph->fill_kind = (key[0] == 's') ? FILL_SIZE : FILL_ADD;
+        return (parse_bytes(value, 0, &ph->amount) == PARSE_OK) ? 0 : -1;
+    }
+    if (strcmp(key, "duration") == 0) {
+        ph->duration_s = parse_duration(value);
+        return (ph->duration_s < 0.0) ? -1 : 0;
+    }
+    if (strcmp(key, "free") == 0) {
+        ph->is_pct = (strchr(value, '%') != NULL);
+        if (ph->is_pct) {
+            ph->pct = parse_percent(value);
+            return (ph->pct < 0.0) ? -1 : 0;
+        }
+        return (parse_bytes(value, 0, &ph->amount) == PARSE_OK) ? 0 : -1;
+    }
+    if (strcmp(key, "files") == 0) {
+        return parse_count(value, &ph->files);
+    }
+    if (strcmp(key, "file-size") == 0) {
+        return (parse_bytes(value, 0, &ph->file_size) == PARSE_OK && ph->file_size) ? 0 : -1;
+    }
+    if (strcmp(key, "delete") == 0) {
+        ph->pct = parse_percent(value);
+        return (ph->pct < 0.0) ? -1 : 0;
+    }
+    return -2;
+}
+
+/**
+ * @brief Check that a phase only uses keys that make sense for its action.
+ */
+static int check_phase(const char *path, const phase_t *ph, unsigned keys) {
+    static const unsigned allowed[ACT_COUNT] = {
+        [ACT_AGE]    = KEY_COMMON | KEY_FILES | KEY_FILE_SIZE | KEY_DELETE,
+        [ACT_FILL]   = KEY_COMMON | KEY_FILL_END,
+        [ACT_HOLD]   = KEY_COMMON | KEY_DURATION,
+        [ACT_FREE]   = KEY_COMMON | KEY_FREE,
+        [ACT_VERIFY] = KEY_COMMON,
+    };
+
+    if (ph->action < 0) {
+        fprintf(stderr, "%s:%d: [%s] has no action= (age, fill, hold, free or verify).\n",
+                path, ph->line, ph->name);
+        return -1;
+    }
+    if (keys & ~allowed[ph->action]) {
+        fprintf(stderr, "%s:%d: [%s] has settings that don't apply to action=%s.\n",
+                path, ph->line, ph->name, action_names[ph->action]);
+        return -1;
+    }
+    if ((ph->action == ACT_HOLD && !(keys & KEY_DURATION)) ||
+        (ph->action == ACT_FREE && !(keys & KEY_FREE)) ||
+        (ph->action == ACT_AGE && (keys & (KEY_FILES | KEY_FILE_SIZE)) != (KEY_FILES | KEY_FILE_SIZE))) {
+        fprintf(stderr, "%s:%d: [%s] is missing a required setting for action=%s.\n",
+                path, ph->line, ph->name, action_names[ph->action]);
+        return -1;
+    }
+    if (ph->action == ACT_FILL && __builtin_popcount(keys & KEY_FILL_END) > 1) {
+        fprintf(stderr, "%s:%d: [%s] takes only one of fill-to=, size= and add=.\n",
+                path, ph->line, ph->name);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Bit recorded for a phase key, used by check_phase().
+ */
+static unsigned key_bit(const char *key) {
+    for (unsigned i = 0; i < sizeof(phase_keys) / sizeof(phase_keys[0]); ++i) {
+        if (strcmp(key, phase_keys[i]) == 0) {
+            return 1U << i;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Parse the job file into g_cfg and g_phases.
+ */
+static int parse_jobfile(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+
+    char line[JOB_LINE_MAX];
+    int lineno = 0;
+    int in_global = 0;
+    phase_t *ph = NULL;
+    unsigned keys = 0;
+    int rc = 0;
+
+    while (rc == 0 && fgets(line, sizeof(line), f)) {
+        ++lineno;
+        char *s = trim(line);
+        if (*s == '\0' || *s == '#' || *s == ';') {
+            continue;
+        }
+
+        // Comments may also follow a value, after white space
+        for (char *c = s + 1; *c; ++c) {
+            if ((*c == '#' || *c == ';') && isspace((unsigned char)c[-1])) {
+                *c = '\0';
+                s = trim(s);
+                break;
+            }
+        }
+
+        if (*s == '[') {
+            char *close = strchr(s, ']');
+            if (!close || close[1] != '\0' || close == s + 1) {
+                fprintf(stderr, "%s:%d: Malformed section header.\n", path, lineno);
+                rc = -1;
+                break;
+            }
+            *close = '\0';
+            if (ph && check_phase(path, ph, keys) != 0) {
+                rc = -1;
+                break;
+            }
+            ph = NULL;
+            keys = 0;
+            in_global = (strcmp(s + 1, "global") == 0);
+            if (in_global) {
+                continue;
+            }
+            if (g_n_phases == JOB_MAX_PHASES) {
+                fprintf(stderr, "%s:%d: Too many phases (at most %d).\n", path, lineno, JOB_MAX_PHASES);
+                rc = -1;
+                break;
+            }
+            ph = &g_phases[g_n_phases++];
+            memset(ph, 0, sizeof(*ph));
+            ph->name   = keep_string(s + 1);
+            ph->line   = lineno;
+            ph->action = -1;
+            for (int a = 0; a < ACT_COUNT; ++a) {
+                if (strcmp(s + 1, action_names[a]) == 0) {
+                    ph->action = a;
+                }
+            }
+            continue;
+        }
+
+        char *eq = strchr(s, '=');
+        if (!eq || (!in_global && !ph)) {
+            fprintf(stderr, "%s:%d: Expected key=value inside a section.\n", path, lineno);
+            rc = -1;
+            break;
+        }
+        *eq = '\0';
+        char *key = trim(s);
+        char *value = trim(eq + 1);
+
+        int r = in_global ? set_global(key, value) : set_phase(ph, key, value);
+        if (r == -2) {
+            fprintf(stderr, "%s:%d: Unknown setting '%s'.\n", path, lineno, key);
+            rc = -1;
+        } else if (r != 0) {
+            fprintf(stderr, "%s:%d: Invalid value '%s' for %s.\n", path, lineno, value, key);
+            rc = -1;
+        }
+        keys |= ph ? key_bit(key) : 0;
+    }
+
+    if (rc == 0 && ph && check_phase(path, ph, keys) != 0) {
+        rc = -1;
+    }
+    if (rc == 0 && g_n_phases == 0) {
+        fprintf(stderr, "%s: No phases defined.\n", path);
+        rc = -1;
+    }
+    fclose(f);
+    return rc;
+}
+
+/**
+ * @brief Filesystem usage of DIR in percent, as df reports it (-1 if unknown).
+ */
+static double fs_used_pct(const char *dir) {
+    struct statvfs fs;
+    if (statvfs(dir, &fs) != 0) {
+        return -1.0;
+    }
+    double used  = (double)(fs.f_blocks - fs.f_bfree) * (double)fs.f_frsize;
+    double avail = (double)fs.f_bavail * (double)fs.f_frsize;
+    return (used + avail > 0.0) ? 100.0 * used / (used + avail) : -1.0;
+}
+
+/**
+ * @brief Look up (or register) the runtime state of a target.
+ */
+static target_t *get_target(const char *path) {
+    for (unsigned t = 0; t < g_n_targets; ++t) {
+        if (strcmp(g_targets[t].path, path) == 0) {
+            return &g_targets[t];
+        }
+    }
+    if (g_n_targets == JOB_MAX_TARGETS) {
+        fprintf(stderr, "Error: Too many targets (at most %d).\n", JOB_MAX_TARGETS);
+        return NULL;
+    }
+
+    struct stat st;
+    if (stat(path, &st) == -1) {
+        perror(path);
+        return NULL;
+    }
+    target_t *tg = &g_targets[g_n_targets++];
+    memset(tg, 0, sizeof(*tg));
+    tg->path   = path;
+    tg->is_dir = S_ISDIR(st.st_mode);
+    return tg;
+}
+
+/**
+ * @brief Create and start the persistent job of a target, with an empty first phase.
+ */
+static int start_job(target_t *tg) {
+    fillfs_config_t cfg = g_cfg;
+    cfg.target     = tg->path;
+    cfg.size       = 0;
+    cfg.persistent = 1;
+
+    if (fillfs_job_create(&cfg, &tg->job) != 0) {
+        return -1;
+    }
+    if (fillfs_job_is_temporary(tg->job)) {
+        snprintf(tg->fill_path, sizeof(tg->fill_path), "%s", fillfs_job_fill_path(tg->job));
+    }
+    if (fillfs_job_start(tg->job) != 0 || fillfs_job_wait_phase(tg->job, NULL) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+static int run_fill(const phase_t *ph, target_t *tg, jobfile_phase_t *out, fillfs_stats_t *stats) {
+    uint64_t end = FILLFS_SIZE_AUTO;
+    switch (ph->fill_kind) {
+        case FILL_SIZE:
+            end = ph->amount;
+            break;
+        case FILL_ADD:
+            end = tg->extent + ph->amount;
+            break;
+        case FILL_TO_PCT: {
+            struct statvfs fs;
+            if (!tg->is_dir || statvfs(tg->path, &fs) != 0) {
+                fprintf(stderr, "Error: [%s] fill-to= needs a directory target.\n", ph->name);
+                return -1;
+            }
+            double used  = (double)(fs.f_blocks - fs.f_bfree) * (double)fs.f_frsize;
+            double avail = (double)fs.f_bavail * (double)fs.f_frsize;
+            double need  = ph->pct / 100.0 * (used + avail) - used;
+            end = tg->extent + ((need > 0.0) ? (uint64_t)need : 0);
+            break;
+        }
+        default:
+            break;
+    }
+
+    if (ph->has_rate) {
+        fillfs_job_set_rate(tg->job, ph->rate);
+    }
+    int rc = fillfs_job_continue(tg->job, tg->extent, end);
+    if (rc == 0) {
+        rc = fillfs_job_wait_phase(tg->job, stats);
+        tg->extent = stats->file_extent;
+        out->bytes = stats->bytes_written;
+        out->stats = stats;
+    }
+    if (ph->has_rate) {
+        fillfs_job_set_rate(tg->job, g_cfg.rate_limit);
+    }
+    return rc;
+}
+
+static int run_hold(const phase_t *ph) {
+    // Sleep in short steps so jobfile_stop() ends the hold promptly
+    uint64_t end = now_ns() + (uint64_t)(ph->duration_s * 1e9);
+    uint64_t now;
+    while (!g_stop && (now = now_ns()) < end) {
+        uint64_t wait = end - now;
+        struct timespec ts = { 0, (long)((wait < 100000000ULL) ? wait : 100000000ULL) };
+        nanosleep(&ts, NULL);
+    }
+    return 0;
+}
+
+static int run_free(const phase_t *ph, target_t *tg, jobfile_phase_t *out) {
+    if (!tg->job || !tg->is_dir) {
+        fprintf(stderr, "Error: [%s] free needs an earlier fill of a directory target.\n", ph->name);
+        return -1;
+    }
+
+    uint64_t amount = ph->amount;
+    if (ph->is_pct) {
+        struct statvfs fs;
+        if (statvfs(tg->path, &fs) != 0) {
+            perror("statvfs");
+            return -1;
+        }
+        amount = (uint64_t)(ph->pct / 100.0 * (double)fs.f_blocks * (double)fs.f_frsize);
+    }
+
+    // Keep whole blocks so a later fill (and verify) lines up with the data
+    uint64_t size = (amount < tg->extent) ? tg->extent - amount : 0;
+    size -= size % g_cfg.block_size;
+    if (fillfs_job_truncate(tg->job, size) != 0) {
+        return -1;
+    }
+    out->bytes = tg->extent - size;
+    tg->extent = size;
+    return 0;
+}
+
+static int run_verify(const phase_t *ph, target_t *tg, jobfile_phase_t *out) {
+    if (!tg->job) {
+        fprintf(stderr, "Error: [%s] verify needs an earlier fill phase.\n", ph->name);
+        return -1;
+    }
+    out->bytes = tg->extent;
+    int rc = fillfs_job_verify(tg->job, FILLFS_SIZE_AUTO, &out->mismatched);
+    if (rc == -EILSEQ) {
+        fprintf(stderr, "Error: [%s] %llu bytes of '%s' differ from what was written.\n",
+                ph->name, (unsigned long long)out->mismatched, fillfs_job_fill_path(tg->job));
+    }
+    return rc;
+}
+
+/**
+ * @brief Write one age file of SIZE bytes. Returns -1 with errno set on failure.
+ */
+static int write_age_file(const char *path, const void *buf, uint64_t size) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd == -1) {
+        return -1;
+    }
+    for (uint64_t done = 0; done < size; ) {
+        size_t len = (size - done < AGE_CHUNK) ? (size_t)(size - done) : AGE_CHUNK;
+        ssize_t n = write(fd, buf, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            int err = errno;
+            close(fd);
+            errno = err;
+            return -1;
+        }
+        done += (uint64_t)n;
+    }
+    return close(fd);
+}
+
+/**
+ * @brief Age the filesystem: create small files, then delete an evenly spread
+ *        share of them so later allocations land in fragmented free space.
+ */
+static int run_age(const phase_t *ph, target_t *tg, jobfile_phase_t *out) {
+    if (!tg->is_dir) {
+        fprintf(stderr, "Error: [%s] age needs a directory target.\n", ph->name);
+        return -1;
+    }
+    if (!tg->age_dir[0]) {
+        snprintf(tg->age_dir, sizeof(tg->age_dir), "%s%s", tg->path, AGE_DIR_NAME);
+        if (mkdir(tg->age_dir, 0777) == -1 && errno != EEXIST) {
+            perror(tg->age_dir);
+            tg->age_dir[0] = '\0';
+            return -1;
+        }
+    }
+
+    const datagen_t *gen = datagen_find(g_cfg.data_mode ? g_cfg.data_mode : "zero");
+    void *buf = malloc(AGE_CHUNK);
+    if (!gen || !buf) {
+        free(buf);
+        return -1;
+    }
+    gen->fill(buf, AGE_CHUNK, g_cfg.seed ? g_cfg.seed : (uint64_t)time(NULL));
+
+    char path[1100];
+    unsigned first = tg->age_next;
+    int rc = 0;
+    for (uint64_t i = 0; i < ph->files && !g_stop; ++i) {
+        snprintf(path, sizeof(path), "%s/age-%08u", tg->age_dir, tg->age_next++);
+        if (write_age_file(path, buf, ph->file_size) == -1) {
+            if (errno != ENOSPC) {
+                perror(path);
+                rc = -1;
+            }
+            unlink(path);
+            break;
+        }
+        out->bytes += ph->file_size;
+    }
+    free(buf);
+
+    // Delete every file whose index crosses the next multiple of 100/pct
+    unsigned created = tg->age_next - first;
+    for (unsigned i = 0; i < created; ++i) {
+        if ((uint64_t)((i + 1) * ph->pct / 100.0) > (uint64_t)(i * ph->pct / 100.0)) {
+            snprintf(path, sizeof(path), "%s/age-%08u", tg->age_dir, first + i);
+            unlink(path);
+        } else {
+            out->files++;
+        }
+    }
+
+    int dfd = open(tg->age_dir, O_RDONLY | O_DIRECTORY);
+    if (dfd != -1) {
+        syncfs(dfd);
+        close(dfd);
+    }
+    return rc;
+}
+
+int jobfile_run(const char *path, const fillfs_config_t *defaults,
+                jobfile_report_fn report, void *user) {
+    static int registered = 0;
+    if (!registered) {
+        atexit(cleanup_targets);
+        registered = 1;
+    }
+
+    g_cfg = *defaults;
+    g_n_phases = 0;
+    g_stop = 0;
+    int failed = (parse_jobfile(path) != 0);
+
+    for (unsigned p = 0; p < g_n_phases && !failed && !g_stop; ++p) {
+        const phase_t *ph = &g_phases[p];
+        const char *target_path = ph->target ? ph->target : g_cfg.target;
+        if (!target_path) {
+            fprintf(stderr, "Error: [%s] has no target (set target= in [global] or the phase).\n",
+                    ph->name);
+            failed = 1;
+            break;
+        }
+        target_t *tg = get_target(target_path);
+        if (!tg) {
+            failed = 1;
+            break;
+        }
+
+        jobfile_phase_t out;
+        fillfs_stats_t stats;
+        memset(&out, 0, sizeof(out));
+        out.name   = ph->name;
+        out.action = action_names[ph->action];
+        out.target = tg->path;
+
+        if (ph->action == ACT_FILL && !tg->job && start_job(tg) != 0) {
+            failed = 1;
+            break;
+        }
+        if (tg->job) {
+            prom_exporter_set_source(tg->job, tg->path, ph->name);
+            control_set_source(tg->job, tg->path);
+        }
+
+        uint64_t t0 = now_ns();
+        int rc = 0;
+        switch (ph->action) {
+            case ACT_AGE:    rc = run_age(ph, tg, &out);           break;
+            case ACT_FILL:   rc = run_fill(ph, tg, &out, &stats);  break;
+            case ACT_HOLD:   rc = run_hold(ph);                    break;
+            case ACT_FREE:   rc = run_free(ph, tg, &out);          break;
+            case ACT_VERIFY: rc = run_verify(ph, tg, &out);        break;
+            default:         break;
+        }
+        out.elapsed_s   = (double)(now_ns() - t0) / 1e9;
+        out.fs_used_pct = tg->is_dir ? fs_used_pct(tg->path) : -1.0;
+        out.error       = (rc != 0);
+        report(&out, user);
+        failed = out.error;
+    }
+
+    // Stop the writers, remove fill files and age files
+    prom_exporter_set_source(NULL, NULL, NULL);
+    control_set_source(NULL, NULL);
+    for (unsigned t = 0; t < g_n_targets; ++t) {
+        if (g_targets[t].job) {
+            fillfs_job_wait(g_targets[t].job, NULL);
+            fillfs_job_destroy(g_targets[t].job);
+            g_targets[t].job = NULL;
+            g_targets[t].fill_path[0] = '\0';
+        }
+    }
+    cleanup_targets();
+    g_n_targets = 0;
+
+    for (unsigned i = 0; i < g_n_strings; ++i) {
+        free(g_strings[i]);
+    }
+    g_n_strings = 0;
+
+    return failed ? 1 : 0;
+}
+
+void jobfile_stop(void) {
+    g_stop = 1;
+}
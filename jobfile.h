@@ -0,0 +1,79 @@
+/*
+ * jobfile.h
+ *
+ * Copyright (c) 2025 Robert Heffernan
+ *
+ * Author: Robert Heffernan <robert@heffernantech.au>
+ *
+ * This file is part of the fillfs utility. It is licensed under the MIT License:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify,
+ * merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Job files: multi-phase capacity scenarios (age, fill, hold, free, verify)
+ * run by one fillfs process. See the "Job Files" section of README.md.
+ */
+
+#ifndef FILLFS_JOBFILE_H
+#define FILLFS_JOBFILE_H
+
+#include <stdint.h>
+
+#include "fillfs.h"
+
+/**
+ * @brief Outcome of one phase, passed to the report callback.
+ */
+typedef struct {
+    const char *name;           ///< Section name
+    const char *action;         ///< age, fill, hold, free or verify
+    const char *target;         ///< Target directory or file of the phase
+    double      elapsed_s;      ///< Wall time of the phase
+    double      fs_used_pct;    ///< Filesystem usage after the phase (-1 if unknown)
+    uint64_t    bytes;          ///< age: bytes written, free: bytes released, verify: bytes read
+    uint64_t    files;          ///< age: small files left in place
+    uint64_t    mismatched;     ///< verify: bytes that differ from the generated data
+    int         error;          ///< Non-zero if the phase failed
+    const fillfs_stats_t *stats; ///< fill: writer statistics of the phase, otherwise NULL
+} jobfile_phase_t;
+
+/**
+ * @brief Called after every phase.
+ */
+typedef void (*jobfile_report_fn)(const jobfile_phase_t *phase, void *user);
+
+/**
+ * @brief Parse the job file at PATH and run its phases in order.
+ *
+ * @param path     Job file.
+ * @param defaults Settings from the command line; [global] overrides them.
+ * @param report   Phase report callback.
+ * @param user     Passed to REPORT.
+ * @return int 0 if every phase succeeded, 1 otherwise.
+ */
+int jobfile_run(const char *path, const fillfs_config_t *defaults,
+                jobfile_report_fn report, void *user);
+
+/**
+ * @brief Finish the current phase early where possible and run no further
+ *        phases. The caller cancels the running fill itself.
+ */
+void jobfile_stop(void);
+
+#endif /* FILLFS_JOBFILE_H */
@@ -0,0 +1,478 @@
+/*
+ * kernels.c
+ *
+ * Copyright (c) 2025 Robert Heffernan
+ *
+ * Author: Robert Heffernan <robert@heffernantech.au>
+ *
+ * This file is part of the fillfs utility. It is licensed under the MIT License:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify,
+ * merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Data kernels with one implementation per instruction set, selected at run time
+ * so a single binary runs at full speed from SSE2-only x86 machines to AVX-512
+ * ones and on ARM. All implementations compute exactly the same result.
+ */
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "kernels.h"
+#include "util.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define KERNELS_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define KERNELS_NEON 1
+#include <arm_neon.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+/// Multipliers of the word hash (golden ratio, then the murmur3 finaliser)
+#define KH_M0 0x9E3779B1u
+#define KH_M1 0x85EBCA6Bu
+#define KH_M2 0xC2B2AE35u
+
+/// Non-temporal store threshold when the L2 size is unknown
+#define KERNELS_NT_DEFAULT (1U << 20)
+
+/**
+ * @brief Word @p i of the random stream. Every step is a bijection, so no word
+ *        repeats within 16 GiB.
+ */
+static inline uint32_t word_hash(uint32_t i, uint32_t k0, uint32_t k1) {
+    uint32_t h = (i ^ k0) * KH_M0;
+    h ^= h >> 16;
+    h *= KH_M1;
+    h ^= h >> 13;
+    h *= KH_M2;
+    h ^= h >> 16;
+    return h ^ k1;
+}
+
+/**
+ * @brief Generate words @p first onwards into @p buf until @p len bytes are written.
+ *        Used for whole buffers by the scalar kernel and for the tails of the others.
+ */
+static void random_tail(unsigned char *buf, size_t len, uint32_t first, uint32_t k0, uint32_t k1) {
+    uint32_t i = first;
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    for (; len >= 4; ++i, buf += 4, len -= 4) {
+        uint32_t w = word_hash(i, k0, k1);
+        memcpy(buf, &w, 4);
+    }
+#endif
+    for (; len > 0; ++i) {
+        uint32_t w = word_hash(i, k0, k1);
+        size_t   n = (len < 4) ? len : 4;
+        for (size_t b = 0; b < n; ++b) {
+            buf[b] = (unsigned char)(w >> (8 * b));
+        }
+        buf += n;
+        len -= n;
+    }
+}
+
+/// Buffers of at least this many bytes are written with non-temporal stores
+static size_t nt_threshold = SIZE_MAX;
+
+/**
+ * @brief Decide whether to fill @p buf with non-temporal (streaming) stores and, if
+ *        so, generate the words before the first @p align-byte boundary normally.
+ *
+ * Streaming stores bypass the caches, so generating a buffer larger than the L2
+ * does not evict the working sets of other processes on the machine. They need
+ * aligned addresses, so a buffer that is not word aligned is filled normally.
+ *
+ * @param words Receives the number of words generated here.
+ * @return int Non-zero to use streaming stores from word @p words on.
+ */
+static int stream_head(unsigned char *buf, size_t len, size_t align, size_t *words,
+                       uint32_t k0, uint32_t k1) {
+    size_t head = (size_t)(-(uintptr_t)buf & (align - 1));
+
+    *words = 0;
+    if (len < nt_threshold || ((uintptr_t)buf & 3) != 0 || head >= len) {
+        return 0;
+    }
+    random_tail(buf, head, 0, k0, k1);
+    *words = head / 4;
+    return 1;
+}
+
+static int supported_always(void) {
+    return 1;
+}
+
+static void random_fill_scalar(void *buf, size_t len, uint64_t seed) {
+    uint64_t key = mix64(seed);
+    random_tail(buf, len, 0, (uint32_t)key, (uint32_t)(key >> 32));
+}
+
+static uint64_t count_diff_scalar(const void *a, const void *b, size_t len) {
+    const unsigned char *pa = a, *pb = b;
+    uint64_t n = 0;
+    for (size_t i = 0; i < len; ++i) {
+        n += (pa[i] != pb[i]);
+    }
+    return n;
+}
+
+#ifdef KERNELS_X86
+
+static int supported_sse2(void) {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2");
+}
+
+static int supported_avx2(void) {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+static int supported_avx512(void) {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+}
+
+/**
+ * @brief 32-bit lane multiply; SSE2 only multiplies the even lanes to 64 bits.
+ */
+__attribute__((target("sse2")))
+static inline __m128i mullo32_sse2(__m128i a, __m128i b) {
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd  = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+__attribute__((target("sse2")))
+static void random_fill_sse2(void *buf, size_t len, uint64_t seed) {
+    uint64_t key = mix64(seed);
+    uint32_t k0 = (uint32_t)key, k1 = (uint32_t)(key >> 32);
+    const __m128i vk0 = _mm_set1_epi32((int)k0), vk1 = _mm_set1_epi32((int)k1);
+    const __m128i m0 = _mm_set1_epi32((int)KH_M0), m1 = _mm_set1_epi32((int)KH_M1);
+    const __m128i m2 = _mm_set1_epi32((int)KH_M2), step = _mm_set1_epi32(4);
+    unsigned char *p = buf;
+    size_t words;
+    int nt = stream_head(p, len, 16, &words, k0, k1);
+    __m128i idx = _mm_add_epi32(_mm_set1_epi32((int)words), _mm_setr_epi32(0, 1, 2, 3));
+
+    for (; len - words * 4 >= 16; words += 4, idx = _mm_add_epi32(idx, step)) {
+        __m128i h = mullo32_sse2(_mm_xor_si128(idx, vk0), m0);
+        h = _mm_xor_si128(h, _mm_srli_epi32(h, 16));
+        h = mullo32_sse2(h, m1);
+        h = _mm_xor_si128(h, _mm_srli_epi32(h, 13));
+        h = mullo32_sse2(h, m2);
+        h = _mm_xor_si128(_mm_xor_si128(h, _mm_srli_epi32(h, 16)), vk1);
+        if (nt) {
+            _mm_stream_si128((__m128i*)(p + words * 4), h);
+        } else {
+            _mm_storeu_si128((__m128i*)(p + words * 4), h);
+        }
+    }
+    if (nt) {
+        _mm_sfence();
+    }
+    random_tail(p + words * 4, len - words * 4, (uint32_t)words, k0, k1);
+}
+
+__attribute__((target("sse2")))
+static uint64_t count_diff_sse2(const void *a, const void *b, size_t len) {
+    const unsigned char *pa = a, *pb = b;
+    uint64_t n = 0;
+    size_t i = 0;
+
+    for (; i + 16 <= len; i += 16) {
+        __m128i eq = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(pa + i)),
+                                    _mm_loadu_si128((const __m128i*)(pb + i)));
+        n += 16 - (uint64_t)__builtin_popcount((unsigned)_mm_movemask_epi8(eq));
+    }
+    return n + count_diff_scalar(pa + i, pb + i, len - i);
+}
+
+__attribute__((target("avx2")))
+static void random_fill_avx2(void *buf, size_t len, uint64_t seed) {
+    uint64_t key = mix64(seed);
+    uint32_t k0 = (uint32_t)key, k1 = (uint32_t)(key >> 32);
+    const __m256i vk0 = _mm256_set1_epi32((int)k0), vk1 = _mm256_set1_epi32((int)k1);
+    const __m256i m0 = _mm256_set1_epi32((int)KH_M0), m1 = _mm256_set1_epi32((int)KH_M1);
+    const __m256i m2 = _mm256_set1_epi32((int)KH_M2), step = _mm256_set1_epi32(8);
+    unsigned char *p = buf;
+    size_t words;
+    int nt = stream_head(p, len, 32, &words, k0, k1);
+    __m256i idx = _mm256_add_epi32(_mm256_set1_epi32((int)words),
+                                   _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+
+    for (; len - words * 4 >= 32; words += 8, idx = _mm256_add_epi32(idx, step)) {
+        __m256i h = _mm256_mullo_epi32(_mm256_xor_si256(idx, vk0), m0);
+        h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 16));
+        h = _mm256_mullo_epi32(h, m1);
+        h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 13));
+        h = _mm256_mullo_epi32(h, m2);
+        h = _mm256_xor_si256(_mm256_xor_si256(h, _mm256_srli_epi32(h, 16)), vk1);
+        if (nt) {
+            _mm256_stream_si256((__m256i*)(p + words * 4), h);
+        } else {
+            _mm256_storeu_si256((__m256i*)(p + words * 4), h);
+        }
+    }
+    if (nt) {
+        _mm_sfence();
+    }
+    random_tail(p + words * 4, len - words * 4, (uint32_t)words, k0, k1);
+}
+
+__attribute__((target("avx2,popcnt")))
+static uint64_t count_diff_avx2(const void *a, const void *b, size_t len) {
+    const unsigned char *pa = a, *pb = b;
+    uint64_t n = 0;
+    size_t i = 0;
+
+    for (; i + 32 <= len; i += 32) {
+        __m256i eq = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(pa + i)),
+                                       _mm256_loadu_si256((const __m256i*)(pb + i)));
+        n += 32 - (uint64_t)__builtin_popcount((unsigned)_mm256_movemask_epi8(eq));
+    }
+    return n + count_diff_scalar(pa + i, pb + i, len - i);
+}
+
+__attribute__((target("avx512f")))
+static void random_fill_avx512(void *buf, size_t len, uint64_t seed) {
+    uint64_t key = mix64(seed);
+    uint32_t k0 = (uint32_t)key, k1 = (uint32_t)(key >> 32);
+    const __m512i vk0 = _mm512_set1_epi32((int)k0), vk1 = _mm512_set1_epi32((int)k1);
+    const __m512i m0 = _mm512_set1_epi32((int)KH_M0), m1 = _mm512_set1_epi32((int)KH_M1);
+    const __m512i m2 = _mm512_set1_epi32((int)KH_M2), step = _mm512_set1_epi32(16);
+    unsigned char *p = buf;
+    size_t words;
+    int nt = stream_head(p, len, 64, &words, k0, k1);
+    __m512i idx = _mm512_add_epi32(_mm512_set1_epi32((int)words),
+                                   _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7,
+                                                     8, 9, 10, 11, 12, 13, 14, 15));
+
+    for (; len - words * 4 >= 64; words += 16, idx = _mm512_add_epi32(idx, step)) {
+        __m512i h = _mm512_mullo_epi32(_mm512_xor_si512(idx, vk0), m0);
+        h = _mm512_xor_si512(h, _mm512_srli_epi32(h, 16));
+        h = _mm512_mullo_epi32(h, m1);
+        h = _mm512_xor_si512(h, _mm512_srli_epi32(h, 13));
+        h = _mm512_mullo_epi32(h, m2);
+        h = _mm512_xor_si512(_mm512_xor_si512(h, _mm512_srli_epi32(h, 16)), vk1);
+        if (nt) {
+            _mm512_stream_si512((void*)(p + words * 4), h);
+        } else {
+            _mm512_storeu_si512((void*)(p + words * 4), h);
+        }
+    }
+    if (nt) {
+        _mm_sfence();
+    }
+    random_tail(p + words * 4, len - words * 4, (uint32_t)words, k0, k1);
+}
+
+__attribute__((target("avx512f,avx512bw,popcnt")))
+static uint64_t count_diff_avx512(const void *a, const void *b, size_t len) {
+    const unsigned char *pa = a, *pb = b;
+    uint64_t n = 0;
+    size_t i = 0;
+
+    for (; i + 64 <= len; i += 64) {
+        __mmask64 ne = _mm512_cmpneq_epi8_mask(_mm512_loadu_si512((const void*)(pa + i)),
+                                               _mm512_loadu_si512((const void*)(pb + i)));
+        n += (uint64_t)__builtin_popcountll(ne);
+    }
+    return n + count_diff_scalar(pa + i, pb + i, len - i);
+}
+
+#endif /* KERNELS_X86 */
+
+#ifdef KERNELS_NEON
+
+static int supported_neon(void) {
+    return (getauxval(AT_HWCAP) & HWCAP_ASIMD) != 0;
+}
+
+static void random_fill_neon(void *buf, size_t len, uint64_t seed) {
+    uint64_t key = mix64(seed);
+    uint32_t k0 = (uint32_t)key, k1 = (uint32_t)(key >> 32);
+    const uint32x4_t vk0 = vdupq_n_u32(k0), vk1 = vdupq_n_u32(k1), step = vdupq_n_u32(4);
+    static const uint32_t lanes[4] = { 0, 1, 2, 3 };
+    uint32x4_t idx = vld1q_u32(lanes);
+    unsigned char *p = buf;
+    size_t words = 0;
+
+    for (; len - words * 4 >= 16; words += 4, idx = vaddq_u32(idx, step)) {
+        uint32x4_t h = vmulq_n_u32(veorq_u32(idx, vk0), KH_M0);
+        h = veorq_u32(h, vshrq_n_u32(h, 16));
+        h = vmulq_n_u32(h, KH_M1);
+        h = veorq_u32(h, vshrq_n_u32(h, 13));
+        h = vmulq_n_u32(h, KH_M2);
+        h = veorq_u32(h, vshrq_n_u32(h, 16));
+        vst1q_u8(p + words * 4, vreinterpretq_u8_u32(veorq_u32(h, vk1)));
+    }
+    random_tail(p + words * 4, len - words * 4, (uint32_t)words, k0, k1);
+}
+
+static uint64_t count_diff_neon(const void *a, const void *b, size_t len) {
+    const unsigned char *pa = a, *pb = b;
+    uint64_t n = 0;
+    size_t i = 0;
+
+    for (; i + 16 <= len; i += 16) {
+        // Equal bytes compare to 0xff; count the ones left at zero
+        uint8x16_t eq = vceqq_u8(vld1q_u8(pa + i), vld1q_u8(pb + i));
+        n += 16 - vaddvq_u8(vshrq_n_u8(eq, 7));
+    }
+    return n + count_diff_scalar(pa + i, pb + i, len - i);
+}
+
+#endif /* KERNELS_NEON */
+
+const kernel_set_t kernel_table[] = {
+#ifdef KERNELS_X86
+    { "avx512", supported_avx512, random_fill_avx512, count_diff_avx512 },
+    { "avx2",   supported_avx2,   random_fill_avx2,   count_diff_avx2   },
+    { "sse2",   supported_sse2,   random_fill_sse2,   count_diff_sse2   },
+#endif
+#ifdef KERNELS_NEON
+    { "neon",   supported_neon,   random_fill_neon,   count_diff_neon   },
+#endif
+    { "scalar", supported_always, random_fill_scalar, count_diff_scalar },
+    { NULL,     NULL,             NULL,               NULL              }
+};
+
+static pthread_once_t      kernels_once = PTHREAD_ONCE_INIT;
+static const kernel_set_t *kernels_selected;
+
+static void kernels_select(void) {
+    const char *want = getenv("FILLFS_KERNELS");
+
+#ifdef KERNELS_X86
+    // A buffer larger than the per-core cache would stream through it anyway
+    long l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    nt_threshold = (l2 > 0) ? (size_t)l2 : KERNELS_NT_DEFAULT;
+#endif
+
+    for (const kernel_set_t *k = kernel_table; k->name; ++k) {
+        if (want && *want && strcmp(k->name, want) != 0) {
+            continue;
+        }
+        if (k->supported()) {
+            kernels_selected = k;
+            return;
+        }
+    }
+    if (want && *want) {
+        fprintf(stderr, "Warning: FILLFS_KERNELS=%s is unknown or not supported by this CPU; "
+                        "choosing automatically.\n", want);
+    }
+    for (const kernel_set_t *k = kernel_table; k->name; ++k) {
+        if (k->supported()) {
+            kernels_selected = k;
+            return;
+        }
+    }
+}
+
+const kernel_set_t *kernels(void) {
+    pthread_once(&kernels_once, kernels_select);
+    return kernels_selected;
+}
+
+size_t kernels_set_nt_threshold(size_t bytes) {
+    kernels();
+    size_t old = nt_threshold;
+    nt_threshold = bytes;
+    return old;
+}
+
+/**
+ * @brief Write the relevant CPU features found at run time as a space separated list.
+ */
+static void cpu_features(char *buf, size_t len) {
+    size_t used = 0;
+
+    if (len == 0) {
+        return;
+    }
+    buf[0] = '\0';
+#ifdef KERNELS_X86
+    // __builtin_cpu_supports() only takes string literals
+    __builtin_cpu_init();
+    const struct {
+        const char *name;
+        int         has;
+    } features[] = {
+        { "sse2",     __builtin_cpu_supports("sse2")     },
+        { "ssse3",    __builtin_cpu_supports("ssse3")    },
+        { "sse4.1",   __builtin_cpu_supports("sse4.1")   },
+        { "sse4.2",   __builtin_cpu_supports("sse4.2")   },
+        { "popcnt",   __builtin_cpu_supports("popcnt")   },
+        { "avx",      __builtin_cpu_supports("avx")      },
+        { "avx2",     __builtin_cpu_supports("avx2")     },
+        { "avx512f",  __builtin_cpu_supports("avx512f")  },
+        { "avx512bw", __builtin_cpu_supports("avx512bw") },
+    };
+    for (size_t i = 0; i < sizeof(features) / sizeof(features[0]); ++i) {
+        if (features[i].has && used < len) {
+            used += (size_t)snprintf(buf + used, len - used, "%s%s", used ? " " : "", features[i].name);
+        }
+    }
+#elif defined(KERNELS_NEON)
+    unsigned long hwcap = getauxval(AT_HWCAP);
+    if ((hwcap & HWCAP_ASIMD) && used < len) {
+        used += (size_t)snprintf(buf + used, len - used, "%s%s", used ? " " : "", "neon");
+    }
+#ifdef HWCAP_SVE
+    if ((hwcap & HWCAP_SVE) && used < len) {
+        used += (size_t)snprintf(buf + used, len - used, "%s%s", used ? " " : "", "sve");
+    }
+#endif
+#endif
+    (void)used;
+}
+
+void kernels_list(FILE *out) {
+    const kernel_set_t *sel = kernels();
+    const char *want = getenv("FILLFS_KERNELS");
+    char features[256];
+
+    cpu_features(features, sizeof(features));
+    fprintf(out, "CPU features: %s\n", features[0] ? features : "(none detected)");
+    fprintf(out, "Kernels (random fill, verify compare):\n");
+    for (const kernel_set_t *k = kernel_table; k->name; ++k) {
+        fprintf(out, "  %-8s %s\n", k->name,
+                (k == sel) ? "selected" : k->supported() ? "available" : "not supported");
+    }
+    if (want && *want) {
+        fprintf(out, "FILLFS_KERNELS=%s\n", want);
+    }
+    if (nt_threshold != SIZE_MAX && strcmp(sel->name, "scalar") != 0 && strcmp(sel->name, "neon") != 0) {
+        fprintf(out, "Non-temporal stores for buffers from %zu KiB\n", nt_threshold / 1024);
+    }
+}
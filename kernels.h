@@ -0,0 +1,82 @@
+/*
+ * kernels.h
+ *
+ * Copyright (c) 2025 Robert Heffernan
+ *
+ * Author: Robert Heffernan <robert@heffernantech.au>
+ *
+ * This file is part of the fillfs utility. It is licensed under the MIT License:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify,
+ * merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef FILLFS_KERNELS_H
+#define FILLFS_KERNELS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * @brief One implementation of the data kernels, built for one instruction set.
+ *
+ * Every implementation produces exactly the same results, so data written on one
+ * machine verifies on any other.
+ */
+typedef struct {
+    const char *name;   ///< "avx512", "avx2", "sse2", "neon" or "scalar"
+    int       (*supported)(void);   ///< Non-zero if this CPU can run it
+
+    /**
+     * @brief Fill a buffer with the seeded pseudo-random stream: little-endian 32-bit
+     *        words, word i a keyed hash of i (so any range can be generated on its own).
+     */
+    void      (*random_fill)(void *buf, size_t len, uint64_t seed);
+
+    /**
+     * @brief Count the bytes that differ between two buffers.
+     */
+    uint64_t  (*count_diff)(const void *a, const void *b, size_t len);
+} kernel_set_t;
+
+/**
+ * @brief All implementations, fastest first, terminated by an entry with a NULL name.
+ */
+extern const kernel_set_t kernel_table[];
+
+/**
+ * @brief The implementation in use, chosen on first call: the fastest one the CPU
+ *        supports, or the one named by the FILLFS_KERNELS environment variable.
+ */
+const kernel_set_t *kernels(void);
+
+/**
+ * @brief Fill buffers of at least @p bytes with non-temporal stores, where the
+ *        implementation has them (x86). SIZE_MAX turns them off. The default is the
+ *        size of the L2 cache.
+ *
+ * @return size_t The previous threshold.
+ */
+size_t kernels_set_nt_threshold(size_t bytes);
+
+/**
+ * @brief Print the CPU features found at run time and which implementation is in use.
+ */
+void kernels_list(FILE *out);
+
+#endif /* FILLFS_KERNELS_H */
@@ -0,0 +1,2421 @@
+/*
+ * libfillfs.c
+ *
+ * Copyright (c) 2025 Robert Heffernan
+ *
+ * Author: Robert Heffernan <robert@heffernantech.au>
+ *
+ * This file is part of the fillfs utility. It is licensed under the MIT License:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify,
+ * merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * libfillfs: the fill engine behind the fillfs tool (see fillfs.h).
+ *
+ * A job owns a set of writer threads that claim blocks from a shared cursor
+ * and push them through the selected I/O engine until the target size is
+ * reached, the filesystem is full, the job is cancelled or a write fails.
+ */
+
+#define _GNU_SOURCE
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <sys/statvfs.h>
+#include <pthread.h>
+#include <dirent.h>
+
+#ifdef __linux__      // For ioprio_set (Linux only)
+#include <sys/syscall.h>
+#include <linux/ioprio.h>
+#endif
+
+#ifdef __linux__      // For BLKGETSIZE64
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#endif
+
+#include <sys/resource.h> // for setpriority, PRIO_PROCESS
+
+#include "fillfs.h"
+#include "cpustat.h"
+#include "datagen.h"
+#include "engine.h"
+#include "kernels.h"
+#include "owner.h"
+#include "timeline.h"
+#include "trace.h"
+#include "util.h"
+
+#ifndef MAX_FILENAME_LENGTH
+#define MAX_FILENAME_LENGTH 1024
+#endif
+
+#define FILLFS_FILE_NAME "/.fillfs"
+
+#define DEFAULT_BLOCK_SIZE  (32U * 1024U * 1024U)
+#define DEFAULT_ASYNC_DEPTH 8
+#define DEFAULT_TRACE_SAMPLE 16
+
+/** Throughput timeline sampling interval. */
+#define TIMELINE_INTERVAL_NS 1000000000ULL
+
+/** Default size of a background read. */
+#define DEFAULT_READ_SIZE    4096U
+
+/** How often the fill level is checked for the fill-level profile. */
+#define PROFILE_INTERVAL_NS  100000000ULL
+
+/*
+ * Latency histogram layout: one group per power of two of nanoseconds, each
+ * split into LAT_SUB_BUCKETS linear sub-buckets (~12% resolution per bucket).
+ */
+#define LAT_SUB_BITS     3
+#define LAT_SUB_BUCKETS  (1U << LAT_SUB_BITS)
+#define LAT_BUCKETS      (64U * LAT_SUB_BUCKETS)
+
+/**
+ * @brief Log-linear histogram of per-write latencies.
+ */
+typedef struct {
+    uint64_t count;                 ///< Number of samples recorded
+    uint64_t sum_ns;                ///< Sum of all samples (for the mean)
+    uint64_t max_ns;                ///< Largest sample seen
+    uint64_t buckets[LAT_BUCKETS];  ///< Sample counts per bucket
+} lat_hist_t;
+
+/**
+ * @brief Map a latency in nanoseconds to its histogram bucket.
+ */
+static unsigned lat_bucket(uint64_t ns) {
+    if (ns < LAT_SUB_BUCKETS) {
+        return (unsigned)ns;
+    }
+    unsigned msb = 63U - (unsigned)__builtin_clzll(ns);
+    unsigned sub = (unsigned)(ns >> (msb - LAT_SUB_BITS)) & (LAT_SUB_BUCKETS - 1);
+    return (msb - LAT_SUB_BITS + 1) * LAT_SUB_BUCKETS + sub;
+}
+
+/**
+ * @brief Midpoint (in nanoseconds) of the range covered by a histogram bucket.
+ */
+static double lat_bucket_value(unsigned idx) {
+    if (idx < LAT_SUB_BUCKETS) {
+        return (double)idx;
+    }
+    unsigned msb = idx / LAT_SUB_BUCKETS + LAT_SUB_BITS - 1;
+    unsigned sub = idx % LAT_SUB_BUCKETS;
+    double width = (double)(1ULL << (msb - LAT_SUB_BITS));
+    return (double)(LAT_SUB_BUCKETS + sub) * width + width / 2.0;
+}
+
+/**
+ * @brief Record a sample. Only the owning writer adds samples; the relaxed
+ *        stores (plain moves) let fillfs_job_latency() read a live histogram.
+ */
+static void lat_hist_add(lat_hist_t *h, uint64_t ns) {
+    unsigned b = lat_bucket(ns);
+    __atomic_store_n(&h->count, h->count + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&h->sum_ns, h->sum_ns + ns, __ATOMIC_RELAXED);
+    if (ns > h->max_ns) {
+        __atomic_store_n(&h->max_ns, ns, __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&h->buckets[b], h->buckets[b] + 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Add a (possibly live) histogram into cumulative counts per bound.
+ *
+ * COUNT is the sum of the same bucket loads as COUNTS, not h->count: with
+ * writers still adding samples, a separate load could come out lower than a
+ * bucket, which is not a valid cumulative histogram.
+ */
+static void lat_hist_accumulate(const lat_hist_t *h, const double *bounds_ns, unsigned n,
+                                uint64_t *counts, uint64_t *count, uint64_t *sum_ns) {
+    *sum_ns += __atomic_load_n(&h->sum_ns, __ATOMIC_RELAXED);
+    for (unsigned i = 0; i < LAT_BUCKETS; ++i) {
+        uint64_t c = __atomic_load_n(&h->buckets[i], __ATOMIC_RELAXED);
+        if (c == 0) {
+            continue;
+        }
+        *count += c;
+        double v = lat_bucket_value(i);
+        for (unsigned j = 0; j < n; ++j) {
+            if (v <= bounds_ns[j]) {
+                counts[j] += c;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Add every sample of SRC into DST.
+ */
+static void lat_hist_merge(lat_hist_t *dst, const lat_hist_t *src) {
+    dst->count  += src->count;
+    dst->sum_ns += src->sum_ns;
+    if (src->max_ns > dst->max_ns) {
+        dst->max_ns = src->max_ns;
+    }
+    for (unsigned i = 0; i < LAT_BUCKETS; ++i) {
+        dst->buckets[i] += src->buckets[i];
+    }
+}
+
+/**
+ * @brief Estimate a latency percentile from the histogram.
+ *
+ * @param h   Histogram to query.
+ * @param pct Percentile in the range 0..100.
+ * @return double Latency in nanoseconds (0 if the histogram is empty).
+ */
+static double lat_hist_percentile(const lat_hist_t *h, double pct) {
+    if (h->count == 0) {
+        return 0.0;
+    }
+    uint64_t rank = (uint64_t)((pct / 100.0) * (double)h->count + 0.5);
+    if (rank < 1) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (unsigned i = 0; i < LAT_BUCKETS; ++i) {
+        seen += h->buckets[i];
+        if (seen >= rank) {
+            double v = lat_bucket_value(i);
+            return (v > (double)h->max_ns) ? (double)h->max_ns : v;
+        }
+    }
+    return (double)h->max_ns;
+}
+
+/**
+ * @brief Add a (possibly live) histogram into DST, like lat_hist_merge().
+ */
+static void lat_hist_snapshot(lat_hist_t *dst, const lat_hist_t *src) {
+    dst->sum_ns += __atomic_load_n(&src->sum_ns, __ATOMIC_RELAXED);
+    for (unsigned i = 0; i < LAT_BUCKETS; ++i) {
+        dst->buckets[i] += __atomic_load_n(&src->buckets[i], __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * @brief Reduce the cumulative snapshot CUR to the samples added since MARK.
+ *        A maximum cannot be subtracted, so it becomes the value of the
+ *        highest non-empty bucket.
+ */
+static void lat_hist_since(lat_hist_t *cur, const lat_hist_t *mark) {
+    cur->count  = 0;
+    cur->max_ns = 0;
+    cur->sum_ns = (cur->sum_ns > mark->sum_ns) ? cur->sum_ns - mark->sum_ns : 0;
+    for (unsigned i = 0; i < LAT_BUCKETS; ++i) {
+        cur->buckets[i] = (cur->buckets[i] > mark->buckets[i]) ? cur->buckets[i] - mark->buckets[i] : 0;
+        if (cur->buckets[i]) {
+            cur->count += cur->buckets[i];
+            cur->max_ns = (uint64_t)lat_bucket_value(i);
+        }
+    }
+}
+
+/**
+ * @brief Generate full path for the fill file in the provided directory.
+ *
+ * @param path         The buffer to store the resulting filename.
+ * @param mount_point  The directory path where the file will be created.
+ */
+static void generate_file_path(char *path, const char *mount_point) {
+    snprintf(path, MAX_FILENAME_LENGTH, "%s%s", mount_point, FILLFS_FILE_NAME);
+}
+
+#ifdef __linux__
+/**
+ * @brief Attempt to set the I/O priority of the current thread to "idle" class.
+ *        This is Linux-specific and requires the ioprio_set syscall.
+ */
+static void set_io_priority_idle(void) {
+    // ioprio_set(ioprio_which = 1 for PRIO_PROCESS, who = 0 for current,
+    // ioprio = IOPRIO_PRIO_VALUE(IOPRIO_CLASS_IDLE, 7))
+    if (syscall(SYS_ioprio_set, 1, 0, IOPRIO_PRIO_VALUE(IOPRIO_CLASS_IDLE, 7)) == -1) {
+        perror("ioprio_set");
+        // If this fails, we silently ignore or fallback to CPU nice.
+    }
+}
+#endif
+
+struct fill_worker;
+
+/**
+ * @brief Job state shared between the caller and the writer threads.
+ */
+struct fillfs_job {
+    char        filename[MAX_FILENAME_LENGTH]; ///< Path to file to fill/overwrite
+    size_t      file_size;      ///< Desired size in bytes (or min with file if existing)
+    size_t      size_cap;       ///< Largest size a phase may write to (an existing file's size)
+    size_t      block_size;     ///< Write in these chunks
+    const datagen_t *gen;       ///< Content generator for the write buffer
+    uint64_t    seed;           ///< Generator seed (fixed for the life of the job)
+    void       *buffer;         ///< block_size bytes of generated data, shared by all writers
+                                ///< (a read-only mapping of the zero page for zero data)
+    size_t      known_free_space; ///< For better progress calc if file_size == SIZE_MAX
+    const io_engine_t *engine;  ///< I/O engine used for every file operation
+    unsigned    iodepth;        ///< Writes kept in flight per writer thread
+    unsigned    threads;        ///< Writer threads started (workers[0..threads-1])
+    unsigned    max_threads;    ///< Capacity of workers[]
+    volatile unsigned active_threads; ///< Writers allowed to write; the rest hold
+    volatile int paused;        ///< fillfs_job_pause(): no writer may queue writes
+    uint64_t    pause_start_ns; ///< When the writers drained for the current pause, 0 while draining (under lock)
+    unsigned    held_writers;   ///< Writers drained and waiting in writer_hold() (under lock)
+    uint64_t    paused_ns;      ///< Total time of finished pauses (under lock)
+    int         existing_file;  ///< 1 if user gave us an existing file, 0 if hidden-file
+    int         low_priority;   ///< Drop writers to nice 19 / idle I/O class
+    int         keep_file;      ///< Don't unlink the hidden file on destroy
+    int         anon_fd;        ///< Anonymous (O_TMPFILE) fill file, or -1
+    int         anon_linked;    ///< The anonymous file was also linked at <dir>/.fillfs
+    char        owner_path[MAX_FILENAME_LENGTH + sizeof(OWNER_SUFFIX)]; ///< Owner record of a named fill file
+    int         owner_written;  ///< owner_path was written by this job
+    int         persistent;     ///< Writers park between phases instead of exiting
+    int         hw_counters;    ///< Writers open perf_event hardware counters
+
+    volatile size_t total_written; ///< Shared progress: how many bytes have been written
+    volatile int    done;          ///< 1 when all writer threads have finished
+    volatile int    error;         ///< Non-zero if error
+    volatile int    disk_full;     ///< A writer saw ENOSPC
+    volatile int    cancelled;     ///< fillfs_job_cancel() was called
+    fillfs_state_t  state;
+
+    size_t      next_offset;    ///< Next unclaimed file offset (atomic)
+    size_t      range_start;    ///< First offset of the current pass
+    int         random_order;   ///< Write the blocks of the pass in a permuted order
+    uint64_t    order_key;      ///< Permutation of the current pass
+    size_t      file_extent;    ///< Highest file offset written so far (atomic)
+    volatile int stop;          ///< Set on ENOSPC, error or cancel: claim no further blocks
+    unsigned    running;        ///< Writer threads still running (atomic)
+    pthread_mutex_t lock;       ///< Protects first_open_done and the phase fields below
+    pthread_cond_t  cond;       ///< Signalled when any of them changes
+    int         first_open_done; ///< Writer 0 has created/truncated the file
+    unsigned    idle_writers;   ///< Persistent writers parked since the last phase started
+    unsigned    generation;     ///< Bumped by fillfs_job_continue() to wake parked writers
+    int         shutdown;       ///< Parked writers should exit
+
+    volatile uint64_t rate_limit; ///< Aggregate write rate in bytes/s, 0 = unlimited
+    pthread_mutex_t rate_lock;  ///< Protects rate_next_ns
+    uint64_t    rate_next_ns;   ///< Earliest start of the next rate-limited write
+
+    uint64_t    phase_start_ns; ///< When the current phase was started (0 = first phase)
+    size_t      phase_base;     ///< total_written at the start of the current phase
+    uint64_t    phase_paused_ns; ///< Paused time at the start of the current phase
+    struct fill_worker *workers;
+    uint64_t    launch_ns;      ///< When fillfs_job_start() was called
+
+    fillfs_progress_cb progress_cb;  ///< Subscriber, or NULL
+    void       *progress_user;
+    unsigned    progress_interval_ms;
+    pthread_t   progress_tid;
+
+    uint64_t    start_ns;       ///< Earliest writer start (after buffer setup and open)
+    uint64_t    end_ns;         ///< Latest writer end (after the final fsync)
+    lat_hist_t  write_lat;      ///< Per-write latency histogram (merged after join)
+    lat_hist_t  phase_lat;      ///< Scratch histogram for fillfs_job_wait_phase()
+    cpu_cost_t  setup_cpu;      ///< Generating the data buffer in fillfs_job_start()
+    cpu_cost_t  cpu;            ///< Writer CPU cost (merged after join / per phase)
+
+    char       *trace_path;     ///< Chrome trace output, or NULL
+    unsigned    trace_sample;   ///< Trace one write in this many
+    trace_buf_t *trace;         ///< Spans of the controlling thread (start, phases, join, cleanup)
+    trace_buf_t **trace_bufs;   ///< trace, then one buffer per writer (outlive the workers)
+    unsigned    trace_nbufs;
+
+    uint64_t    stall_ns;       ///< Watchdog threshold for a write in flight, 0 = off
+    int         stall_dump;     ///< Dump kernel stacks and device in-flight counts on a stall
+    unsigned    dev_major;      ///< Device holding the fill file
+    unsigned    dev_minor;
+    char        dev_name[64];   ///< Its block device name, or "major:minor"
+    pthread_t   monitor_tid;    ///< Samples the timeline and watches for stalls
+    int         monitor_running;
+    unsigned    stalls;         ///< Stalls detected so far (under lock)
+    uint64_t    stalled_ns;     ///< Total duration of finished stalls (under lock)
+    volatile uint64_t stall_age_ns; ///< Age of the oldest stalled write right now, 0 if none
+
+    timeline_t  timeline;       ///< Bytes written per second while writing (under lock)
+    uint64_t    sample_ns;      ///< Start of the current timeline interval, 0 = none yet
+    size_t      sample_bytes;   ///< total_written at sample_ns
+    uint64_t    sample_paused;  ///< Paused time at sample_ns
+    int         sample_active;  ///< Writers were neither paused nor parked at sample_ns
+
+    double      profile_step;   ///< Fill-level profile bucket width in percent of capacity, 0 = off
+    fillfs_level_stats_t *profile; ///< Closed fill-level buckets (under lock)
+    unsigned    profile_n;
+    unsigned    profile_cap;
+    int         profile_level;  ///< Bucket index of the open bucket, -1 = none yet
+    double      profile_from;   ///< Fill level when the open bucket started
+    uint64_t    profile_start_ns;
+    uint64_t    profile_paused; ///< Paused time when the open bucket started
+    size_t      profile_bytes;  ///< total_written when the open bucket started
+    lat_hist_t *profile_mark;   ///< Cumulative write latencies when the open bucket started
+    lat_hist_t *profile_cur;    ///< Scratch for the current cumulative histogram
+
+    int         read_fd;        ///< Background reader's file, or -1
+    int         read_direct;    ///< read_fd was opened with O_DIRECT
+    size_t      read_size;      ///< Bytes per read
+    size_t      read_blocks;    ///< read_size blocks in the file
+    unsigned    read_iops;      ///< Reads per second, 0 = back to back
+    int         read_seq;       ///< Read the blocks in order instead of at random
+    pthread_t   reader_tid;
+    int         reader_running;
+    lat_hist_t  read_lat;       ///< Latency of the background reads (reader only; live readable)
+    uint64_t    read_bytes;     ///< Bytes read (atomic)
+    uint64_t    read_errors;    ///< Failed reads (atomic)
+};
+
+/**
+ * @brief Per-thread writer state.
+ */
+typedef struct fill_worker {
+    fillfs_job_t *job;          ///< Shared job
+    unsigned    index;          ///< Writer number, 0..threads-1
+    pthread_t   tid;
+    uint64_t    start_ns;
+    uint64_t    end_ns;
+    lat_hist_t  write_lat;      ///< Submit-to-completion latency of this writer's writes
+    cpu_cost_t  cpu;            ///< CPU cost of this writer, drained like write_lat
+    cpu_sample_t cpu_mark;      ///< Sample at the start of the current pass
+    uint64_t    syscalls_mark;  ///< file.syscalls at the start of the current pass
+    hw_counters_t hw;           ///< This thread's hardware counters, if enabled
+    trace_buf_t *trace;         ///< This writer's spans, or NULL when not tracing
+    unsigned    trace_count;    ///< Writes queued, for sampling
+
+    io_file_t   file;           ///< Target as opened through the job's engine
+    io_req_t   *reqs;           ///< iodepth request slots
+    io_req_t  **idle;           ///< Free request slots
+    io_req_t  **batch;          ///< Requests waiting to be submitted
+    io_req_t  **done;           ///< Completions returned by reap
+    unsigned    n_idle;
+    unsigned    n_batch;
+    unsigned    in_flight;
+    pid_t       os_tid;         ///< Kernel thread id, for the watchdog's stack dump
+    uint64_t    stall_since_ns; ///< Submit time of the write that started the current stall, 0 if none
+} fill_worker_t;
+
+/**
+ * @brief Deal with a fill file left in the target directory by an earlier run.
+ *
+ * A leftover whose owner record names a dead process (or an earlier boot),
+ * or that has no record, is truncated and removed here, with the time it
+ * took reported, instead of being freed silently inside a later O_TRUNC
+ * open. One that a running fillfs is still writing is left alone.
+ *
+ * @return int 0 if the directory is free to use, -EBUSY if a live fill owns it.
+ */
+static int reclaim_stale(const char *filename, const char *owner_path) {
+    struct stat st;
+    if (lstat(filename, &st) == -1 || !S_ISREG(st.st_mode)) {
+        unlink(owner_path);  // A record without its fill file is meaningless
+        return 0;
+    }
+
+    owner_t owner;
+    owner_state_t state = owner_check(owner_path, &owner);
+    if (state == OWNER_LIVE) {
+        fprintf(stderr, "Error: '%s' is being filled by a running fillfs (pid %d).\n",
+                filename, (int)owner.pid);
+        return -EBUSY;
+    }
+
+    uint64_t t0 = now_ns();
+    int fd = open(filename, O_WRONLY | O_CLOEXEC);
+    if (fd != -1) {
+        if (ftruncate(fd, 0) == -1) {
+            perror("ftruncate");
+        }
+        close(fd);
+    }
+    unlink(filename);
+    unlink(owner_path);
+
+    char who[64] = "no owner record";
+    if (state == OWNER_DEAD && owner.pid > 0) {
+        snprintf(who, sizeof(who), "left by pid %d", (int)owner.pid);
+    }
+    fprintf(stderr, "Reclaimed stale fill file '%s' (%.2f MB, %s) in %.1f ms.\n",
+            filename, (double)st.st_blocks * 512.0 / (1024.0 * 1024.0), who,
+            (double)(now_ns() - t0) / 1e6);
+    return 0;
+}
+
+/**
+ * @brief Create the directory-mode fill file anonymously with O_TMPFILE.
+ *
+ * The file has no name, so the kernel releases its space when the last
+ * descriptor closes, however the process ends. Writers, truncate and verify
+ * reopen it through /proc/self/fd. With LINK it is also given the usual
+ * name, for debugging.
+ *
+ * @return int 0 on success, -1 if unsupported (the caller uses a named file).
+ */
+static int open_anonymous(fillfs_job_t *job, const char *dir, int link) {
+#ifdef O_TMPFILE
+    int fd = open(dir, O_TMPFILE | O_RDWR | O_CLOEXEC, 0666);
+    if (fd == -1) {
+        return -1;  // Filesystem (or kernel) without O_TMPFILE support
+    }
+    char proc[64];
+    snprintf(proc, sizeof(proc), "/proc/self/fd/%d", fd);
+    if (access(proc, W_OK) == -1) {
+        close(fd);  // No /proc: the writers could not reopen it
+        return -1;
+    }
+    if (link) {
+        if (linkat(AT_FDCWD, proc, AT_FDCWD, job->filename, AT_SYMLINK_FOLLOW) == 0) {
+            job->anon_linked = 1;
+        } else {
+            fprintf(stderr, "Warning: Cannot link the fill file at %s (%s); it stays anonymous.\n",
+                    job->filename, strerror(errno));
+        }
+    }
+    if (!job->anon_linked) {
+        snprintf(job->filename, sizeof(job->filename), "%s", proc);
+    }
+    job->anon_fd = fd;
+    return 0;
+#else
+    (void)job;
+    (void)dir;
+    (void)link;
+    return -1;
+#endif
+}
+
+/**
+ * @brief Raise *extent to at least END (lock-free maximum).
+ */
+static void atomic_max(size_t *extent, size_t end) {
+    size_t cur = __atomic_load_n(extent, __ATOMIC_RELAXED);
+    while (cur < end &&
+           !__atomic_compare_exchange_n(extent, &cur, end, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+/**
+ * @brief Wait until the job's rate limit allows LEN more bytes to be queued.
+ *
+ * Writers reserve consecutive slots on one shared timeline, so the aggregate
+ * rate holds however many threads and requests in flight there are. Unused
+ * time is not banked: after an idle period the next write starts a new slot.
+ */
+static void throttle(fillfs_job_t *job, size_t len, trace_buf_t *trace) {
+    uint64_t rate = job->rate_limit;
+    if (rate == 0) {
+        return;
+    }
+
+    uint64_t cost = (uint64_t)((double)len * 1e9 / (double)rate);
+    pthread_mutex_lock(&job->rate_lock);
+    uint64_t now = now_ns();
+    if (job->rate_next_ns < now) {
+        job->rate_next_ns = now;
+    }
+    uint64_t start = job->rate_next_ns;
+    job->rate_next_ns += cost;
+    pthread_mutex_unlock(&job->rate_lock);
+
+    // Sleep in short steps so a stop request or a new rate takes effect quickly
+    uint64_t entered = now;
+    while (!job->stop && (now = now_ns()) < start) {
+        uint64_t wait = start - now;
+        struct timespec ts = { 0, (long)((wait < 100000000ULL) ? wait : 100000000ULL) };
+        nanosleep(&ts, NULL);
+    }
+    if (TRACE_ON(trace) && now > entered) {
+        trace_span(trace, TR_THROTTLE, entered, now, 0, 0);
+    }
+}
+
+/**
+ * @brief Map INDEX to a pseudo-random position in [0, N), one-to-one for a
+ *        given KEY, without a table: a four-round Feistel network over the
+ *        next even power of two, re-applied to values that land outside the
+ *        range (cycle walking, under four rounds on average).
+ */
+static uint64_t permute_index(uint64_t index, uint64_t n, uint64_t key) {
+    unsigned bits = 2;
+    while (bits < 64 && (1ULL << bits) < n) {
+        bits += 2;
+    }
+    unsigned half = bits / 2;
+    uint64_t mask = (1ULL << half) - 1;
+    uint64_t x = index;
+    do {
+        uint64_t l = x >> half, r = x & mask;
+        for (uint64_t round = 0; round < 4; ++round) {
+            uint64_t t = l ^ (mix64(r ^ key ^ (round << 60)) & mask);
+            l = r;
+            r = t;
+        }
+        x = (l << half) | r;
+    } while (x >= n);
+    return x;
+}
+
+/**
+ * @brief Claim the next block of the target for a writer.
+ *
+ * Writers share a single cursor, so the file is written front to back no
+ * matter how many threads or requests in flight there are.
+ *
+ * @return int 1 with offset and len set, or 0 if there is nothing left to write.
+ */
+static int claim_block(fillfs_job_t *job, size_t *offset, size_t *len) {
+    if (job->stop) {
+        return 0;
+    }
+    size_t off = __atomic_fetch_add(&job->next_offset, job->block_size, __ATOMIC_RELAXED);
+    if (off >= job->file_size) {
+        return 0;
+    }
+    if (job->random_order && job->file_size != SIZE_MAX) {
+        // The cursor still counts blocks in order; write the permuted one
+        uint64_t blocks = (job->file_size - job->range_start + job->block_size - 1) / job->block_size;
+        uint64_t index  = (off - job->range_start) / job->block_size;
+        off = job->range_start + (size_t)permute_index(index, blocks, job->order_key) * job->block_size;
+    }
+    *offset = off;
+    *len    = (job->file_size - off < job->block_size) ? job->file_size - off : job->block_size;
+    return 1;
+}
+
+/**
+ * @brief Start the pause clock once every writer has drained its writes in
+ *        flight (held, parked or finished). Called with the lock held.
+ *
+ * Until then the pause is only requested: writes still completing count as
+ * active time, not paused time.
+ */
+static void pause_check_drained(fillfs_job_t *job) {
+    if (job->paused && job->pause_start_ns == 0 &&
+        job->held_writers + job->idle_writers >= job->running) {
+        __atomic_store_n(&job->pause_start_ns, now_ns(), __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * @brief Whether a writer must hold off queueing writes (paused, or surplus to
+ *        the active thread count) while there is still work left in the pass.
+ */
+static int writer_held(const fill_worker_t *worker) {
+    const fillfs_job_t *job = worker->job;
+    return (job->paused || worker->index >= job->active_threads) && !job->stop &&
+           __atomic_load_n(&job->next_offset, __ATOMIC_RELAXED) < job->file_size;
+}
+
+/**
+ * @brief Sleep while the writer is held, in short steps like throttle().
+ */
+static void writer_hold(fill_worker_t *worker) {
+    fillfs_job_t *job = worker->job;
+    uint64_t t0 = now_ns();
+
+    pthread_mutex_lock(&job->lock);
+    job->held_writers++;
+    pause_check_drained(job);
+    pthread_mutex_unlock(&job->lock);
+
+    while (writer_held(worker)) {
+        struct timespec ts = { 0, 50000000L };
+        nanosleep(&ts, NULL);
+    }
+
+    pthread_mutex_lock(&job->lock);
+    job->held_writers--;
+    pthread_mutex_unlock(&job->lock);
+    if (TRACE_ON(worker->trace)) {
+        trace_span(worker->trace, TR_HOLD, t0, now_ns(), 0, 0);
+    }
+}
+
+/**
+ * @brief Write until the current target is covered, the disk is full or an error occurs.
+ *
+ * Keeps up to job->iodepth writes in flight through the job's engine. Short
+ * writes count as progress and the remainder of the block is resubmitted.
+ * Returns with nothing in flight.
+ */
+static void writer_pass(fill_worker_t *worker) {
+    fillfs_job_t *params = worker->job;
+    const io_engine_t *engine = params->engine;
+    io_file_t *file = &worker->file;
+
+    for (;;) {
+        // Queue new blocks behind any short-write remainders already in the batch
+        size_t offset, len;
+        while (worker->n_idle > 0 && !writer_held(worker) && claim_block(params, &offset, &len)) {
+            throttle(params, len, worker->trace);
+            io_req_t *req = worker->idle[--worker->n_idle];
+            req->buf    = params->buffer;
+            req->len    = len;
+            req->offset = (off_t)offset;
+            if (TRACE_ON(worker->trace)) {
+                // Mark a sample of the writes to be traced individually
+                req->user = (++worker->trace_count % params->trace_sample == 0) ? req : NULL;
+            }
+            worker->batch[worker->n_batch++] = req;
+        }
+
+        // Submit the batch
+        unsigned sent = 0;
+        while (sent < worker->n_batch) {
+            uint64_t t0 = now_ns();
+            for (unsigned i = sent; i < worker->n_batch; ++i) {
+                __atomic_store_n(&worker->batch[i]->submit_ns, t0, __ATOMIC_RELAXED);
+            }
+            int rc = engine->submit(file, worker->batch + sent, worker->n_batch - sent);
+            if (TRACE_ON(worker->trace)) {
+                trace_span(worker->trace, TR_SUBMIT, t0, now_ns(), 0, rc);
+            }
+            if (rc == -1) {
+                if (errno == EAGAIN && worker->in_flight > 0) {
+                    break;  // Queue full: reap first, resubmit the rest afterwards
+                }
+                perror("write");
+                params->error = 1;
+                params->stop  = 1;
+                for (unsigned i = sent; i < worker->n_batch; ++i) {
+                    worker->idle[worker->n_idle++] = worker->batch[i];
+                }
+                sent = worker->n_batch;
+                break;
+            }
+            sent              += (unsigned)rc;
+            worker->in_flight += (unsigned)rc;
+        }
+        memmove(worker->batch, worker->batch + sent, (worker->n_batch - sent) * sizeof(*worker->batch));
+        worker->n_batch -= sent;
+
+        if (worker->in_flight == 0) {
+            if (worker->n_batch == 0) {
+                if (!writer_held(worker)) {
+                    return;  // Nothing in flight and nothing left to submit
+                }
+                writer_hold(worker);  // Drained; wait for resume or more threads
+            }
+            continue;
+        }
+
+        // Reap at least one completion
+        uint64_t t_reap = TRACE_ON(worker->trace) ? now_ns() : 0;
+        int n_done = engine->reap(file, worker->done, 1, worker->in_flight);
+        if (n_done == -1) {
+            perror("reap");
+            params->error = 1;
+            params->stop  = 1;
+            return;
+        }
+        uint64_t t1 = now_ns();
+        worker->in_flight -= (unsigned)n_done;
+        if (TRACE_ON(worker->trace)) {
+            trace_span(worker->trace, TR_REAP, t_reap, t1, 0, n_done);
+        }
+
+        for (int i = 0; i < n_done; ++i) {
+            io_req_t *req = worker->done[i];
+            lat_hist_add(&worker->write_lat, t1 - req->submit_ns);
+            if (TRACE_ON(worker->trace) && req->user) {
+                trace_span(worker->trace, TR_IO, req->submit_ns, t1, (uint64_t)req->offset, req->result);
+                req->user = NULL;
+            }
+            // Not in flight any more, as far as the watchdog is concerned
+            __atomic_store_n(&req->submit_ns, 0, __ATOMIC_RELAXED);
+
+            if (req->result < 0) {
+                if (req->result == -ENOSPC) {
+                    // Disk full is the normal end of a directory fill
+                    params->disk_full = 1;
+                } else {
+                    errno = (int)-req->result;
+                    perror("write");
+                    params->error = 1;
+                }
+                params->stop = 1;
+                worker->idle[worker->n_idle++] = req;
+                continue;
+            }
+
+            __atomic_add_fetch(&params->total_written, (size_t)req->result, __ATOMIC_RELAXED);
+            atomic_max(&params->file_extent, (size_t)req->offset + (size_t)req->result);
+
+            if (req->result == 0) {
+                // No progress possible at this offset; treat like a full disk
+                params->stop = 1;
+                worker->idle[worker->n_idle++] = req;
+            } else if ((size_t)req->result < req->len && !params->stop) {
+                // Short write: resubmit the rest of the block
+                req->buf     = (const char*)req->buf + req->result;
+                req->len    -= (size_t)req->result;
+                req->offset += (off_t)req->result;
+                worker->batch[worker->n_batch++] = req;
+            } else {
+                worker->idle[worker->n_idle++] = req;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Charge the CPU time and system calls since the last mark to the writer.
+ */
+static void writer_account(fill_worker_t *worker) {
+    cpu_sample_t now;
+    cpu_sample(&now, &worker->hw);
+    cpu_cost_add_delta(&worker->cpu, &worker->cpu_mark, &now);
+    worker->cpu.syscalls += worker->file.syscalls - worker->syscalls_mark;
+    worker->syscalls_mark = worker->file.syscalls;
+    worker->cpu_mark      = now;
+}
+
+/**
+ * @brief Park a persistent writer until the next phase or shutdown.
+ *
+ * @return int 1 if a new phase started, 0 if the job is shutting down.
+ */
+static int writer_park(fill_worker_t *worker, unsigned *generation) {
+    fillfs_job_t *job = worker->job;
+
+    pthread_mutex_lock(&job->lock);
+    job->idle_writers++;
+    pause_check_drained(job);
+    pthread_cond_broadcast(&job->cond);
+    while (job->generation == *generation && !job->shutdown) {
+        pthread_cond_wait(&job->cond, &job->lock);
+    }
+    *generation = job->generation;
+    int resume = !job->shutdown;
+    pthread_mutex_unlock(&job->lock);
+    return resume;
+}
+
+/**
+ * @brief Thread function that fills (or overwrites) the file until file_size is reached or ENOSPC.
+ *
+ * A persistent job keeps the writer, its buffer and its open file across
+ * phases: after each pass it parks until fillfs_job_continue() or shutdown.
+ *
+ * @param arg Pointer to fill_worker_t for this writer.
+ * @return void* Not used. The last writer to finish sets job->done.
+ */
+static void* fill_file_thread(void *arg) {
+    fill_worker_t *worker = (fill_worker_t*)arg;
+    fillfs_job_t *params = worker->job;
+    const io_engine_t *engine = params->engine;
+    unsigned depth = params->iodepth;
+    int opened = 0;
+
+    // A writer added by fillfs_job_set_threads() joins the current phase
+    pthread_mutex_lock(&params->lock);
+    unsigned generation = params->generation;
+    pthread_mutex_unlock(&params->lock);
+
+    worker->file = (io_file_t){ .engine = engine, .fd = -1, .depth = depth };
+
+    for (int i = 0; i < HW_COUNTERS; ++i) {
+        worker->hw.fd[i] = -1;
+    }
+    if (params->hw_counters && hw_counters_open(&worker->hw) == -1 && worker->index == 0) {
+        fprintf(stderr, "Warning: Hardware counters unavailable (perf_event_open: %s).\n",
+                strerror(errno));
+    }
+    cpu_sample(&worker->cpu_mark, &worker->hw);
+
+    if (params->low_priority) {
+        // Lower CPU priority:
+        setpriority(PRIO_PROCESS, 0, 19); // NICENESS=19 => lowest CPU scheduling priority
+
+#ifdef __linux__
+        // Also try to set I/O priority to idle class on Linux:
+        set_io_priority_idle();
+#endif
+    }
+
+#ifdef __linux__
+    worker->os_tid = (pid_t)syscall(SYS_gettid);
+#endif
+
+    // Allocate request slots (reqs is published under the lock for the watchdog)
+    io_req_t *reqs = calloc(depth, sizeof(*reqs));
+    pthread_mutex_lock(&params->lock);
+    worker->reqs   = reqs;
+    pthread_mutex_unlock(&params->lock);
+    worker->idle   = calloc(depth, sizeof(*worker->idle));
+    worker->batch  = calloc(depth, sizeof(*worker->batch));
+    worker->done   = calloc(depth, sizeof(*worker->done));
+    if (!worker->reqs || !worker->idle || !worker->batch || !worker->done) {
+        perror("malloc");
+        params->error = 1;
+        params->stop  = 1;
+    } else {
+        for (worker->n_idle = 0; worker->n_idle < depth; ++worker->n_idle) {
+            worker->idle[worker->n_idle] = &worker->reqs[worker->n_idle];
+        }
+    }
+
+    /*
+     * If it's an existing file, open for writing but do NOT truncate,
+     * because we only want to overwrite. If it's a hidden file in a directory,
+     * we can create/truncate as usual. Only writer 0 creates/truncates; the
+     * others open the result once it exists.
+     */
+    int open_flags = 0;
+    if (params->existing_file) {
+        // Overwrite existing file. No O_TRUNC => we won't shrink it on open.
+        open_flags = O_WRONLY;
+    } else {
+        // If it's a newly created hidden file, we do O_CREAT | O_TRUNC
+        open_flags = O_WRONLY | O_CREAT | O_TRUNC;
+    }
+
+    if (worker->index != 0) {
+        pthread_mutex_lock(&params->lock);
+        while (!params->first_open_done) {
+            pthread_cond_wait(&params->cond, &params->lock);
+        }
+        pthread_mutex_unlock(&params->lock);
+        open_flags &= ~(O_CREAT | O_TRUNC);
+    }
+
+    if (!params->error) {
+        uint64_t t0 = now_ns();
+        if (engine->open(&worker->file, params->filename, open_flags, 0666) == -1) {
+            perror("open");
+            params->error = 1;
+            params->stop  = 1;
+        } else {
+            opened = 1;
+        }
+        if (TRACE_ON(worker->trace)) {
+            trace_span(worker->trace, TR_OPEN, t0, now_ns(), 0, 0);
+        }
+    }
+
+    if (worker->index == 0) {
+        pthread_mutex_lock(&params->lock);
+        params->first_open_done = 1;
+        pthread_cond_broadcast(&params->cond);
+        pthread_mutex_unlock(&params->lock);
+    }
+
+    worker->start_ns = now_ns();
+    worker->end_ns   = worker->start_ns;
+
+    while (opened) {
+        // Perform writes until the target is covered, the disk is full or an error occurs
+        writer_pass(worker);
+
+        // Flush, except a cancelled temporary file that is about to be removed:
+        // waiting for its writeback would only delay the shutdown
+        uint64_t t_sync = now_ns();
+        int discard = params->cancelled && !params->existing_file && !params->keep_file;
+        if (!discard && engine->sync(&worker->file) == -1) {
+            perror("fsync");
+            params->error = 1;
+        }
+        worker->end_ns = now_ns();
+        if (TRACE_ON(worker->trace)) {
+            trace_span(worker->trace, TR_FSYNC, t_sync, worker->end_ns, 0, 0);
+        }
+        writer_account(worker);
+
+        if (!params->persistent || params->error) {
+            break;
+        }
+        uint64_t t_park = now_ns();
+        int resume = writer_park(worker, &generation);
+        if (TRACE_ON(worker->trace)) {
+            trace_span(worker->trace, TR_PARK, t_park, now_ns(), 0, 0);
+        }
+        if (!resume) {
+            break;
+        }
+        cpu_sample(&worker->cpu_mark, &worker->hw);
+    }
+
+    if (opened) {
+        uint64_t t0 = now_ns();
+        engine->close(&worker->file);
+        if (TRACE_ON(worker->trace)) {
+            trace_span(worker->trace, TR_CLOSE, t0, now_ns(), 0, 0);
+        }
+    } else {
+        writer_account(worker);
+    }
+    hw_counters_close(&worker->hw);
+
+    free(worker->done);
+    free(worker->batch);
+    free(worker->idle);
+
+    // Mark done once the last writer finishes
+    pthread_mutex_lock(&params->lock);
+    free(worker->reqs);
+    worker->reqs = NULL;
+    if (--params->running == 0) {
+        params->done = 1;
+    }
+    pause_check_drained(params);
+    pthread_cond_broadcast(&params->cond);
+    pthread_mutex_unlock(&params->lock);
+    return NULL;
+}
+
+/**
+ * @brief Take a progress snapshot (shared by the poll and subscribe paths).
+ */
+void fillfs_job_progress(const fillfs_job_t *job, fillfs_progress_t *progress) {
+    memset(progress, 0, sizeof(*progress));
+    progress->state         = job->done ? FILLFS_STATE_DONE : job->state;
+    if (progress->state == FILLFS_STATE_RUNNING && job->persistent &&
+        __atomic_load_n(&job->idle_writers, __ATOMIC_RELAXED) == job->threads) {
+        progress->state = FILLFS_STATE_IDLE;
+    } else if (progress->state == FILLFS_STATE_RUNNING && job->paused &&
+               __atomic_load_n(&job->pause_start_ns, __ATOMIC_RELAXED)) {
+        progress->state = FILLFS_STATE_PAUSED;  // Requested and drained
+    }
+    progress->bytes_written = job->total_written;
+    progress->error         = job->error;
+    progress->disk_full     = job->disk_full;
+    progress->target_bytes  = (job->file_size != SIZE_MAX) ? job->file_size : job->known_free_space;
+    progress->rate_limit    = job->rate_limit;
+    progress->threads       = job->active_threads;
+
+    // Unlocked read: a pause starting or ending right now may be missed by one snapshot
+    uint64_t paused_ns = __atomic_load_n(&job->paused_ns, __ATOMIC_RELAXED);
+    uint64_t since = __atomic_load_n(&job->pause_start_ns, __ATOMIC_RELAXED);
+    if (job->paused && since) {
+        uint64_t now = now_ns();
+        paused_ns += (now > since) ? now - since : 0;
+    }
+    progress->paused_s      = (double)paused_ns / 1e9;
+    progress->stall_s       = (double)job->stall_age_ns / 1e9;
+    if (job->launch_ns) {
+        progress->elapsed_s = (double)(now_ns() - job->launch_ns) / 1e9;
+    }
+}
+
+/**
+ * @brief Subscriber thread: deliver snapshots every interval until the writers finish.
+ */
+static void *progress_thread(void *arg) {
+    fillfs_job_t *job = (fillfs_job_t*)arg;
+    fillfs_progress_t progress;
+    uint64_t interval_ns = (uint64_t)job->progress_interval_ms * 1000000ULL;
+    uint64_t next = now_ns() + interval_ns;
+
+    while (!job->done) {
+        // Sleep in short steps so the final snapshot follows completion closely
+        uint64_t now = now_ns();
+        if (now >= next) {
+            fillfs_job_progress(job, &progress);
+            job->progress_cb(&progress, job->progress_user);
+            next += interval_ns;
+            continue;
+        }
+        uint64_t wait = next - now;
+        struct timespec ts = { 0, (long)((wait < 50000000ULL) ? wait : 50000000ULL) };
+        nanosleep(&ts, NULL);
+    }
+
+    fillfs_job_progress(job, &progress);
+    job->progress_cb(&progress, job->progress_user);
+    return NULL;
+}
+
+/**
+ * @brief Total time the job has spent paused, including a pause in progress.
+ *        Called with the lock held.
+ */
+static uint64_t paused_total_ns(const fillfs_job_t *job) {
+    return job->paused_ns + ((job->paused && job->pause_start_ns) ? now_ns() - job->pause_start_ns : 0);
+}
+
+/**
+ * @brief Name the block device holding the fill file, from its st_dev.
+ *
+ * Uses DEVNAME from /sys/dev/block/M:m/uevent; filesystems without a block
+ * device (tmpfs, NFS) keep the "major:minor" form.
+ */
+static void describe_device(fillfs_job_t *job, dev_t dev) {
+    job->dev_major = major(dev);
+    job->dev_minor = minor(dev);
+    snprintf(job->dev_name, sizeof(job->dev_name), "%u:%u", job->dev_major, job->dev_minor);
+
+    char path[64], line[128];
+    snprintf(path, sizeof(path), "/sys/dev/block/%u:%u/uevent", job->dev_major, job->dev_minor);
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        return;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, "DEVNAME=", 8) == 0) {
+            line[strcspn(line, "\n")] = '\0';
+            snprintf(job->dev_name, sizeof(job->dev_name), "%.*s",
+                     (int)sizeof(job->dev_name) - 1, line + 8);
+            break;
+        }
+    }
+    fclose(f);
+}
+
+/**
+ * @brief Copy a small /proc or /sys file to stderr, each line prefixed with PREFIX.
+ */
+static void dump_file(const char *path, const char *prefix) {
+    char line[256];
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "%s%s: %s\n", prefix, path, strerror(errno));
+        return;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        fprintf(stderr, "%s%s", prefix, line);
+    }
+    fclose(f);
+}
+
+/**
+ * @brief The --stall-dump part of a stall report: the device's in-flight
+ *        counts and the kernel stack of every thread of the process.
+ */
+static void stall_dump(const fillfs_job_t *job) {
+    char path[320];
+    snprintf(path, sizeof(path), "/sys/dev/block/%u:%u/inflight", job->dev_major, job->dev_minor);
+    if (access(path, R_OK) == 0) {
+        fprintf(stderr, "  %s in flight (reads writes):\n", job->dev_name);
+        dump_file(path, "    ");
+    }
+
+    // Kernel stacks need CAP_SYS_ADMIN; without it each read reports the error
+    DIR *dir = opendir("/proc/self/task");
+    if (!dir) {
+        return;
+    }
+    struct dirent *de;
+    while ((de = readdir(dir)) != NULL) {
+        // Skip the watchdog itself
+        if (de->d_name[0] == '.' || atoi(de->d_name) == (int)syscall(SYS_gettid)) {
+            continue;
+        }
+        char comm[32] = "";
+        snprintf(path, sizeof(path), "/proc/self/task/%s/comm", de->d_name);
+        FILE *f = fopen(path, "r");
+        if (f) {
+            if (fgets(comm, sizeof(comm), f)) {
+                comm[strcspn(comm, "\n")] = '\0';
+            }
+            fclose(f);
+        }
+        fprintf(stderr, "  task %s (%s) kernel stack:\n", de->d_name, comm);
+        snprintf(path, sizeof(path), "/proc/self/task/%s/stack", de->d_name);
+        dump_file(path, "    ");
+    }
+    closedir(dir);
+}
+
+/**
+ * @brief A writer stall that started or cleared in one watchdog pass.
+ */
+typedef struct {
+    unsigned writer;
+    pid_t    tid;
+    off_t    offset;            ///< Oldest write in flight (started stalls)
+    size_t   len;
+    unsigned in_flight;
+    uint64_t age_ns;            ///< Age of that write, or duration of a cleared stall
+    int      cleared;
+} stall_event_t;
+
+/**
+ * @brief One watchdog pass: find each writer's oldest write in flight and
+ *        record stalls that start or end in EVENTS (room for max_threads).
+ *        Called with the lock held, which keeps the writers' request slots
+ *        from being freed under the scan; report the events after releasing
+ *        it with watchdog_report().
+ *
+ * @return unsigned Number of events.
+ */
+static unsigned watchdog_scan(fillfs_job_t *job, uint64_t now, stall_event_t *events) {
+    uint64_t worst = 0;
+    unsigned n = 0;
+
+    for (unsigned w = 0; w < job->threads; ++w) {
+        fill_worker_t *worker = &job->workers[w];
+
+        // Slots are submitted and reaped without the lock: read each once.
+        // A writer that has exited (reqs == NULL) has nothing in flight.
+        uint64_t oldest = 0;
+        off_t offset = 0;
+        size_t len = 0;
+        unsigned in_flight = 0;
+        for (unsigned i = 0; worker->reqs && i < job->iodepth; ++i) {
+            io_req_t *req = &worker->reqs[i];
+            uint64_t t = __atomic_load_n(&req->submit_ns, __ATOMIC_RELAXED);
+            if (t == 0) {
+                continue;
+            }
+            in_flight++;
+            if (oldest == 0 || t < oldest) {
+                oldest = t;
+                offset = __atomic_load_n(&req->offset, __ATOMIC_RELAXED);
+                len    = __atomic_load_n(&req->len, __ATOMIC_RELAXED);
+            }
+        }
+
+        uint64_t age = (oldest && now > oldest) ? now - oldest : 0;
+        if (age >= job->stall_ns) {
+            if (age > worst) {
+                worst = age;
+            }
+            if (worker->stall_since_ns == 0) {
+                worker->stall_since_ns = oldest;
+                job->stalls++;
+                events[n++] = (stall_event_t){ w, worker->os_tid, offset, len, in_flight, age, 0 };
+            }
+        } else if (worker->stall_since_ns != 0) {
+            // The stalled write completed (or was resubmitted after a short write)
+            uint64_t took = now - worker->stall_since_ns;
+            job->stalled_ns += took;
+            worker->stall_since_ns = 0;
+            events[n++] = (stall_event_t){ w, worker->os_tid, 0, 0, 0, took, 1 };
+        }
+    }
+    job->stall_age_ns = worst;
+    return n;
+}
+
+/**
+ * @brief Print the events of a watchdog pass, and with --stall-dump one dump
+ *        if a stall started. Called without the lock: the dump reads every
+ *        thread's kernel stack, and writers must not wait on it.
+ */
+static void watchdog_report(const fillfs_job_t *job, const stall_event_t *events, unsigned n) {
+    int started = 0;
+    for (unsigned i = 0; i < n; ++i) {
+        const stall_event_t *ev = &events[i];
+        if (ev->cleared) {
+            fprintf(stderr, "Writer stall cleared: writer=%u device=%s duration_s=%.1f\n",
+                    ev->writer, job->dev_name, (double)ev->age_ns / 1e9);
+            continue;
+        }
+        started = 1;
+        fprintf(stderr,
+                "Warning: Writer stall: writer=%u tid=%d device=%s engine=%s offset=%lld "
+                "len=%zu age_s=%.1f in_flight=%u\n",
+                ev->writer, (int)ev->tid, job->dev_name, job->engine->name,
+                (long long)ev->offset, ev->len, (double)ev->age_ns / 1e9, ev->in_flight);
+    }
+    if (started && job->stall_dump) {
+        stall_dump(job);
+    }
+}
+
+/**
+ * @brief Close the current timeline interval and start the next one. The
+ *        interval is kept only if the writers were busy throughout: paused
+ *        or parked time would show up as a spurious slow phase.
+ *        Called with the lock held.
+ */
+static void timeline_sample(fillfs_job_t *job, uint64_t now) {
+    size_t   bytes  = job->total_written;
+    uint64_t paused = paused_total_ns(job);
+    int      active = !job->paused && !(job->persistent && job->idle_writers >= job->running);
+
+    if (job->sample_ns && job->sample_active && active && paused == job->sample_paused &&
+        now > job->sample_ns) {
+        timeline_add(&job->timeline, job->sample_ns - job->launch_ns, now - job->sample_ns,
+                     job->sample_bytes, bytes - job->sample_bytes);
+    }
+    job->sample_ns     = now;
+    job->sample_bytes  = bytes;
+    job->sample_paused = paused;
+    job->sample_active = active;
+}
+
+/**
+ * @brief Current fill level of the filesystem holding the fill file, in
+ *        percent of its statvfs total, or -1 if it cannot be read.
+ */
+static double fill_level(const fillfs_job_t *job) {
+    struct statvfs fs;
+    if (statvfs(job->filename, &fs) != 0 || fs.f_blocks == 0) {
+        return -1.0;
+    }
+    return 100.0 * (double)(fs.f_blocks - fs.f_bfree) / (double)fs.f_blocks;
+}
+
+/**
+ * @brief Cumulative write latencies of the job into DST: finished phases
+ *        in write_lat, the running one in the writers' histograms (as in
+ *        fillfs_job_latency()). Called with the lock held.
+ */
+static void profile_latencies(const fillfs_job_t *job, lat_hist_t *dst) {
+    memset(dst, 0, sizeof(*dst));
+    lat_hist_snapshot(dst, &job->write_lat);
+    for (unsigned i = 0; job->workers && i < job->threads; ++i) {
+        lat_hist_snapshot(dst, &job->workers[i].write_lat);
+    }
+}
+
+/**
+ * @brief Start a fill-level bucket at LEVEL percent. Called with the lock held.
+ */
+static void profile_open(fillfs_job_t *job, double level, uint64_t now) {
+    job->profile_level    = (int)(level / job->profile_step);
+    job->profile_from     = level;
+    job->profile_start_ns = now;
+    job->profile_paused   = paused_total_ns(job);
+    job->profile_bytes    = job->total_written;
+    profile_latencies(job, job->profile_mark);
+}
+
+/**
+ * @brief Close the open bucket at LEVEL percent and record its throughput
+ *        and latency percentiles. Called with the lock held.
+ */
+static void profile_close(fillfs_job_t *job, double level, uint64_t now) {
+    if (job->profile_n == job->profile_cap) {
+        unsigned cap = job->profile_cap ? job->profile_cap * 2 : 128;
+        fillfs_level_stats_t *p = realloc(job->profile, cap * sizeof(*p));
+        if (!p) {
+            return;
+        }
+        job->profile     = p;
+        job->profile_cap = cap;
+    }
+
+    lat_hist_t *lat = job->profile_cur;
+    profile_latencies(job, lat);
+    lat_hist_since(lat, job->profile_mark);
+
+    uint64_t paused  = paused_total_ns(job) - job->profile_paused;
+    uint64_t elapsed = now - job->profile_start_ns;
+    double   active  = (elapsed > paused) ? (double)(elapsed - paused) / 1e9 : 0.0;
+    size_t   bytes   = job->total_written - job->profile_bytes;
+
+    fillfs_level_stats_t *b = &job->profile[job->profile_n++];
+    b->from_pct        = job->profile_from;
+    b->to_pct          = level;
+    b->bytes           = bytes;
+    b->writes          = lat->count;
+    b->duration_s      = active;
+    b->throughput_mb_s = (active > 0.0) ? (double)bytes / (1024.0 * 1024.0) / active : 0.0;
+    b->lat_mean_us     = lat->count ? (double)lat->sum_ns / (double)lat->count / 1e3 : 0.0;
+    b->lat_p50_us      = lat_hist_percentile(lat, 50.0) / 1e3;
+    b->lat_p90_us      = lat_hist_percentile(lat, 90.0) / 1e3;
+    b->lat_p99_us      = lat_hist_percentile(lat, 99.0) / 1e3;
+    b->lat_max_us      = (double)lat->max_ns / 1e3;
+}
+
+/**
+ * @brief Check the fill level and move to a new bucket when it crosses a
+ *        step boundary. Called with the lock held.
+ */
+static void profile_sample(fillfs_job_t *job, uint64_t now) {
+    double level = fill_level(job);
+    if (level < 0.0) {
+        return;  // Not created yet
+    }
+    if (job->profile_level < 0) {
+        profile_open(job, level, now);
+    } else if ((int)(level / job->profile_step) != job->profile_level) {
+        profile_close(job, level, now);
+        profile_open(job, level, now);
+    }
+}
+
+/**
+ * @brief Monitor thread: sample the throughput timeline every second and,
+ *        if enabled, scan for stalls a few times per threshold and follow
+ *        the fill level for the profile, until the writers finish.
+ */
+static void *monitor_thread(void *arg) {
+    fillfs_job_t *job = (fillfs_job_t*)arg;
+    uint64_t step = TIMELINE_INTERVAL_NS;
+    if (job->stall_ns && job->stall_ns / 4 < step) {
+        step = (job->stall_ns / 4 > 10000000ULL) ? job->stall_ns / 4 : 10000000ULL;
+    }
+    if (job->profile_step > 0.0 && step > PROFILE_INTERVAL_NS) {
+        step = PROFILE_INTERVAL_NS;
+    }
+    stall_event_t events[job->max_threads];
+
+    pthread_mutex_lock(&job->lock);
+    timeline_sample(job, now_ns());
+    if (job->profile_step > 0.0) {
+        profile_sample(job, now_ns());
+    }
+    pthread_mutex_unlock(&job->lock);
+
+    while (!job->done) {
+        // Sleep in short steps so the thread exits soon after the writers
+        for (uint64_t slept = 0; slept < step && !job->done; slept += 50000000ULL) {
+            uint64_t wait = step - slept;
+            struct timespec ts = { 0, (long)((wait < 50000000ULL) ? wait : 50000000ULL) };
+            nanosleep(&ts, NULL);
+        }
+        uint64_t now = now_ns();
+        unsigned n_events = 0;
+        pthread_mutex_lock(&job->lock);
+        if (job->stall_ns) {
+            n_events = watchdog_scan(job, now, events);
+        }
+        if (now - job->sample_ns >= TIMELINE_INTERVAL_NS) {
+            timeline_sample(job, now);
+        }
+        if (job->profile_step > 0.0) {
+            profile_sample(job, now);
+        }
+        pthread_mutex_unlock(&job->lock);
+        watchdog_report(job, events, n_events);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Open the background reader's file, bypassing the page cache where
+ *        the filesystem allows it so that the reads reach the device.
+ *
+ * @return int 0 on success or a negative errno value.
+ */
+static int reader_open(fillfs_job_t *job, const fillfs_config_t *cfg) {
+    job->read_size = cfg->read_size ? cfg->read_size : DEFAULT_READ_SIZE;
+    job->read_iops = cfg->read_iops;
+    job->read_seq  = cfg->read_seq;
+
+    job->read_fd = open(cfg->read_path, O_RDONLY | O_DIRECT);
+    if (job->read_fd != -1 && job->read_size % 4096 == 0) {
+        job->read_direct = 1;
+    } else {
+        if (job->read_fd != -1) {
+            close(job->read_fd);
+        }
+        job->read_fd = open(cfg->read_path, O_RDONLY);
+        if (job->read_fd == -1) {
+            int err = errno;
+            perror(cfg->read_path);
+            return -err;
+        }
+        fprintf(stderr, "Warning: Reading '%s' without O_DIRECT; reads may be served "
+                        "from the page cache.\n", cfg->read_path);
+        posix_fadvise(job->read_fd, 0, 0, POSIX_FADV_RANDOM);
+    }
+
+    struct stat st;
+    if (fstat(job->read_fd, &st) == -1 || (size_t)st.st_size < job->read_size) {
+        fprintf(stderr, "Error: Read file '%s' must be at least %zu bytes.\n",
+                cfg->read_path, job->read_size);
+        close(job->read_fd);
+        job->read_fd = -1;
+        return -EINVAL;
+    }
+    job->read_blocks = (size_t)st.st_size / job->read_size;
+    return 0;
+}
+
+/**
+ * @brief Background reader: issue one read at a time at read_iops, at
+ *        random or in order, and time each, until the writers finish. When
+ *        it falls more than a second behind (the device stalled), the
+ *        schedule is reset rather than caught up in a burst.
+ */
+static void *reader_thread(void *arg) {
+    fillfs_job_t *job = (fillfs_job_t*)arg;
+    uint64_t interval = job->read_iops ? 1000000000ULL / job->read_iops : 0;
+    uint64_t next = now_ns();
+    uint64_t rng  = mix64(job->seed ^ 0x5265616465720000ULL);
+    size_t   pos  = 0;
+    void    *buf  = NULL;
+
+    if (posix_memalign(&buf, 4096, job->read_size) != 0) {
+        perror("malloc");
+        return NULL;
+    }
+
+    while (!job->done) {
+        if (interval) {
+            uint64_t now = now_ns();
+            if (next > now) {
+                uint64_t wait = next - now;
+                struct timespec ts = { 0, (long)((wait < 50000000ULL) ? wait : 50000000ULL) };
+                nanosleep(&ts, NULL);
+                continue;
+            }
+            if (now - next > 1000000000ULL) {
+                next = now;
+            }
+            next += interval;
+        }
+
+        size_t block = job->read_seq ? pos++ % job->read_blocks
+                                     : (size_t)(mix64(rng++) % job->read_blocks);
+        uint64_t t0 = now_ns();
+        ssize_t n = pread(job->read_fd, buf, job->read_size, (off_t)(block * job->read_size));
+        uint64_t t1 = now_ns();
+        if (n < 0) {
+            __atomic_add_fetch(&job->read_errors, 1, __ATOMIC_RELAXED);
+            continue;
+        }
+        lat_hist_add(&job->read_lat, t1 - t0);
+        __atomic_add_fetch(&job->read_bytes, (uint64_t)n, __ATOMIC_RELAXED);
+    }
+    free(buf);
+    return NULL;
+}
+
+/**
+ * @brief Size of the block device at PATH in bytes (st_size is 0 for devices).
+ *
+ * @return int 0 on success, -1 with errno set.
+ */
+static int block_device_size(const char *path, size_t *size) {
+#ifdef BLKGETSIZE64
+    uint64_t bytes = 0;
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        return -1;
+    }
+    int rc = ioctl(fd, BLKGETSIZE64, &bytes);
+    int err = errno;
+    close(fd);
+    if (rc == -1) {
+        errno = err;
+        return -1;
+    }
+    *size = (size_t)bytes;
+    return 0;
+#else
+    (void)path;
+    (void)size;
+    errno = ENOTSUP;
+    return -1;
+#endif
+}
+
+void fillfs_config_init(fillfs_config_t *cfg) {
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->size         = FILLFS_SIZE_AUTO;
+    cfg->block_size   = DEFAULT_BLOCK_SIZE;
+    cfg->data_mode    = "zero";
+    cfg->engine       = "sync";
+    cfg->threads      = 1;
+    cfg->low_priority = 1;
+}
+
+int fillfs_job_create(const fillfs_config_t *cfg, fillfs_job_t **out) {
+    *out = NULL;
+
+    if (!cfg->target || cfg->block_size == 0 || cfg->threads == 0) {
+        fprintf(stderr, "Error: Invalid job configuration.\n");
+        return -EINVAL;
+    }
+
+    const datagen_t *gen = datagen_find(cfg->data_mode ? cfg->data_mode : "zero");
+    if (!gen) {
+        fprintf(stderr, "Error: Unknown data mode '%s'.\n", cfg->data_mode);
+        return -EINVAL;
+    }
+
+    const io_engine_t *engine = engine_find(cfg->engine ? cfg->engine : "sync");
+    if (!engine) {
+        fprintf(stderr, "Error: Unknown engine '%s'.\n", cfg->engine);
+        return -EINVAL;
+    }
+
+    // A fault schedule implies the fake engine
+    if (cfg->fault_spec) {
+        if (engine != &sync_engine && engine != &fake_engine) {
+            fprintf(stderr, "Error: --fault can only be used with the fake engine.\n");
+            return -EINVAL;
+        }
+        if (fake_engine_configure(cfg->fault_spec) == -1) {
+            return -EINVAL;
+        }
+        engine = &fake_engine;
+    }
+
+    /*
+     * Detect if the target is a directory or a file.
+     * We'll use stat. If S_ISDIR -> directory, if S_ISREG -> file, etc.
+     */
+    struct stat st;
+    memset(&st, 0, sizeof(st));
+    if (stat(cfg->target, &st) == -1) {
+        int err = errno;
+        perror("stat");
+        return -err;
+    }
+
+    fillfs_job_t *job = calloc(1, sizeof(*job));
+    if (!job) {
+        return -ENOMEM;
+    }
+
+    size_t file_size = (cfg->size == FILLFS_SIZE_AUTO || cfg->size > SIZE_MAX)
+                       ? SIZE_MAX : (size_t)cfg->size;
+
+    job->block_size   = cfg->block_size;
+    job->gen          = gen;
+    job->engine       = engine;
+    job->threads      = cfg->threads;
+    job->max_threads  = (cfg->max_threads > cfg->threads) ? cfg->max_threads : cfg->threads;
+    job->active_threads = cfg->threads;
+    job->low_priority = cfg->low_priority;
+    job->keep_file    = cfg->keep_file;
+    job->persistent   = cfg->persistent;
+    job->hw_counters  = cfg->hw_counters;
+    job->rate_limit   = cfg->rate_limit;
+    job->seed         = cfg->seed ? cfg->seed : (uint64_t)time(NULL);
+    job->order_key    = mix64(job->seed);
+    job->trace_sample = cfg->trace_sample ? cfg->trace_sample : DEFAULT_TRACE_SAMPLE;
+    if (cfg->trace_path && !(job->trace_path = strdup(cfg->trace_path))) {
+        free(job);
+        return -ENOMEM;
+    }
+    job->stall_ns     = (uint64_t)cfg->stall_ms * 1000000ULL;
+    job->stall_dump   = cfg->stall_dump;
+    job->profile_step = (cfg->profile_step_pct > 0.0) ? cfg->profile_step_pct : 0.0;
+    job->random_order = cfg->random_order;
+    job->profile_level = -1;
+    describe_device(job, S_ISBLK(st.st_mode) ? st.st_rdev : st.st_dev);
+    job->anon_fd      = -1;
+    job->read_fd      = -1;
+    job->state        = FILLFS_STATE_CREATED;
+    pthread_mutex_init(&job->lock, NULL);
+    pthread_cond_init(&job->cond, NULL);
+    pthread_mutex_init(&job->rate_lock, NULL);
+
+    // Synchronous engines complete one write at a time; async ones default to 8 in flight
+    if (!(engine->caps & IO_CAP_ASYNC)) {
+        job->iodepth = 1;
+    } else {
+        job->iodepth = cfg->iodepth ? cfg->iodepth : DEFAULT_ASYNC_DEPTH;
+    }
+
+    /*
+     *   - If it's a directory, we generate the hidden file path, and we fill until file_size or disk full.
+     *   - If it's an existing file, we do NOT remove it on exit, and we only write up to the requested size
+     *     or the file's own size if none was given or it is bigger than the file.
+     */
+    if (S_ISDIR(st.st_mode)) {
+        generate_file_path(job->filename, cfg->target);
+        if (!(engine->caps & IO_CAP_DISCARD)) {
+            snprintf(job->owner_path, sizeof(job->owner_path), "%s%s", job->filename, OWNER_SUFFIX);
+            int rc = reclaim_stale(job->filename, job->owner_path);
+            if (rc != 0) {
+                pthread_mutex_destroy(&job->rate_lock);
+                pthread_cond_destroy(&job->cond);
+                pthread_mutex_destroy(&job->lock);
+                free(job->trace_path);
+                free(job);
+                return rc;
+            }
+            if (!job->keep_file) {
+                open_anonymous(job, cfg->target, cfg->link_fill_file);
+            }
+            // A named fill file gets an owner record so a later run can tell if it is stale
+            if (job->anon_fd == -1 || job->anon_linked) {
+                if (owner_write(job->owner_path) == -1) {
+                    fprintf(stderr, "Warning: Cannot write owner record '%s': %s\n",
+                            job->owner_path, strerror(errno));
+                } else {
+                    job->owner_written = 1;
+                }
+            }
+        }
+
+        // If file_size == SIZE_MAX, try to get free space from the directory
+        if (file_size == SIZE_MAX) {
+            struct statvfs fs_info;
+            if (statvfs(cfg->target, &fs_info) == 0) {
+                job->known_free_space = (size_t)fs_info.f_bavail * fs_info.f_bsize;
+            }
+        }
+
+        job->file_size     = file_size;  // Could be SIZE_MAX
+        job->size_cap      = SIZE_MAX;
+        job->existing_file = 0;          // We'll remove it on destroy
+    }
+    else if (S_ISREG(st.st_mode) || S_ISBLK(st.st_mode)) {
+        /*
+         * We have an existing file (or block device). We do not remove it.
+         * We won't expand the file in this scenario, so the size is capped at the file's own size.
+         */
+        size_t file_actual_size = (size_t)st.st_size;
+        if (S_ISBLK(st.st_mode) && block_device_size(cfg->target, &file_actual_size) == -1) {
+            int err = errno;
+            perror(cfg->target);
+            pthread_mutex_destroy(&job->rate_lock);
+            pthread_cond_destroy(&job->cond);
+            pthread_mutex_destroy(&job->lock);
+            free(job->trace_path);
+            free(job);
+            return -err;
+        }
+
+        snprintf(job->filename, sizeof(job->filename), "%s", cfg->target);
+        job->file_size     = (file_size < file_actual_size) ? file_size : file_actual_size;
+        job->size_cap      = file_actual_size;
+        job->existing_file = 1;
+    }
+    else {
+        fprintf(stderr, "Error: '%s' is not a directory, regular file or block device.\n", cfg->target);
+        pthread_mutex_destroy(&job->rate_lock);
+        pthread_cond_destroy(&job->cond);
+        pthread_mutex_destroy(&job->lock);
+        free(job->trace_path);
+        free(job);
+        return -EINVAL;
+    }
+
+    if (cfg->read_path) {
+        int rc = reader_open(job, cfg);
+        if (rc != 0) {
+            fillfs_job_destroy(job);
+            return rc;
+        }
+    }
+
+    *out = job;
+    return 0;
+}
+
+int fillfs_job_subscribe(fillfs_job_t *job, unsigned interval_ms, fillfs_progress_cb cb, void *user) {
+    if (job->state != FILLFS_STATE_CREATED || !cb || interval_ms == 0) {
+        return -EINVAL;
+    }
+    job->progress_cb          = cb;
+    job->progress_user        = user;
+    job->progress_interval_ms = interval_ms;
+    return 0;
+}
+
+/**
+ * @brief Free every trace buffer of the job.
+ */
+static void trace_free_all(fillfs_job_t *job) {
+    for (unsigned i = 0; i < job->trace_nbufs; ++i) {
+        trace_buf_free(job->trace_bufs[i]);
+    }
+    free(job->trace_bufs);
+    job->trace_bufs  = NULL;
+    job->trace_nbufs = 0;
+    job->trace       = NULL;
+}
+
+/**
+ * @brief Give writer W its trace buffer (trace_bufs[1 + W]), if tracing.
+ *        Writers started later by fillfs_job_set_threads() get theirs here too.
+ */
+static int trace_add_writer(fillfs_job_t *job, unsigned w) {
+    char name[32];
+
+    if (!job->trace_bufs) {
+        return 0;
+    }
+    snprintf(name, sizeof(name), "writer %u", w);
+    job->trace_bufs[1 + w] = trace_buf_new(name, 1 + w, TRACE_DEFAULT_EVENTS);
+    if (!job->trace_bufs[1 + w]) {
+        return -1;
+    }
+    job->trace_nbufs = 2 + w;
+    job->workers[w].trace = job->trace_bufs[1 + w];
+    return 0;
+}
+
+/**
+ * @brief Allocate the trace buffers: one for the caller, one per writer, with
+ *        room for the writers fillfs_job_set_threads() may add.
+ */
+static int trace_setup(fillfs_job_t *job) {
+    job->trace_bufs = calloc(1 + job->max_threads, sizeof(*job->trace_bufs));
+    if (!job->trace_bufs) {
+        return -1;
+    }
+    job->trace_bufs[0] = trace_buf_new("main", 0, TRACE_DEFAULT_EVENTS);
+    if (!job->trace_bufs[0]) {
+        trace_free_all(job);
+        return -1;
+    }
+    job->trace_nbufs = 1;
+    job->trace = job->trace_bufs[0];
+    for (unsigned i = 0; i < job->threads; ++i) {
+        if (trace_add_writer(job, i) != 0) {
+            trace_free_all(job);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Write the trace file once every thread has finished recording.
+ */
+static void trace_finish(fillfs_job_t *job) {
+    if (trace_write(job->trace_path, job->trace_bufs, job->trace_nbufs, job->launch_ns) == -1) {
+        perror(job->trace_path);
+    }
+}
+
+/**
+ * @brief Allocate the shared write buffer.
+ *
+ * Zero data needs no memory of its own: a read-only private anonymous mapping is
+ * backed entirely by the kernel's shared zero page, so a block of any size costs
+ * only page tables and writes copy from one cache-resident page. MAP_POPULATE maps
+ * that page in up front, so the first writes do not take a fault per page.
+ */
+static void *buffer_alloc(const fillfs_job_t *job) {
+    if (job->gen->zero) {
+        void *p = mmap(NULL, job->block_size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+        return (p == MAP_FAILED) ? NULL : p;
+    }
+    return malloc(job->block_size);
+}
+
+static void buffer_free(fillfs_job_t *job) {
+    if (job->buffer && job->gen->zero) {
+        munmap(job->buffer, job->block_size);
+    } else {
+        free(job->buffer);
+    }
+    job->buffer = NULL;
+}
+
+int fillfs_job_start(fillfs_job_t *job) {
+    if (job->state != FILLFS_STATE_CREATED) {
+        return -EINVAL;
+    }
+
+    job->workers = calloc(job->max_threads, sizeof(*job->workers));
+    job->buffer  = buffer_alloc(job);
+    if (!job->workers || !job->buffer) {
+        perror("malloc");
+        free(job->workers);
+        buffer_free(job);
+        job->workers = NULL;
+        return -ENOMEM;
+    }
+
+    job->launch_ns = now_ns();
+    if (job->trace_path && trace_setup(job) != 0) {
+        fprintf(stderr, "Warning: Not enough memory for tracing; --trace disabled.\n");
+    }
+    if (job->profile_step > 0.0) {
+        job->profile_mark = malloc(sizeof(*job->profile_mark));
+        job->profile_cur  = malloc(sizeof(*job->profile_cur));
+        if (!job->profile_mark || !job->profile_cur) {
+            fprintf(stderr, "Warning: Not enough memory for the fill-level profile; disabled.\n");
+            job->profile_step = 0.0;
+        }
+    }
+
+    // Generated once and shared by every writer, so any block can be verified later
+    cpu_sample_t before, after;
+    cpu_sample(&before, NULL);
+    if (!job->gen->zero) {
+        job->gen->fill(job->buffer, job->block_size, job->seed);
+    }
+    cpu_sample(&after, NULL);
+    cpu_cost_add_delta(&job->setup_cpu, &before, &after);
+    job->cpu = job->setup_cpu;
+    if (TRACE_ON(job->trace)) {
+        trace_span(job->trace, TR_GENERATE, job->launch_ns, now_ns(), 0, 0);
+    }
+
+    job->running   = job->threads;
+    job->state     = FILLFS_STATE_RUNNING;
+
+    for (unsigned i = 0; i < job->threads; ++i) {
+        job->workers[i].job   = job;
+        job->workers[i].index = i;
+        int rc = pthread_create(&job->workers[i].tid, NULL, fill_file_thread, &job->workers[i]);
+        if (rc != 0) {
+            // Stop the writers already running; fillfs_job_wait() joins just those
+            errno = rc;
+            perror("pthread_create");
+            job->error = 1;
+            job->stop  = 1;
+            unsigned missing = job->threads - i;
+            job->threads = i;
+            job->active_threads = i;
+            pthread_mutex_lock(&job->lock);
+            job->first_open_done = 1;
+            pthread_cond_broadcast(&job->cond);
+            pthread_mutex_unlock(&job->lock);
+            if (__atomic_sub_fetch(&job->running, missing, __ATOMIC_ACQ_REL) == 0) {
+                job->done = 1;
+            }
+            return -rc;
+        }
+    }
+
+    if (job->progress_cb &&
+        pthread_create(&job->progress_tid, NULL, progress_thread, job) != 0) {
+        perror("pthread_create");
+        job->progress_cb = NULL;
+    }
+    if (pthread_create(&job->monitor_tid, NULL, monitor_thread, job) != 0) {
+        perror("pthread_create");
+    } else {
+        job->monitor_running = 1;
+    }
+    if (job->read_fd != -1) {
+        if (pthread_create(&job->reader_tid, NULL, reader_thread, job) != 0) {
+            perror("pthread_create");
+        } else {
+            job->reader_running = 1;
+        }
+    }
+    return 0;
+}
+
+void fillfs_job_cancel(fillfs_job_t *job) {
+    job->cancelled = 1;
+    job->stop      = 1;
+}
+
+/**
+ * @brief Fill STATS from a latency histogram and a byte count over [start_ns, end_ns].
+ */
+static void fill_stats(const fillfs_job_t *job, fillfs_stats_t *stats, const lat_hist_t *lat,
+                       const cpu_cost_t *cpu, size_t bytes, uint64_t start_ns, uint64_t end_ns,
+                       uint64_t paused_ns) {
+    double elapsed = (end_ns > start_ns) ? (double)(end_ns - start_ns) / 1e9 : 0.0;
+    double paused  = (double)paused_ns / 1e9;
+    if (paused > elapsed) {
+        paused = elapsed;
+    }
+    double active  = elapsed - paused;
+
+    memset(stats, 0, sizeof(*stats));
+    stats->engine          = job->engine->name;
+    stats->data_mode       = job->gen->name;
+    stats->threads         = job->threads;
+    stats->iodepth         = job->iodepth;
+    stats->block_size      = job->block_size;
+    stats->bytes_written   = bytes;
+    stats->writes          = lat->count;
+    stats->elapsed_s       = elapsed;
+    stats->throughput_mb_s = (active > 0.0) ? (double)bytes / (1024.0 * 1024.0) / active : 0.0;
+    stats->paused_s        = paused;
+    stats->lat_mean_us     = lat->count ? (double)lat->sum_ns / (double)lat->count / 1e3 : 0.0;
+    stats->lat_p50_us      = lat_hist_percentile(lat, 50.0) / 1e3;
+    stats->lat_p90_us      = lat_hist_percentile(lat, 90.0) / 1e3;
+    stats->lat_p99_us      = lat_hist_percentile(lat, 99.0) / 1e3;
+    stats->lat_max_us      = (double)lat->max_ns / 1e3;
+    stats->disk_full       = job->disk_full;
+    stats->cancelled       = job->cancelled;
+    stats->error           = job->error;
+    stats->file_extent     = job->file_extent;
+    stats->stalls          = __atomic_load_n(&job->stalls, __ATOMIC_RELAXED);
+    stats->stall_s         = (double)__atomic_load_n(&job->stalled_ns, __ATOMIC_RELAXED) / 1e9;
+
+    // The background reader runs for the whole job, so its figures are cumulative
+    if (job->read_fd != -1) {
+        lat_hist_t snap;
+        memset(&snap, 0, sizeof(snap));
+        lat_hist_snapshot(&snap, &job->read_lat);  // The reader may still be running
+        snap.count  = __atomic_load_n(&job->read_lat.count, __ATOMIC_RELAXED);
+        snap.max_ns = __atomic_load_n(&job->read_lat.max_ns, __ATOMIC_RELAXED);
+        const lat_hist_t *rl = &snap;
+        stats->reads           = rl->count;
+        stats->read_bytes      = __atomic_load_n(&job->read_bytes, __ATOMIC_RELAXED);
+        stats->read_errors     = __atomic_load_n(&job->read_errors, __ATOMIC_RELAXED);
+        stats->read_lat_mean_us = rl->count ? (double)rl->sum_ns / (double)rl->count / 1e3 : 0.0;
+        stats->read_lat_p50_us = lat_hist_percentile(rl, 50.0) / 1e3;
+        stats->read_lat_p90_us = lat_hist_percentile(rl, 90.0) / 1e3;
+        stats->read_lat_p99_us = lat_hist_percentile(rl, 99.0) / 1e3;
+        stats->read_lat_max_us = (double)rl->max_ns / 1e3;
+    }
+
+    double gb = (double)bytes / 1e9;
+    stats->cpu_user_s      = (double)cpu->user_ns / 1e9;
+    stats->cpu_sys_s       = (double)cpu->sys_ns / 1e9;
+    stats->cpu_s_per_gb    = (gb > 0.0) ? (stats->cpu_user_s + stats->cpu_sys_s) / gb : 0.0;
+    stats->syscalls        = cpu->syscalls;
+    stats->syscalls_per_gb = (gb > 0.0) ? (double)cpu->syscalls / gb : 0.0;
+    stats->ctx_voluntary   = cpu->ctx_voluntary;
+    stats->ctx_involuntary = cpu->ctx_involuntary;
+    stats->hw_counters     = cpu->hw_valid;
+    stats->cycles          = cpu->hw[HW_CYCLES];
+    stats->instructions    = cpu->hw[HW_INSTRUCTIONS];
+    stats->cache_misses    = cpu->hw[HW_CACHE_MISSES];
+    stats->ipc             = cpu->hw[HW_CYCLES]
+                             ? (double)cpu->hw[HW_INSTRUCTIONS] / (double)cpu->hw[HW_CYCLES]
+                             : 0.0;
+}
+
+/**
+ * @brief Block until every live writer is parked (or has exited).
+ */
+static void wait_writers_idle(fillfs_job_t *job) {
+    pthread_mutex_lock(&job->lock);
+    while (job->running > 0 && job->idle_writers < job->running) {
+        pthread_cond_wait(&job->cond, &job->lock);
+    }
+    pthread_mutex_unlock(&job->lock);
+}
+
+int fillfs_job_wait_phase(fillfs_job_t *job, fillfs_stats_t *stats) {
+    if (!job->persistent || job->state != FILLFS_STATE_RUNNING) {
+        return -EINVAL;
+    }
+    wait_writers_idle(job);
+
+    // Parked writers don't touch their histograms, so they can be drained here
+    // (under the lock, for fillfs_job_latency()). The first phase starts with
+    // the earliest writer, later ones at fillfs_job_continue().
+    pthread_mutex_lock(&job->lock);
+    uint64_t start = job->phase_start_ns;
+    uint64_t end   = 0;
+    memset(&job->phase_lat, 0, sizeof(job->phase_lat));
+    cpu_cost_t phase_cpu;
+    memset(&phase_cpu, 0, sizeof(phase_cpu));
+    for (unsigned i = 0; i < job->threads; ++i) {
+        fill_worker_t *w = &job->workers[i];
+        if (job->phase_start_ns == 0 && (start == 0 || w->start_ns < start)) {
+            start = w->start_ns;
+        }
+        if (w->end_ns > end) {
+            end = w->end_ns;
+        }
+        lat_hist_merge(&job->phase_lat, &w->write_lat);
+        memset(&w->write_lat, 0, sizeof(w->write_lat));
+        cpu_cost_merge(&phase_cpu, &w->cpu);
+        memset(&w->cpu, 0, sizeof(w->cpu));
+    }
+    if (job->start_ns == 0 || start < job->start_ns) {
+        job->start_ns = start;
+    }
+    if (end > job->end_ns) {
+        job->end_ns = end;
+    }
+    lat_hist_merge(&job->write_lat, &job->phase_lat);
+    cpu_cost_merge(&job->cpu, &phase_cpu);
+    uint64_t paused = paused_total_ns(job) - job->phase_paused_ns;
+    pthread_mutex_unlock(&job->lock);
+
+    if (TRACE_ON(job->trace)) {
+        trace_span(job->trace, TR_PHASE, start, end, 0, (int64_t)(job->total_written - job->phase_base));
+    }
+
+    if (stats) {
+        // The data buffer was generated for the first phase
+        if (job->phase_start_ns == 0) {
+            cpu_cost_merge(&phase_cpu, &job->setup_cpu);
+        }
+        fill_stats(job, stats, &job->phase_lat, &phase_cpu,
+                   job->total_written - job->phase_base, start, end, paused);
+    }
+    return job->error ? -EIO : 0;
+}
+
+int fillfs_job_continue(fillfs_job_t *job, uint64_t start, uint64_t end) {
+    if (!job->persistent || job->state != FILLFS_STATE_RUNNING || job->done || job->error) {
+        return -EINVAL;
+    }
+    wait_writers_idle(job);
+
+    // A previous phase can end mid-block (fill-to=, an unaligned size, a short
+    // tail write); restart at that block so byte X still holds buffer[X % block_size]
+    start -= start % job->block_size;
+
+    pthread_mutex_lock(&job->lock);
+    job->next_offset    = (size_t)start;
+    job->range_start    = (size_t)start;
+    job->file_size      = (end > job->size_cap) ? job->size_cap : (size_t)end;
+    job->stop           = 0;
+    job->disk_full      = 0;
+    job->cancelled      = 0;
+    job->phase_start_ns = now_ns();
+    job->phase_base     = job->total_written;
+    job->phase_paused_ns = paused_total_ns(job);
+    job->idle_writers   = 0;  // Reset here, not by the writers, so a waiter can't miss the phase
+    job->generation++;
+    job->order_key      = mix64(job->seed + job->generation);  // A new order every pass
+    pthread_cond_broadcast(&job->cond);
+    pthread_mutex_unlock(&job->lock);
+    return 0;
+}
+
+int fillfs_job_truncate(fillfs_job_t *job, uint64_t size) {
+    if (job->existing_file || job->state != FILLFS_STATE_RUNNING || !job->persistent) {
+        return -EINVAL;
+    }
+    wait_writers_idle(job);
+
+    if (!(job->engine->caps & IO_CAP_DISCARD) && truncate(job->filename, (off_t)size) == -1) {
+        int err = errno;
+        perror("truncate");
+        return -err;
+    }
+    if (size < job->file_extent) {
+        job->file_extent = (size_t)size;
+    }
+    return 0;
+}
+
+int fillfs_job_verify(fillfs_job_t *job, uint64_t size, uint64_t *mismatched) {
+    if (mismatched) {
+        *mismatched = 0;
+    }
+    if (!job->buffer || (job->engine->caps & IO_CAP_DISCARD)) {
+        return -EINVAL;
+    }
+    if (job->state == FILLFS_STATE_RUNNING) {
+        if (!job->persistent) {
+            return -EINVAL;
+        }
+        wait_writers_idle(job);
+    }
+    if (size == FILLFS_SIZE_AUTO || size > job->file_extent) {
+        size = job->file_extent;
+    }
+
+    int fd = open(job->filename, O_RDONLY);
+    if (fd == -1) {
+        int err = errno;
+        perror("open");
+        return -err;
+    }
+
+    // Block N of the file holds the generated buffer, so byte X is buffer[X % block_size]
+    unsigned char *rbuf = malloc(job->block_size);
+    if (!rbuf) {
+        close(fd);
+        return -ENOMEM;
+    }
+    const unsigned char *expect = job->buffer;
+    uint64_t bad = 0;
+    int rc = 0;
+    for (uint64_t off = 0; off < size; ) {
+        // Read to the end of the pattern block at most: after a short read OFF
+        // is unaligned, and a full block would run past the end of the buffer
+        size_t base = (size_t)(off % job->block_size);
+        size_t want = job->block_size - base;
+        if (size - off < want) {
+            want = (size_t)(size - off);
+        }
+        ssize_t got = pread(fd, rbuf, want, (off_t)off);
+        if (got < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            rc = -errno;
+            perror("read");
+            break;
+        }
+        if (got == 0) {
+            bad += size - off;  // File shorter than what was written
+            break;
+        }
+        bad += kernels()->count_diff(rbuf, expect + base, (size_t)got);
+        off += (uint64_t)got;
+    }
+    free(rbuf);
+    close(fd);
+
+    if (mismatched) {
+        *mismatched = bad;
+    }
+    if (rc == 0 && bad) {
+        rc = -EILSEQ;
+    }
+    return rc;
+}
+
+void fillfs_job_latency(fillfs_job_t *job, const double *bounds_us, unsigned n,
+                        uint64_t *counts, uint64_t *count, double *sum_us) {
+    double bounds_ns[n ? n : 1];
+    uint64_t total = 0, sum_ns = 0;
+
+    for (unsigned j = 0; j < n; ++j) {
+        bounds_ns[j] = bounds_us[j] * 1e3;
+        counts[j]    = 0;
+    }
+
+    // Finished phases live in write_lat, the running one in the writers' histograms
+    pthread_mutex_lock(&job->lock);
+    lat_hist_accumulate(&job->write_lat, bounds_ns, n, counts, &total, &sum_ns);
+    for (unsigned i = 0; job->workers && i < job->threads; ++i) {
+        lat_hist_accumulate(&job->workers[i].write_lat, bounds_ns, n, counts, &total, &sum_ns);
+    }
+    pthread_mutex_unlock(&job->lock);
+
+    *count  = total;
+    *sum_us = (double)sum_ns / 1e3;
+}
+
+unsigned fillfs_job_fill_profile(fillfs_job_t *job, fillfs_level_stats_t *levels, unsigned max) {
+    pthread_mutex_lock(&job->lock);
+    unsigned total = job->profile_n;
+    if (levels && max) {
+        memcpy(levels, job->profile, ((total < max) ? total : max) * sizeof(*levels));
+    }
+    pthread_mutex_unlock(&job->lock);
+    return total;
+}
+
+unsigned fillfs_job_tput_phases(fillfs_job_t *job, fillfs_tput_phase_t *phases, unsigned max) {
+    tl_segment_t *segs = calloc(max ? max : 1, sizeof(*segs));
+    if (!segs) {
+        return 0;
+    }
+    pthread_mutex_lock(&job->lock);
+    unsigned n = timeline_segments(&job->timeline, segs, max);
+    pthread_mutex_unlock(&job->lock);
+
+    for (unsigned i = 0; i < n; ++i) {
+        double dur = (double)segs[i].dur_ns / 1e9;
+        phases[i].start_bytes     = segs[i].bytes_at;
+        phases[i].end_bytes       = segs[i].bytes_at + segs[i].bytes;
+        phases[i].start_s         = (double)segs[i].start_ns / 1e9;
+        phases[i].duration_s      = dur;
+        phases[i].throughput_mb_s = (dur > 0.0) ? (double)segs[i].bytes / (1024.0 * 1024.0) / dur : 0.0;
+    }
+    free(segs);
+    return n;
+}
+
+void fillfs_job_set_rate(fillfs_job_t *job, uint64_t bytes_per_s) {
+    job->rate_limit = bytes_per_s;
+}
+
+void fillfs_job_pause(fillfs_job_t *job) {
+    pthread_mutex_lock(&job->lock);
+    if (!job->paused) {
+        job->pause_start_ns = 0;
+        job->paused         = 1;
+        pause_check_drained(job);  // Nothing in flight already (parked or held writers)
+    }
+    pthread_mutex_unlock(&job->lock);
+}
+
+void fillfs_job_resume(fillfs_job_t *job) {
+    pthread_mutex_lock(&job->lock);
+    if (job->paused) {
+        if (job->pause_start_ns) {
+            job->paused_ns += now_ns() - job->pause_start_ns;
+        }
+        job->pause_start_ns = 0;
+        job->paused         = 0;
+    }
+    pthread_mutex_unlock(&job->lock);
+}
+
+int fillfs_job_set_threads(fillfs_job_t *job, unsigned threads) {
+    if (threads == 0 || threads > job->max_threads) {
+        return -EINVAL;
+    }
+    if (job->state != FILLFS_STATE_RUNNING) {
+        return -EINVAL;
+    }
+
+    // Writers are only added while some are still running and nobody is joining them
+    pthread_mutex_lock(&job->lock);
+    if (job->done || job->shutdown) {
+        pthread_mutex_unlock(&job->lock);
+        return -EINVAL;
+    }
+    while (job->threads < threads) {
+        fill_worker_t *w = &job->workers[job->threads];
+        w->job   = job;
+        w->index = job->threads;
+        if (trace_add_writer(job, job->threads) != 0) {
+            pthread_mutex_unlock(&job->lock);
+            return -ENOMEM;
+        }
+        int rc = pthread_create(&w->tid, NULL, fill_file_thread, w);
+        if (rc != 0) {
+            pthread_mutex_unlock(&job->lock);
+            return -rc;
+        }
+        job->running++;
+        job->threads++;
+    }
+    job->active_threads = threads;
+    pthread_mutex_unlock(&job->lock);
+    return 0;
+}
+
+int fillfs_job_wait(fillfs_job_t *job, fillfs_stats_t *stats) {
+    if (job->state == FILLFS_STATE_RUNNING) {
+        if (job->persistent) {
+            // Account the last phase, then release the parked writers
+            fillfs_job_wait_phase(job, NULL);
+            pthread_mutex_lock(&job->lock);
+            job->shutdown = 1;
+            pthread_cond_broadcast(&job->cond);
+            pthread_mutex_unlock(&job->lock);
+        }
+
+        // Wait for the writer threads to join, then merge their statistics.
+        // fillfs_job_set_threads() may still add writers until the last one exits.
+        uint64_t t_join = now_ns();
+        for (unsigned i = 0; ; ++i) {
+            pthread_mutex_lock(&job->lock);
+            unsigned started = job->threads;
+            pthread_mutex_unlock(&job->lock);
+            if (i >= started) {
+                break;
+            }
+            pthread_join(job->workers[i].tid, NULL);
+        }
+        if (job->monitor_running) {
+            pthread_join(job->monitor_tid, NULL);
+            job->monitor_running = 0;
+        }
+        if (job->reader_running) {
+            pthread_join(job->reader_tid, NULL);
+            job->reader_running = 0;
+        }
+        stall_event_t events[job->max_threads];
+        unsigned n_events = 0;
+        pthread_mutex_lock(&job->lock);
+        if (job->stall_ns) {
+            // Nothing is in flight any more: this closes any stall still open
+            n_events = watchdog_scan(job, now_ns(), events);
+        }
+        // The last, partial second counts unless it is too short to be a fair
+        // sample, or the whole run was (then there is no timeline at all)
+        uint64_t t_end = now_ns();
+        if (job->timeline.n > 0 && t_end - job->sample_ns >= TIMELINE_INTERVAL_NS / 4) {
+            timeline_sample(job, t_end);
+        }
+        for (unsigned i = 0; i < job->threads; ++i) {
+            fill_worker_t *w = &job->workers[i];
+            if (job->start_ns == 0 || w->start_ns < job->start_ns) {
+                job->start_ns = w->start_ns;
+            }
+            if (w->end_ns > job->end_ns) {
+                job->end_ns = w->end_ns;
+            }
+            lat_hist_merge(&job->write_lat, &w->write_lat);
+            cpu_cost_merge(&job->cpu, &w->cpu);
+        }
+        free(job->workers);
+        job->workers = NULL;
+        if (job->profile_level >= 0 && job->total_written > job->profile_bytes) {
+            // After the final fsync, so the last bucket ends at the settled fill level
+            double level = fill_level(job);
+            profile_close(job, (level >= 0.0) ? level : job->profile_from, now_ns());
+            job->profile_level = -1;
+        }
+        pthread_mutex_unlock(&job->lock);
+        watchdog_report(job, events, n_events);
+        if (job->progress_cb) {
+            pthread_join(job->progress_tid, NULL);
+        }
+        if (TRACE_ON(job->trace)) {
+            trace_span(job->trace, TR_JOIN, t_join, now_ns(), 0, 0);
+        }
+        job->state   = FILLFS_STATE_DONE;
+    }
+
+    if (stats) {
+        pthread_mutex_lock(&job->lock);
+        uint64_t paused = paused_total_ns(job);
+        pthread_mutex_unlock(&job->lock);
+        fill_stats(job, stats, &job->write_lat, &job->cpu, job->total_written,
+                   job->start_ns, job->end_ns, paused);
+    }
+
+    return job->error ? -EIO : 0;
+}
+
+void fillfs_job_destroy(fillfs_job_t *job) {
+    if (!job) {
+        return;
+    }
+    if (job->state == FILLFS_STATE_RUNNING) {
+        fillfs_job_cancel(job);
+        fillfs_job_wait(job, NULL);
+    }
+    /*
+     * We only want to unlink if we actually created a hidden file.
+     * An existing file given by the caller is never removed. Closing the
+     * last descriptor of an anonymous file is what releases its space.
+     */
+    uint64_t t0 = now_ns();
+    int cleanup = 0;
+    if (!job->existing_file && !job->keep_file && job->state == FILLFS_STATE_DONE &&
+        !(job->engine->caps & IO_CAP_DISCARD) && (job->anon_fd == -1 || job->anon_linked)) {
+        unlink(job->filename);
+        cleanup = 1;
+    }
+    if (job->anon_fd != -1) {
+        close(job->anon_fd);
+        cleanup = 1;
+    }
+    if (job->read_fd != -1) {
+        close(job->read_fd);
+    }
+    if (job->owner_written && !job->keep_file) {
+        unlink(job->owner_path);
+    }
+    if (cleanup && TRACE_ON(job->trace)) {
+        trace_span(job->trace, TR_CLEANUP, t0, now_ns(), 0, 0);
+    }
+    if (job->trace_bufs) {
+        trace_finish(job);
+        trace_free_all(job);
+    }
+    free(job->trace_path);
+    timeline_free(&job->timeline);
+    free(job->profile);
+    free(job->profile_mark);
+    free(job->profile_cur);
+    pthread_mutex_destroy(&job->rate_lock);
+    pthread_cond_destroy(&job->cond);
+    pthread_mutex_destroy(&job->lock);
+    buffer_free(job);
+    free(job);
+}
+
+const char *fillfs_job_fill_path(const fillfs_job_t *job) {
+    return job->filename;
+}
+
+int fillfs_job_is_temporary(const fillfs_job_t *job) {
+    return !job->existing_file && !(job->engine->caps & IO_CAP_DISCARD) &&
+           (job->anon_fd == -1 || job->anon_linked);
+}
+
+void fillfs_list_engines(FILE *out) {
+    engine_list(out);
+}
+
+void fillfs_show_cpu_features(FILE *out) {
+    kernels_list(out);
+}
@@ -0,0 +1,168 @@
+/*
+ * owner.c
+ *
+ * Copyright (c) 2025 Robert Heffernan
+ *
+ * Author: Robert Heffernan <robert@heffernantech.au>
+ *
+ * This file is part of the fillfs utility. It is licensed under the MIT License:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify,
+ * merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Owner records for named fill files (see owner.h).
+ */
+
+#define _GNU_SOURCE
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "owner.h"
+
+/**
+ * @brief Read the boot id of the running kernel into BUF ("" if unknown).
+ */
+static void read_boot_id(char *buf, size_t size) {
+    buf[0] = '\0';
+    FILE *f = fopen("/proc/sys/kernel/random/boot_id", "r");
+    if (!f) {
+        return;
+    }
+    if (fgets(buf, (int)size, f)) {
+        buf[strcspn(buf, "\n")] = '\0';
+    }
+    fclose(f);
+}
+
+/**
+ * @brief Start time of process PID in clock ticks since boot (0 if unknown),
+ *        and its state letter in *STATE (0 if unknown; 'Z' for a zombie).
+ *
+ * Together with the boot id the start time identifies a process even after
+ * its pid has been reused.
+ */
+static uint64_t process_start_ticks(pid_t pid, char *state) {
+    char path[64], buf[1024];
+    if (state) {
+        *state = 0;
+    }
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        return 0;
+    }
+    size_t n = fread(buf, 1, sizeof(buf) - 1, f);
+    fclose(f);
+    buf[n] = '\0';
+
+    // The command name may contain spaces; fields resume after its last ')'
+    char *p = strrchr(buf, ')');
+    if (!p) {
+        return 0;
+    }
+    unsigned long long ticks = 0;
+    if (state) {
+        *state = p[2];
+    }
+    if (sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %*u %*u %*d %*d %*d %*d %*d %*d %llu",
+               &ticks) != 1) {
+        return 0;
+    }
+    return ticks;
+}
+
+int owner_write(const char *path) {
+    owner_t me;
+    memset(&me, 0, sizeof(me));
+    me.pid         = getpid();
+    me.start_ticks = process_start_ticks(me.pid, NULL);
+    me.started     = (int64_t)time(NULL);
+    read_boot_id(me.boot_id, sizeof(me.boot_id));
+
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        return -1;
+    }
+    fprintf(f, "pid=%d\nboot_id=%s\nstart_ticks=%llu\nstarted=%lld\n",
+            (int)me.pid, me.boot_id, (unsigned long long)me.start_ticks, (long long)me.started);
+    if (fclose(f) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+owner_state_t owner_check(const char *path, owner_t *owner) {
+    owner_t rec;
+    memset(&rec, 0, sizeof(rec));
+
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        return OWNER_NONE;
+    }
+    char line[128];
+    while (fgets(line, sizeof(line), f)) {
+        int pid;
+        unsigned long long ull;
+        long long ll;
+        if (sscanf(line, "pid=%d", &pid) == 1) {
+            rec.pid = (pid_t)pid;
+        } else if (strncmp(line, "boot_id=", 8) == 0) {
+            snprintf(rec.boot_id, sizeof(rec.boot_id), "%.*s", (int)sizeof(rec.boot_id) - 1, line + 8);
+            rec.boot_id[strcspn(rec.boot_id, "\n")] = '\0';
+        } else if (sscanf(line, "start_ticks=%llu", &ull) == 1) {
+            rec.start_ticks = ull;
+        } else if (sscanf(line, "started=%lld", &ll) == 1) {
+            rec.started = ll;
+        }
+    }
+    fclose(f);
+    if (owner) {
+        *owner = rec;
+    }
+    if (rec.pid <= 0) {
+        return OWNER_DEAD;  // Unreadable record: nobody can be using it
+    }
+
+    // A different boot means the owner is gone; otherwise the same pid must
+    // still exist and have started at the same time
+    char boot_id[sizeof(rec.boot_id)];
+    read_boot_id(boot_id, sizeof(boot_id));
+    if (rec.boot_id[0] && boot_id[0] && strcmp(rec.boot_id, boot_id) != 0) {
+        return OWNER_DEAD;
+    }
+    if (kill(rec.pid, 0) == -1 && errno == ESRCH) {
+        return OWNER_DEAD;
+    }
+    char state;
+    uint64_t ticks = process_start_ticks(rec.pid, &state);
+    if (rec.start_ticks && ticks && ticks != rec.start_ticks) {
+        return OWNER_DEAD;  // The pid has been reused
+    }
+    if (state == 'Z' || state == 'X') {
+        return OWNER_DEAD;  // Killed, not yet reaped
+    }
+    return OWNER_LIVE;
+}
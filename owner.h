@@ -0,0 +1,80 @@
+/*
+ * owner.h
+ *
+ * Copyright (c) 2025 Robert Heffernan
+ *
+ * Author: Robert Heffernan <robert@heffernantech.au>
+ *
+ * This file is part of the fillfs utility. It is licensed under the MIT License:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify,
+ * merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef FILLFS_OWNER_H
+#define FILLFS_OWNER_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+/*
+ * Owner records for named fill files. A small text file next to the fill
+ * file names the process that writes it by pid, boot id and process start
+ * time, so a later run can tell a leftover of a dead run (killed, or from
+ * before a reboot) from a fill that is still in progress, even if the pid
+ * has been reused since.
+ */
+
+/** Suffix of the owner record, appended to the fill file's path. */
+#define OWNER_SUFFIX ".owner"
+
+/**
+ * @brief What an owner record says about its fill file.
+ */
+typedef enum {
+    OWNER_NONE = 0,     ///< No record
+    OWNER_LIVE,         ///< The owning process is still running
+    OWNER_DEAD          ///< The owner has exited, or the host has rebooted since
+} owner_state_t;
+
+/**
+ * @brief Contents of an owner record.
+ */
+typedef struct {
+    pid_t    pid;
+    char     boot_id[40];       ///< /proc/sys/kernel/random/boot_id of the owner's boot
+    uint64_t start_ticks;       ///< Process start time in clock ticks since boot
+    int64_t  started;           ///< Wall-clock start of the fill (Unix time)
+} owner_t;
+
+/**
+ * @brief Write the record for the calling process to PATH.
+ *
+ * @return int 0 on success, -1 with errno set.
+ */
+int owner_write(const char *path);
+
+/**
+ * @brief Read the record at PATH and decide whether its owner is alive.
+ *
+ * @param path  Owner record.
+ * @param owner Filled with the record if one was found (may be NULL).
+ * @return owner_state_t
+ */
+owner_state_t owner_check(const char *path, owner_t *owner);
+
+#endif /* FILLFS_OWNER_H */
@@ -0,0 +1,267 @@
+/*
+ * promfile.c
+ *
+ * Copyright (c) 2025 Robert Heffernan
+ *
+ * Author: Robert Heffernan <robert@heffernantech.au>
+ *
+ * This file is part of the fillfs utility. It is licensed under the MIT License:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify,
+ * merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Prometheus textfile exporter (see promfile.h).
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/statvfs.h>
+
+#include "promfile.h"
+#include "util.h"
+
+#define PROM_PATH_MAX 1024
+
+/** Write latency histogram bucket bounds, in microseconds. */
+static const double prom_bounds_us[] = {
+    100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000,
+    100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000
+};
+#define PROM_BOUNDS (sizeof(prom_bounds_us) / sizeof(prom_bounds_us[0]))
+
+static struct {
+    pthread_t       tid;
+    pthread_mutex_t lock;       ///< Protects the source fields and stop
+    pthread_cond_t  cond;       ///< Signalled on stop
+    int             running;
+    int             stop;
+    char            path[PROM_PATH_MAX];
+    char            tmp_path[PROM_PATH_MAX + 8];
+    uint64_t        interval_ns;
+
+    fillfs_job_t   *job;        ///< Current source, or NULL
+    char            target[PROM_PATH_MAX];
+    char            phase[64];
+
+    fillfs_job_t   *rate_job;   ///< Job the last rate sample belongs to
+    uint64_t        rate_bytes; ///< bytes_written at the last sample
+    uint64_t        rate_ns;    ///< Time of the last sample
+    double          rate;       ///< Bytes per second over the last interval
+} g_prom = { .lock = PTHREAD_MUTEX_INITIALIZER, .cond = PTHREAD_COND_INITIALIZER };
+
+/**
+ * @brief Write a label value with Prometheus escaping.
+ */
+static void prom_label(FILE *out, const char *value) {
+    for (const char *p = value; *p; ++p) {
+        if (*p == '\\' || *p == '"') {
+            fprintf(out, "\\%c", *p);
+        } else if (*p == '\n') {
+            fputs("\\n", out);
+        } else {
+            fputc(*p, out);
+        }
+    }
+}
+
+/**
+ * @brief Start a series: metric name and the target label (more labels may follow).
+ */
+static void prom_series(FILE *out, const char *name) {
+    fprintf(out, "%s{target=\"", name);
+    prom_label(out, g_prom.target);
+    fputc('"', out);
+}
+
+/**
+ * @brief Write a single-series metric with its HELP and TYPE lines.
+ */
+static void prom_metric(FILE *out, const char *name, const char *type, const char *help, double value) {
+    fprintf(out, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+    prom_series(out, name);
+    fprintf(out, "} %.16g\n", value);
+}
+
+static const char *state_name(fillfs_state_t state) {
+    switch (state) {
+        case FILLFS_STATE_CREATED: return "created";
+        case FILLFS_STATE_RUNNING: return "running";
+        case FILLFS_STATE_IDLE:    return "idle";
+        case FILLFS_STATE_PAUSED:  return "paused";
+        case FILLFS_STATE_DONE:    return "done";
+    }
+    return "unknown";
+}
+
+/**
+ * @brief Write all metrics for the current source to OUT. Called with the lock held.
+ */
+static void prom_write_metrics(FILE *out) {
+    fillfs_progress_t progress;
+    uint64_t counts[PROM_BOUNDS];
+    uint64_t count = 0;
+    double sum_us = 0.0;
+
+    fillfs_job_progress(g_prom.job, &progress);
+    fillfs_job_latency(g_prom.job, prom_bounds_us, PROM_BOUNDS, counts, &count, &sum_us);
+
+    // Rate over the last interval, restarted whenever the source changes
+    uint64_t now = now_ns();
+    if (g_prom.rate_job != g_prom.job || progress.bytes_written < g_prom.rate_bytes) {
+        g_prom.rate_job = g_prom.job;
+        g_prom.rate     = 0.0;
+    } else if (now > g_prom.rate_ns) {
+        g_prom.rate = (double)(progress.bytes_written - g_prom.rate_bytes) * 1e9 /
+                      (double)(now - g_prom.rate_ns);
+    }
+    g_prom.rate_bytes = progress.bytes_written;
+    g_prom.rate_ns    = now;
+
+    prom_metric(out, "fillfs_bytes_written_total", "counter",
+                "Bytes written to the fill file.", (double)progress.bytes_written);
+    prom_metric(out, "fillfs_write_rate_bytes_per_second", "gauge",
+                "Write rate over the last interval.", g_prom.rate);
+    prom_metric(out, "fillfs_target_bytes", "gauge",
+                "Bytes the fill is expected to write (0 if unknown).", (double)progress.target_bytes);
+    prom_metric(out, "fillfs_elapsed_seconds", "gauge",
+                "Time since the fill started.", progress.elapsed_s);
+    prom_metric(out, "fillfs_write_errors_total", "counter",
+                "Failed writes (a failure stops the fill).", progress.error ? 1.0 : 0.0);
+    prom_metric(out, "fillfs_disk_full", "gauge",
+                "Whether the filesystem has reported ENOSPC.", progress.disk_full ? 1.0 : 0.0);
+
+    fprintf(out, "# HELP fillfs_phase Current job state and job file phase.\n"
+                 "# TYPE fillfs_phase gauge\n");
+    prom_series(out, "fillfs_phase");
+    fprintf(out, ",state=\"%s\",phase=\"", state_name(progress.state));
+    prom_label(out, g_prom.phase);
+    fprintf(out, "\"} 1\n");
+
+    struct statvfs fs;
+    if (statvfs(g_prom.target, &fs) == 0) {
+        prom_metric(out, "fillfs_target_free_bytes", "gauge",
+                    "Space available to unprivileged users on the target filesystem.",
+                    (double)fs.f_bavail * (double)fs.f_frsize);
+        prom_metric(out, "fillfs_target_size_bytes", "gauge",
+                    "Size of the target filesystem.", (double)fs.f_blocks * (double)fs.f_frsize);
+    }
+
+    fprintf(out, "# HELP fillfs_write_latency_seconds Submit-to-completion latency of writes.\n"
+                 "# TYPE fillfs_write_latency_seconds histogram\n");
+    for (unsigned i = 0; i < PROM_BOUNDS; ++i) {
+        prom_series(out, "fillfs_write_latency_seconds_bucket");
+        fprintf(out, ",le=\"%g\"} %llu\n", prom_bounds_us[i] / 1e6, (unsigned long long)counts[i]);
+    }
+    prom_series(out, "fillfs_write_latency_seconds_bucket");
+    fprintf(out, ",le=\"+Inf\"} %llu\n", (unsigned long long)count);
+    prom_series(out, "fillfs_write_latency_seconds_sum");
+    fprintf(out, "} %.6f\n", sum_us / 1e6);
+    prom_series(out, "fillfs_write_latency_seconds_count");
+    fprintf(out, "} %llu\n", (unsigned long long)count);
+}
+
+/**
+ * @brief Rewrite the textfile: write PATH.tmp, then rename it over PATH so
+ *        the collector never sees a partial file. Called with the lock held.
+ */
+static void prom_write_file(void) {
+    if (!g_prom.job) {
+        return;  // Keep the last job's final numbers
+    }
+    FILE *out = fopen(g_prom.tmp_path, "w");
+    if (!out) {
+        perror(g_prom.tmp_path);
+        return;
+    }
+    prom_write_metrics(out);
+    if (fclose(out) != 0 || rename(g_prom.tmp_path, g_prom.path) == -1) {
+        perror(g_prom.path);
+        remove(g_prom.tmp_path);
+    }
+}
+
+static void *prom_thread(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&g_prom.lock);
+    while (!g_prom.stop) {
+        prom_write_file();
+
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec  += (time_t)(g_prom.interval_ns / 1000000000ULL);
+        deadline.tv_nsec += (long)(g_prom.interval_ns % 1000000000ULL);
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        while (!g_prom.stop &&
+               pthread_cond_timedwait(&g_prom.cond, &g_prom.lock, &deadline) != ETIMEDOUT) {
+        }
+    }
+    pthread_mutex_unlock(&g_prom.lock);
+    return NULL;
+}
+
+int prom_exporter_start(const char *path, double interval_s) {
+    snprintf(g_prom.path, sizeof(g_prom.path), "%s", path);
+    snprintf(g_prom.tmp_path, sizeof(g_prom.tmp_path), "%s.tmp", path);
+    g_prom.interval_ns = (uint64_t)(interval_s * 1e9);
+    g_prom.stop = 0;
+
+    int rc = pthread_create(&g_prom.tid, NULL, prom_thread, NULL);
+    if (rc != 0) {
+        errno = rc;
+        perror("pthread_create");
+        return -1;
+    }
+    g_prom.running = 1;
+    return 0;
+}
+
+void prom_exporter_set_source(fillfs_job_t *job, const char *target, const char *phase) {
+    if (!g_prom.running) {
+        return;
+    }
+    pthread_mutex_lock(&g_prom.lock);
+    if (!job && g_prom.job) {
+        prom_write_file();  // Final numbers of the job that is going away
+    }
+    g_prom.job = job;
+    snprintf(g_prom.target, sizeof(g_prom.target), "%s", target ? target : "");
+    snprintf(g_prom.phase, sizeof(g_prom.phase), "%s", phase ? phase : "");
+    pthread_mutex_unlock(&g_prom.lock);
+}
+
+void prom_exporter_stop(void) {
+    if (!g_prom.running) {
+        return;
+    }
+    pthread_mutex_lock(&g_prom.lock);
+    g_prom.stop = 1;
+    pthread_cond_signal(&g_prom.cond);
+    pthread_mutex_unlock(&g_prom.lock);
+    pthread_join(g_prom.tid, NULL);
+    g_prom.running = 0;
+}
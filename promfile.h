@@ -0,0 +1,60 @@
+/*
+ * promfile.h
+ *
+ * Copyright (c) 2025 Robert Heffernan
+ *
+ * Author: Robert Heffernan <robert@heffernantech.au>
+ *
+ * This file is part of the fillfs utility. It is licensed under the MIT License:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify,
+ * merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Prometheus textfile exporter (--prom-textfile). A stats thread rewrites
+ * the file atomically at a fixed interval for node_exporter's textfile
+ * collector; the writers are only observed through the libfillfs API.
+ */
+
+#ifndef FILLFS_PROMFILE_H
+#define FILLFS_PROMFILE_H
+
+#include "fillfs.h"
+
+/**
+ * @brief Start the exporter thread.
+ *
+ * @param path       Output file (written as PATH.tmp, then renamed).
+ * @param interval_s Seconds between rewrites.
+ * @return int 0 on success, -1 if the thread could not be started.
+ */
+int prom_exporter_start(const char *path, double interval_s);
+
+/**
+ * @brief Point the exporter at a job (NULL for none). Call with NULL before
+ *        destroying the job. PHASE names the current job file phase, or NULL.
+ *        No-op if the exporter is not running.
+ */
+void prom_exporter_set_source(fillfs_job_t *job, const char *target, const char *phase);
+
+/**
+ * @brief Write the file a last time and stop the exporter thread.
+ */
+void prom_exporter_stop(void);
+
+#endif /* FILLFS_PROMFILE_H */
@@ -0,0 +1,141 @@
+#!/usr/bin/env bash
+#
+# check.sh - functional checks of fillfs on the fault-injecting fake engine
+#
+# Copyright (c) 2025 Robert Heffernan
+# Licensed under the MIT License (see LICENSE).
+#
+# Runs fillfs with -e fake and a --fault spec per scenario and checks the exit
+# status and the bytes, writes, disk_full and error fields of the -J summary.
+# The fake engine discards data and draws its faults from the seed and each
+# write's offset, so every expected value here is exact and holds on any
+# machine and for any thread count. Job-file scenarios write to a scratch
+# directory under WORKDIR and check what verify reports.
+#
+#   FILLFS        fillfs binary to check               (default: bin/fillfs)
+#   WORKDIR       scratch directory                    (default: mktemp -d)
+#
+# Prints one line per scenario and exits non-zero if any of them failed.
+
+set -u
+
+FILLFS=${FILLFS:-bin/fillfs}
+FAILED=0
+PASSED=0
+
+if [ -z "${WORKDIR:-}" ]; then
+    WORKDIR=$(mktemp -d)
+    trap 'rm -rf "$WORKDIR"' EXIT
+fi
+
+# json_field KEY: print the value of the top-level KEY of the JSON on stdin
+json_field() {
+    grep -o "\"$1\":[^,}]*" | tail -n 1 | cut -d: -f2
+}
+
+# check NAME EXPECT -- ARGS...
+# EXPECT is a space-separated list of rc=N, KEY=VALUE and KEY=MIN..MAX (a
+# numeric range), checked against the exit status and the last JSON line
+# fillfs prints.
+check() {
+    local name=$1 expect=$2
+    shift 3
+    local out rc item key want got bad=""
+    out=$("$FILLFS" -J "$@" 2>/dev/null)
+    rc=$?
+    for item in $expect; do
+        key=${item%%=*}
+        want=${item#*=}
+        if [ "$key" = rc ]; then
+            got=$rc
+        else
+            got=$(printf '%s\n' "$out" | tail -n 1 | json_field "$key")
+        fi
+        case $want in
+        *..*)
+            awk -v g="${got:-x}" -v lo="${want%..*}" -v hi="${want#*..}" \
+                'BEGIN { exit !(g ~ /^[0-9.]+$/ && g + 0 >= lo + 0 && g + 0 <= hi + 0) }' ||
+                bad="$bad $key=${got:-missing} (want $want)"
+            ;;
+        *)
+            [ "$got" = "$want" ] || bad="$bad $key=${got:-missing} (want $want)"
+            ;;
+        esac
+    done
+    if [ -n "$bad" ]; then
+        echo "FAIL  $name:$bad"
+        FAILED=$((FAILED + 1))
+    else
+        echo "ok    $name"
+        PASSED=$((PASSED + 1))
+    fi
+}
+
+mkdir -p "$WORKDIR/fake"
+T=$WORKDIR/fake
+
+check "enospc stops a directory fill" \
+    "rc=0 bytes=104857600 writes=101 disk_full=1 error=0" \
+    -- -e fake -b 1M --fault=enospc=100M "$T"
+check "enospc mid-block fills the tail" \
+    "rc=0 bytes=105381888 writes=102 disk_full=1 error=0" \
+    -- -e fake -b 1M --fault=enospc=100.5M "$T"
+check "enospc with four threads" \
+    "rc=0 bytes=105381888 disk_full=1 error=0" \
+    -- -e fake -b 1M -t 4 --fault=enospc=100.5M "$T"
+check "eio-at fails the write covering it" \
+    "rc=1 bytes=52428800 disk_full=0 error=1" \
+    -- -e fake -b 1M --fault=eio-at=50.5M "$T"
+check "eio probability" \
+    "rc=1 bytes=10485760 disk_full=0 error=1" \
+    -- -e fake -b 1M --fault=eio=0.01 "$T"
+check "short writes are completed" \
+    "rc=0 bytes=67108864 writes=76 disk_full=0 error=0" \
+    -- -e fake -b 1M --fault=short=0.3,seed=9 "$T" 64M
+check "short writes, same schedule with four threads" \
+    "rc=0 bytes=67108864 writes=76 disk_full=0 error=0" \
+    -- -e fake -b 1M -t 4 --fault=short=0.3,seed=9 "$T" 64M
+check "short writes, another seed" \
+    "rc=0 bytes=67108864 writes=95 disk_full=0 error=0" \
+    -- -e fake -b 1M --fault=short=0.3,seed=10 "$T" 64M
+check "unaligned size" \
+    "rc=0 bytes=10241024 writes=10 disk_full=0 error=0" \
+    -- -e fake -b 1M --fault=seed=1 "$T" 10001K
+check "rate limit" \
+    "rc=0 bytes=16777216 throughput_mb_s=7.5..9" \
+    -- -e fake -b 1M --rate=8M --fault=seed=1 "$T" 16M
+check "invalid fault value" "rc=1" -- -e fake --fault=latency-us=abc "$T" 1M
+check "invalid fault size" "rc=1" -- -e fake --fault=enospc=1Q "$T" 1M
+check "empty fault probability" "rc=1" -- -e fake --fault=eio= "$T" 1M
+check "NaN fault probability" "rc=1" -- -e fake --fault=short=nan "$T" 1M
+check "unknown fault key" "rc=1" -- -e fake --fault=bogus=1 "$T" 1M
+
+# Fills that end mid-block, continued by a later phase, must still verify
+mkdir -p "$WORKDIR/job"
+cat > "$WORKDIR/unaligned.job" <<EOF
+[global]
+target=$WORKDIR/job
+data=random
+block-size=1M
+seed=7
+
+[first]
+action=fill
+size=10001K
+
+[more]
+action=fill
+add=3000.5K
+
+[again]
+action=fill
+add=1.25M
+
+[verify]
+EOF
+check "job: unaligned fills then verify" \
+    "rc=0 bytes=14624256 mismatched=0 error=0" \
+    -- --job="$WORKDIR/unaligned.job"
+
+echo "check: $PASSED passed, $FAILED failed"
+[ "$FAILED" -eq 0 ]
@@ -0,0 +1,177 @@
+/*
+ * timeline.c
+ *
+ * Copyright (c) 2025 Robert Heffernan
+ *
+ * Author: Robert Heffernan <robert@heffernantech.au>
+ *
+ * This file is part of the fillfs utility. It is licensed under the MIT License:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify,
+ * merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "timeline.h"
+
+/** Shortest segment, in samples: a change must persist for a few seconds. */
+#define TL_MIN_SEGMENT 3
+
+/** Penalty factor, in units of noise variance times log(n), for each split. */
+#define TL_PENALTY 3.0
+
+/** Smallest relative difference of the means on both sides of a split. */
+#define TL_MIN_CHANGE 0.10
+
+int timeline_add(timeline_t *tl, uint64_t start_ns, uint64_t dur_ns, uint64_t bytes_at, uint64_t bytes) {
+    if (tl->n == tl->cap) {
+        size_t cap = tl->cap ? tl->cap * 2 : 256;
+        tl_sample_t *s = realloc(tl->samples, cap * sizeof(*s));
+        if (!s) {
+            return -1;
+        }
+        tl->samples = s;
+        tl->cap     = cap;
+    }
+    tl->samples[tl->n++] = (tl_sample_t){ start_ns, dur_ns, bytes_at, bytes };
+    return 0;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static int cmp_size(const void *a, const void *b) {
+    size_t x = *(const size_t*)a, y = *(const size_t*)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Noise level of the rates: the median absolute difference of
+ *        neighbouring samples, scaled to a standard deviation. Unlike the
+ *        plain variance it is not inflated by the changes being looked for.
+ */
+static double rate_noise(const double *rate, size_t n) {
+    if (n < 2) {
+        return 0.0;
+    }
+    double *diff = malloc((n - 1) * sizeof(*diff));
+    if (!diff) {
+        return 0.0;
+    }
+    for (size_t i = 1; i < n; ++i) {
+        diff[i - 1] = fabs(rate[i] - rate[i - 1]);
+    }
+    qsort(diff, n - 1, sizeof(*diff), cmp_double);
+    double mad = diff[(n - 1) / 2];
+    free(diff);
+    return mad / (0.6745 * sqrt(2.0));
+}
+
+/**
+ * @brief Best split of [a, b): the point where two means explain the most of
+ *        the variance. Returns 0 if no split clears the penalty.
+ */
+static size_t best_split(const double *sum, size_t a, size_t b, double penalty) {
+    size_t n = b - a, best = 0;
+    double best_gain = penalty;
+    if (n < 2 * TL_MIN_SEGMENT) {
+        return 0;
+    }
+    for (size_t k = a + TL_MIN_SEGMENT; k + TL_MIN_SEGMENT <= b; ++k) {
+        double n1 = (double)(k - a), n2 = (double)(b - k);
+        double m1 = (sum[k] - sum[a]) / n1;
+        double m2 = (sum[b] - sum[k]) / n2;
+        double gain = n1 * n2 / (double)n * (m1 - m2) * (m1 - m2);
+        double top  = fmax(fabs(m1), fabs(m2));
+        if (gain > best_gain && fabs(m1 - m2) >= TL_MIN_CHANGE * top) {
+            best_gain = gain;
+            best      = k;
+        }
+    }
+    return best;
+}
+
+unsigned timeline_segments(const timeline_t *tl, tl_segment_t *out, unsigned max) {
+    size_t n = tl->n;
+    if (n == 0 || max == 0) {
+        return 0;
+    }
+
+    double *rate = malloc(n * sizeof(*rate));
+    double *sum  = malloc((n + 1) * sizeof(*sum));
+    size_t *cuts = malloc((max + 1) * sizeof(*cuts));
+    if (!rate || !sum || !cuts) {
+        free(rate);
+        free(sum);
+        free(cuts);
+        return 0;
+    }
+    sum[0] = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+        const tl_sample_t *s = &tl->samples[i];
+        rate[i]    = s->dur_ns ? (double)s->bytes * 1e9 / (double)s->dur_ns : 0.0;
+        sum[i + 1] = sum[i] + rate[i];
+    }
+    double sigma   = rate_noise(rate, n);
+    double penalty = TL_PENALTY * sigma * sigma * log((double)n);
+
+    // Binary segmentation: keep splitting the pieces (as [cuts[i], cuts[i+1]) ranges)
+    // until none has a worthwhile split or MAX segments exist
+    unsigned ncuts = 2;
+    cuts[0] = 0;
+    cuts[1] = n;
+    for (int split = 1; split && ncuts <= max; ) {
+        split = 0;
+        for (unsigned i = 0; i + 1 < ncuts && ncuts <= max; ++i) {
+            size_t k = best_split(sum, cuts[i], cuts[i + 1], penalty);
+            if (k) {
+                cuts[ncuts++] = k;
+                qsort(cuts, ncuts, sizeof(*cuts), cmp_size);
+                split = 1;
+                break;
+            }
+        }
+    }
+
+    unsigned segs = 0;
+    for (unsigned i = 0; i + 1 < ncuts; ++i) {
+        tl_segment_t *seg = &out[segs++];
+        const tl_sample_t *first = &tl->samples[cuts[i]];
+        memset(seg, 0, sizeof(*seg));
+        seg->start_ns = first->start_ns;
+        seg->bytes_at = first->bytes_at;
+        for (size_t j = cuts[i]; j < cuts[i + 1]; ++j) {
+            seg->dur_ns += tl->samples[j].dur_ns;
+            seg->bytes  += tl->samples[j].bytes;
+        }
+    }
+
+    free(rate);
+    free(sum);
+    free(cuts);
+    return segs;
+}
+
+void timeline_free(timeline_t *tl) {
+    free(tl->samples);
+    memset(tl, 0, sizeof(*tl));
+}
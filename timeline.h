@@ -0,0 +1,95 @@
+/*
+ * timeline.h
+ *
+ * Copyright (c) 2025 Robert Heffernan
+ *
+ * Author: Robert Heffernan <robert@heffernantech.au>
+ *
+ * This file is part of the fillfs utility. It is licensed under the MIT License:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify,
+ * merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef FILLFS_TIMELINE_H
+#define FILLFS_TIMELINE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Throughput timeline of a job: bytes written per (roughly one second)
+ * interval, and change-point detection over it. Devices with a write cache
+ * (SLC on consumer and QLC SSDs, DRAM on arrays) run at one speed until the
+ * cache is exhausted and at another afterwards; timeline_segments() splits
+ * the run at such steady-state changes.
+ */
+
+/**
+ * @brief One sampling interval.
+ */
+typedef struct {
+    uint64_t start_ns;          ///< Interval start, relative to the job's launch
+    uint64_t dur_ns;            ///< Interval length
+    uint64_t bytes_at;          ///< Bytes written before the interval
+    uint64_t bytes;             ///< Bytes written during the interval
+} tl_sample_t;
+
+/**
+ * @brief Growable array of samples.
+ */
+typedef struct {
+    tl_sample_t *samples;
+    size_t       n;
+    size_t       cap;
+} timeline_t;
+
+/**
+ * @brief A run of samples with the same steady-state throughput.
+ */
+typedef struct {
+    uint64_t start_ns;          ///< First sample's start, relative to the job's launch
+    uint64_t dur_ns;            ///< Sum of the sample lengths
+    uint64_t bytes_at;          ///< Bytes written before the segment
+    uint64_t bytes;             ///< Bytes written during the segment
+} tl_segment_t;
+
+/**
+ * @brief Append a sample.
+ *
+ * @return int 0 on success, -1 if out of memory (the sample is dropped).
+ */
+int timeline_add(timeline_t *tl, uint64_t start_ns, uint64_t dur_ns, uint64_t bytes_at, uint64_t bytes);
+
+/**
+ * @brief Split the timeline into segments of steady throughput.
+ *
+ * Binary segmentation on the per-sample rates: a segment is split where the
+ * split explains the most variance, if that gain beats a BIC-style penalty
+ * scaled by the sample noise and the two sides differ by at least 10%.
+ *
+ * @param tl  Timeline.
+ * @param out Segments, in time order.
+ * @param max Capacity of OUT.
+ * @return unsigned Number of segments (0 for an empty timeline).
+ */
+unsigned timeline_segments(const timeline_t *tl, tl_segment_t *out, unsigned max);
+
+/** Free the samples. */
+void timeline_free(timeline_t *tl);
+
+#endif /* FILLFS_TIMELINE_H */
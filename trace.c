@@ -0,0 +1,144 @@
+/*
+ * trace.c
+ *
+ * Copyright (c) 2025 Robert Heffernan
+ *
+ * Author: Robert Heffernan <robert@heffernantech.au>
+ *
+ * This file is part of the fillfs utility. It is licensed under the MIT License:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify,
+ * merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Chrome trace JSON writer for the per-thread span buffers (see trace.h).
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trace.h"
+
+static const char *const trace_names[TR_KINDS] = {
+    [TR_GENERATE] = "generate",
+    [TR_OPEN]     = "open",
+    [TR_THROTTLE] = "throttle",
+    [TR_SUBMIT]   = "submit",
+    [TR_REAP]     = "wait",
+    [TR_FSYNC]    = "fsync",
+    [TR_CLOSE]    = "close",
+    [TR_PARK]     = "park",
+    [TR_HOLD]     = "hold",
+    [TR_IO]       = "write",
+    [TR_PHASE]    = "phase",
+    [TR_JOIN]     = "join",
+    [TR_CLEANUP]  = "cleanup",
+};
+
+trace_buf_t *trace_buf_new(const char *name, unsigned tid, uint32_t cap) {
+    trace_buf_t *tb = calloc(1, sizeof(*tb));
+    if (!tb) {
+        return NULL;
+    }
+    tb->events = malloc((size_t)cap * sizeof(*tb->events));
+    if (!tb->events) {
+        free(tb);
+        return NULL;
+    }
+    snprintf(tb->name, sizeof(tb->name), "%s", name);
+    tb->tid = tid;
+    tb->cap = cap;
+    return tb;
+}
+
+void trace_buf_free(trace_buf_t *tb) {
+    if (tb) {
+        free(tb->events);
+        free(tb);
+    }
+}
+
+/**
+ * @brief Microseconds since BASE, as the trace format expects.
+ */
+static double trace_us(uint64_t ns, uint64_t base_ns) {
+    return (ns > base_ns) ? (double)(ns - base_ns) / 1e3 : 0.0;
+}
+
+int trace_write(const char *path, trace_buf_t *const *bufs, unsigned n, uint64_t base_ns) {
+    FILE *out = fopen(path, "w");
+    if (!out) {
+        return -1;
+    }
+
+    uint64_t io_id = 0;
+    uint64_t dropped = 0;
+    const char *sep = "";
+
+    fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (unsigned b = 0; b < n; ++b) {
+        const trace_buf_t *tb = bufs[b];
+        if (!tb) {
+            continue;
+        }
+        dropped += tb->dropped;
+        fprintf(out, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+                "\"args\":{\"name\":\"%s\"}}",
+                sep, tb->tid, tb->name);
+        sep = ",\n";
+
+        for (uint32_t i = 0; i < tb->count; ++i) {
+            const trace_event_t *ev = &tb->events[i];
+            double ts  = trace_us(ev->start_ns, base_ns);
+            double dur = (ev->end_ns > ev->start_ns) ? (double)(ev->end_ns - ev->start_ns) / 1e3 : 0.0;
+
+            if (ev->kind == TR_IO) {
+                // Writes overlap when several are in flight, so they are async spans
+                ++io_id;
+                fprintf(out, "%s{\"name\":\"write\",\"cat\":\"io\",\"ph\":\"b\",\"id\":%" PRIu64 ","
+                        "\"ts\":%.3f,\"pid\":1,\"tid\":%u,"
+                        "\"args\":{\"offset\":%" PRIu64 ",\"result\":%" PRId64 "}}"
+                        ",\n{\"name\":\"write\",\"cat\":\"io\",\"ph\":\"e\",\"id\":%" PRIu64 ","
+                        "\"ts\":%.3f,\"pid\":1,\"tid\":%u}",
+                        sep, io_id, ts, tb->tid, ev->offset, ev->value,
+                        io_id, ts + dur, tb->tid);
+            } else {
+                fprintf(out, "%s{\"name\":\"%s\",\"cat\":\"fill\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+                        "\"pid\":1,\"tid\":%u",
+                        sep, trace_names[ev->kind], ts, dur, tb->tid);
+                if (ev->kind == TR_SUBMIT || ev->kind == TR_REAP) {
+                    fprintf(out, ",\"args\":{\"requests\":%" PRId64 "}", ev->value);
+                } else if (ev->kind == TR_PHASE) {
+                    fprintf(out, ",\"args\":{\"bytes\":%" PRId64 "}", ev->value);
+                }
+                fputc('}', out);
+            }
+        }
+    }
+    fprintf(out, "\n],\"otherData\":{\"dropped_events\":\"%" PRIu64 "\"}}\n", dropped);
+
+    if (fclose(out) != 0) {
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,128 @@
+/*
+ * trace.h
+ *
+ * Copyright (c) 2025 Robert Heffernan
+ *
+ * Author: Robert Heffernan <robert@heffernantech.au>
+ *
+ * This file is part of the fillfs utility. It is licensed under the MIT License:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify,
+ * merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef FILLFS_TRACE_H
+#define FILLFS_TRACE_H
+
+#include <stdint.h>
+
+/*
+ * Span tracing for fills, written as Chrome trace JSON (opens in Perfetto
+ * and chrome://tracing). Every thread records into its own fixed-size
+ * buffer, so recording takes no locks; the buffers are only read once the
+ * threads have finished. With tracing off a trace point costs one branch on
+ * a NULL buffer pointer (TRACE_ON).
+ */
+
+/** True if TR is recording. Every trace point is guarded by this one test. */
+#define TRACE_ON(tr) __builtin_expect((tr) != 0, 0)
+
+/** Default number of events per thread buffer. */
+#define TRACE_DEFAULT_EVENTS (1U << 16)
+
+/**
+ * @brief What a span measures.
+ */
+typedef enum {
+    TR_GENERATE = 0,    ///< Generating the data buffer
+    TR_OPEN,            ///< Opening the fill file
+    TR_THROTTLE,        ///< Waiting for the rate limit
+    TR_SUBMIT,          ///< Handing writes to the engine
+    TR_REAP,            ///< Waiting for completions (device time)
+    TR_FSYNC,           ///< Flushing the file
+    TR_CLOSE,           ///< Closing the file
+    TR_PARK,            ///< Persistent writer idle between phases
+    TR_HOLD,            ///< Writer paused, or surplus after fillfs_job_set_threads()
+    TR_IO,              ///< One sampled write, submit to completion
+    TR_PHASE,           ///< A whole phase of a persistent job
+    TR_JOIN,            ///< Waiting for the writers to exit
+    TR_CLEANUP,         ///< Removing the fill file
+    TR_KINDS
+} trace_kind_t;
+
+/**
+ * @brief One recorded span.
+ */
+typedef struct {
+    uint64_t start_ns;
+    uint64_t end_ns;
+    uint64_t offset;    ///< TR_IO: file offset
+    int64_t  value;     ///< TR_IO: bytes written or -errno; TR_SUBMIT/TR_REAP: requests; TR_PHASE: bytes
+    uint32_t kind;      ///< trace_kind_t
+} trace_event_t;
+
+/**
+ * @brief Per-thread event buffer. Only its owner thread appends.
+ */
+typedef struct {
+    char           name[32];    ///< Track name shown in the viewer
+    unsigned       tid;         ///< Track id
+    uint32_t       cap;
+    uint32_t       count;
+    uint64_t       dropped;     ///< Events lost because the buffer was full
+    trace_event_t *events;
+} trace_buf_t;
+
+/**
+ * @brief Allocate a buffer for CAP events.
+ *
+ * @return trace_buf_t* The buffer, or NULL if out of memory.
+ */
+trace_buf_t *trace_buf_new(const char *name, unsigned tid, uint32_t cap);
+
+/** Free a buffer from trace_buf_new() (NULL is ignored). */
+void trace_buf_free(trace_buf_t *tb);
+
+/**
+ * @brief Record a span. Call only behind TRACE_ON(tb).
+ */
+static inline void trace_span(trace_buf_t *tb, trace_kind_t kind, uint64_t start_ns, uint64_t end_ns,
+                              uint64_t offset, int64_t value) {
+    if (tb->count == tb->cap) {
+        tb->dropped++;
+        return;
+    }
+    trace_event_t *ev = &tb->events[tb->count++];
+    ev->start_ns = start_ns;
+    ev->end_ns   = end_ns;
+    ev->offset   = offset;
+    ev->value    = value;
+    ev->kind     = (uint32_t)kind;
+}
+
+/**
+ * @brief Write the buffers as a Chrome trace JSON file.
+ *
+ * @param path    Output file.
+ * @param bufs    Buffers to write (NULL entries are skipped).
+ * @param n       Number of entries in BUFS.
+ * @param base_ns Time that becomes 0 in the trace.
+ * @return int 0 on success, -1 with errno set.
+ */
+int trace_write(const char *path, trace_buf_t *const *bufs, unsigned n, uint64_t base_ns);
+
+#endif /* FILLFS_TRACE_H */
@@ -0,0 +1,282 @@
+/*
+ * util.c
+ *
+ * Copyright (c) 2025 Robert Heffernan
+ *
+ * Author: Robert Heffernan <robert@heffernantech.au>
+ *
+ * This file is part of the fillfs utility. It is licensed under the MIT License:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify,
+ * merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Small helpers shared by the fillfs front end and the I/O engines.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <ctype.h>
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#include "util.h"
+
+/**
+ * @brief Current CLOCK_MONOTONIC time in nanoseconds.
+ */
+uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// 128-bit intermediates: Y (2^80) and YB (10^24) times any mantissa exceed 64 bits
+__extension__ typedef unsigned __int128 u128;
+
+/// Fraction digits kept; more cannot change a result of whole bytes even with a Y unit
+/// (10^-24 YiB is below one byte).
+#define PARSE_MAX_FRACTION 24
+
+/**
+ * @brief Look up a unit such as "", "B", "K", "KB", "KiB" (case-insensitive).
+ *
+ * A bare prefix letter keeps its historical binary meaning (32M = 32 MiB); "KB" style
+ * units are decimal (SI) and "KiB" style units binary (IEC).
+ *
+ * @param unit Unit text; the whole string must match.
+ * @param mult Receives the multiplier in bytes.
+ * @return int 0 on success, -1 for an unknown unit.
+ */
+static int parse_unit(const char *unit, u128 *mult) {
+    static const char prefixes[] = "kmgtpezy";
+    const char *p;
+
+    if (unit[0] == '\0' || strcasecmp(unit, "b") == 0) {
+        *mult = 1;
+        return 0;
+    }
+    p = strchr(prefixes, tolower((unsigned char)unit[0]));
+    if (!p) {
+        return -1;
+    }
+
+    int      power = (int)(p - prefixes) + 1;
+    unsigned base;
+    if (unit[1] == '\0' || strcasecmp(unit + 1, "ib") == 0 || strcasecmp(unit + 1, "i") == 0) {
+        base = 1024;
+    } else if (strcasecmp(unit + 1, "b") == 0) {
+        base = 1000;
+    } else {
+        return -1;
+    }
+
+    *mult = 1;
+    while (power-- > 0) {
+        *mult *= base;
+    }
+    return 0;
+}
+
+/**
+ * @brief Parse a byte count or rate: a decimal number with an optional unit.
+ *
+ * Accepts fractions ("1.5T"), bare binary prefixes ("32M" = 32 MiB), SI units ("4GB" =
+ * 4 * 10^9) and IEC units ("4GiB" = 4 * 2^30). With PARSE_RATE a trailing "/s" is
+ * allowed. Fractional bytes are truncated.
+ *
+ * @param str   Input string.
+ * @param flags 0 or PARSE_RATE.
+ * @param out   Receives the value in bytes (or bytes per second).
+ * @return int PARSE_OK, PARSE_INVALID or PARSE_OVERFLOW.
+ */
+int parse_bytes(const char *str, unsigned flags, uint64_t *out) {
+    const u128 limit = (~(u128)0 - 9) / 10;
+    const char *p = str;
+    u128        mantissa = 0;
+    u128        scale = 1;
+    int         digits = 0;
+    int         frac = 0;
+    char        unit[8];
+
+    if (!str) {
+        return PARSE_INVALID;
+    }
+    while (isspace((unsigned char)*p)) {
+        ++p;
+    }
+    for (; isdigit((unsigned char)*p); ++p, ++digits) {
+        if (mantissa > limit) {
+            return PARSE_OVERFLOW;
+        }
+        mantissa = mantissa * 10 + (unsigned)(*p - '0');
+    }
+    if (*p == '.') {
+        for (++p; isdigit((unsigned char)*p); ++p, ++digits) {
+            // Digits past PARSE_MAX_FRACTION, or past a full mantissa (38
+            // significant digits, far finer than a byte of any 64-bit result), are dropped
+            if (frac == PARSE_MAX_FRACTION || mantissa > limit) {
+                continue;
+            }
+            mantissa = mantissa * 10 + (unsigned)(*p - '0');
+            scale *= 10;
+            ++frac;
+        }
+    }
+    if (digits == 0) {
+        return PARSE_INVALID;
+    }
+
+    // The unit runs to the end, less an optional "/s" for rates and trailing blanks
+    size_t len = strlen(p);
+    while (len > 0 && isspace((unsigned char)p[len - 1])) {
+        --len;
+    }
+    if ((flags & PARSE_RATE) && len >= 2 && p[len - 2] == '/' && tolower((unsigned char)p[len - 1]) == 's') {
+        len -= 2;
+    }
+    while (len > 0 && isspace((unsigned char)*p)) {
+        ++p;
+        --len;
+    }
+    if (len >= sizeof(unit)) {
+        return PARSE_INVALID;
+    }
+    memcpy(unit, p, len);
+    unit[len] = '\0';
+
+    u128 mult;
+    if (parse_unit(unit, &mult) != 0) {
+        return PARSE_INVALID;
+    }
+
+    // Cancel the common factors of 2 and 5 first. Then either the unit or the
+    // scale is left at 1, or the scale is at most 5^24, so mantissa * mult
+    // only exceeds 128 bits when the result exceeds 64.
+    while (scale % 2 == 0 && mult % 2 == 0) {
+        scale /= 2;
+        mult  /= 2;
+    }
+    while (scale % 5 == 0 && mult % 5 == 0) {
+        scale /= 5;
+        mult  /= 5;
+    }
+    if (mantissa > ~(u128)0 / mult) {
+        return PARSE_OVERFLOW;
+    }
+
+    u128 bytes = mantissa * mult / scale;
+    if (bytes > UINT64_MAX) {
+        return PARSE_OVERFLOW;
+    }
+    *out = (uint64_t)bytes;
+    return PARSE_OK;
+}
+
+/**
+ * @brief Describe a parse_bytes() failure.
+ */
+const char *parse_error(int rc) {
+    switch (rc) {
+        case PARSE_OK:       return "no error";
+        case PARSE_OVERFLOW: return "too large (the limit is 16 EiB)";
+        default:             return "expected a number with an optional unit such as K, MB or GiB";
+    }
+}
+
+/**
+ * @brief parse_bytes() for command-line values: exits with a message on bad input.
+ */
+static uint64_t parse_or_exit(const char *str, unsigned flags, const char *what) {
+    uint64_t value = 0;
+    int      rc = parse_bytes(str, flags, &value);
+
+    if (rc != PARSE_OK) {
+        fprintf(stderr, "Error: Invalid %s '%s': %s.\n", what, str, parse_error(rc));
+        exit(EXIT_FAILURE);
+    }
+    return value;
+}
+
+/**
+ * @brief Parse a size such as 800K, 32M, 1.5T or 4GiB into bytes; exits on bad input.
+ *
+ * @param size_str Input string representing the size (with optional unit).
+ * @return uint64_t The size in bytes.
+ */
+uint64_t parse_size(const char *size_str) {
+    return parse_or_exit(size_str, 0, "size");
+}
+
+/**
+ * @brief Parse a rate such as 200M or 200MB/s into bytes per second; exits on bad input.
+ */
+uint64_t parse_rate(const char *rate_str) {
+    return parse_or_exit(rate_str, PARSE_RATE, "rate");
+}
+
+/**
+ * @brief Parse a duration such as 90, 1.5s, 500ms, 10m, 2h or 1d into seconds.
+ *
+ * @param str Input string; a bare number is taken as seconds.
+ * @return double The duration in seconds, or -1.0 if the string is invalid.
+ */
+double parse_duration(const char *str) {
+    char *endptr = NULL;
+    double value;
+
+    if (!str) {
+        return -1.0;
+    }
+    // Only plain decimals: strtod() would also take "inf", "nan", exponents
+    // and hex floats, so it must stop exactly where the digits do
+    size_t len = strspn(str, "0123456789");
+    size_t int_len = len;
+    if (str[len] == '.') {
+        len += 1 + strspn(str + len + 1, "0123456789");
+    }
+    if (len == 0 || (int_len == 0 && len == 1)) {
+        return -1.0;
+    }
+    errno = 0;
+    value = strtod(str, &endptr);
+    if (endptr != str + len || errno == ERANGE || !isfinite(value)) {
+        return -1.0;
+    }
+    if (*endptr == '\0' || strcmp(endptr, "s") == 0) {
+        return value;
+    }
+    if (strcmp(endptr, "ms") == 0) {
+        return value / 1000.0;
+    }
+    if (strcmp(endptr, "m") == 0) {
+        return value * 60.0;
+    }
+    if (strcmp(endptr, "h") == 0) {
+        return value * 3600.0;
+    }
+    if (strcmp(endptr, "d") == 0) {
+        return value * 86400.0;
+    }
+    return -1.0;
+}
@@ -0,0 +1,96 @@
+/*
+ * util.h
+ *
+ * Copyright (c) 2025 Robert Heffernan
+ *
+ * Author: Robert Heffernan <robert@heffernantech.au>
+ *
+ * This file is part of the fillfs utility. It is licensed under the MIT License:
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this
+ * software and associated documentation files (the “Software”), to deal in the Software
+ * without restriction, including without limitation the rights to use, copy, modify,
+ * merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+ * IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef FILLFS_UTIL_H
+#define FILLFS_UTIL_H
+
+#include <stdint.h>
+
+/**
+ * @brief Current CLOCK_MONOTONIC time in nanoseconds.
+ */
+uint64_t now_ns(void);
+
+/**
+ * @brief splitmix64 finaliser: a cheap, well-mixed 64-bit hash. Also derives the
+ *        keys of the random data stream, so it must never change.
+ */
+static inline uint64_t mix64(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/** @brief Return codes of parse_bytes(). */
+enum {
+    PARSE_OK       =  0,  ///< Parsed.
+    PARSE_INVALID  = -1,  ///< Not a number, or an unknown unit.
+    PARSE_OVERFLOW = -2,  ///< Does not fit in 64 bits.
+};
+
+/** @brief parse_bytes() flag: accept a trailing "/s". */
+#define PARSE_RATE 0x1u
+
+/**
+ * @brief Parse a byte count such as 800K, 1.5T, 4GB (SI) or 4GiB (IEC) without exiting.
+ *        A bare K/M/G/T/P/E/Z/Y suffix is binary.
+ *
+ * @param str   Input string.
+ * @param flags 0, or PARSE_RATE to allow a rate such as "200MB/s".
+ * @param out   Receives the value.
+ * @return int PARSE_OK, PARSE_INVALID or PARSE_OVERFLOW.
+ */
+int parse_bytes(const char *str, unsigned flags, uint64_t *out);
+
+/**
+ * @brief Describe a parse_bytes() return code.
+ */
+const char *parse_error(int rc);
+
+/**
+ * @brief Parse a size string into bytes (see parse_bytes()).
+ *        Exits with an error message on invalid or overflowing input.
+ *
+ * @param size_str Input string representing the size (with optional unit).
+ * @return uint64_t The size in bytes.
+ */
+uint64_t parse_size(const char *size_str);
+
+/**
+ * @brief Parse a rate such as 200M or 200MB/s into bytes per second.
+ *        Exits with an error message on invalid or overflowing input.
+ */
+uint64_t parse_rate(const char *rate_str);
+
+/**
+ * @brief Parse a duration (90, 1.5s, 500ms, 10m, 2h, 1d) into seconds.
+ *
+ * @return double Seconds, or -1.0 if the string is invalid.
+ */
+double parse_duration(const char *str);
+
+#endif /* FILLFS_UTIL_H */